@@ -43,6 +43,7 @@
 #include "tb-jmp-cache.h"
 #include "tb-hash.h"
 #include "tb-context.h"
+#include "tb-worker.h"
 #include "tb-internal.h"
 #include "internal-common.h"
 
@@ -209,6 +210,41 @@ static TranslationBlock *tb_htable_lookup(CPUState *cpu, TCGTBCPUState s)
     return qht_lookup_custom(&tb_ctx.htable, &desc, h, tb_lookup_cmp);
 }
 
+/*
+ * Queue the same-page successors of @tb, just translated for @s, for
+ * the tb-worker threads, unless they already exist.  This must be
+ * called before anything else is translated on this thread.
+ */
+static void tb_worker_prefetch(CPUState *cpu, TranslationBlock *tb,
+                               TCGTBCPUState s)
+{
+    tb_page_addr_t page = tb_page_addr0(tb) & TARGET_PAGE_MASK;
+    void *host;
+
+    if (!tb_worker_count() || tb_page_addr0(tb) == -1 ||
+        (s.cflags & (CF_COUNT_MASK | CF_NOIRQ)) || !tcg_ctx->nb_gen_succ) {
+        return;
+    }
+
+    get_page_addr_code_hostp(cpu_env(cpu), s.pc & TARGET_PAGE_MASK, &host);
+    for (int i = 0; i < tcg_ctx->nb_gen_succ; i++) {
+        vaddr off = tcg_ctx->gen_succ[i] & ~TARGET_PAGE_MASK;
+        TCGTBCPUState n = s;
+
+        n.pc = tcg_ctx->gen_succ[i];
+        if (!tb_htable_lookup(cpu, n)) {
+            tb_worker_queue(cpu, n, page | off, host + off);
+        }
+    }
+}
+
+static void tb_account_miss(int64_t ns)
+{
+    stat64_add(&tb_ctx.tb_miss_count, 1);
+    stat64_add(&tb_ctx.tb_miss_ns, ns);
+    stat64_max(&tb_ctx.tb_miss_max_ns, ns);
+}
+
 /**
  * tb_lookup:
  * @cpu: CPU that will execute the returned translation block
@@ -223,36 +259,159 @@ static TranslationBlock *tb_htable_lookup(CPUState *cpu, TCGTBCPUState s)
  *
  * Returns: an existing translation block or NULL.
  */
+static inline bool tb_jmp_cache_match(TranslationBlock *tb, vaddr pc,
+                                      TCGTBCPUState s)
+{
+    return tb &&
+           pc == s.pc &&
+           tb->cs_base == s.cs_base &&
+           tb->flags == s.flags &&
+           tb_cflags(tb) == s.cflags;
+}
+
+/*
+ * Make @tb the most recently used entry of @set, which must belong to
+ * @jc.  What falls out of the set goes to the victim buffer.
+ */
+static void tb_jmp_cache_insert(CPUJumpCache *jc, CPUJumpCacheEntry *set,
+                                vaddr pc, TranslationBlock *tb)
+{
+    int w;
+
+    for (w = 0; w < TB_JMP_CACHE_WAYS - 1; w++) {
+        if (set[w].pc == pc) {
+            break;
+        }
+    }
+    if (set[w].pc != pc) {
+        TranslationBlock *old = qatomic_read(&set[w].tb);
+
+        if (old) {
+            CPUJumpCacheEntry *v =
+                &jc->victim[jc->victim_next++ % TB_JMP_VICTIM_SIZE];
+
+            v->pc = set[w].pc;
+            qatomic_set(&v->tb, old);
+        }
+    }
+    for (; w > 0; w--) {
+        set[w].pc = set[w - 1].pc;
+        qatomic_set(&set[w].tb, qatomic_read(&set[w - 1].tb));
+    }
+    set[0].pc = pc;
+    qatomic_set(&set[0].tb, tb);
+}
+
+/* Hash table lookups per check of the miss rate */
+#define TB_JMP_CACHE_WINDOW     4096
+/* Grow when fewer than this many lookups per hash table lookup hit */
+#define TB_JMP_CACHE_GROW_RATIO 16
+
+/*
+ * Replace @cpu's jump cache @jc with one twice the size if too many
+ * lookups have had to go to the hash table lately.  The new cache
+ * starts out empty.  Only the owning CPU replaces its cache; everyone
+ * else reads the pointer under RCU.
+ */
+static CPUJumpCache *tb_jmp_cache_maybe_grow(CPUState *cpu, CPUJumpCache *jc)
+{
+    size_t lookups = jc->hits + jc->victim_hits + jc->misses;
+    bool grow;
+    CPUJumpCache *new;
+
+    if (++jc->window_misses < TB_JMP_CACHE_WINDOW) {
+        return jc;
+    }
+    grow = jc->bits < TB_JMP_CACHE_MAX_BITS &&
+           lookups - jc->window_lookups <
+           (size_t)TB_JMP_CACHE_WINDOW * TB_JMP_CACHE_GROW_RATIO;
+    jc->window_lookups = lookups;
+    jc->window_misses = 0;
+    if (!grow) {
+        return jc;
+    }
+
+    new = tb_jmp_cache_new(jc->bits + 1);
+    new->hits = jc->hits;
+    new->victim_hits = jc->victim_hits;
+    new->misses = jc->misses;
+    new->resizes = jc->resizes + 1;
+    new->window_lookups = lookups;
+    qatomic_rcu_set(&cpu->tb_jmp_cache, new);
+    g_free_rcu(jc, rcu);
+    return new;
+}
+
+/* The rest of tb_lookup, when the most recently used way of the set misses */
+static TranslationBlock * __attribute__((noinline))
+tb_lookup_slow(CPUState *cpu, CPUJumpCache *jc, CPUJumpCacheEntry *set,
+               TCGTBCPUState s)
+{
+    TranslationBlock *tb;
+    int i;
+
+    for (i = 1; i < TB_JMP_CACHE_WAYS; i++) {
+        tb = qatomic_read(&set[i].tb);
+        if (tb_jmp_cache_match(tb, set[i].pc, s)) {
+            qatomic_set(&jc->hits, jc->hits + 1);
+            tb_jmp_cache_insert(jc, set, s.pc, tb);
+            return tb;
+        }
+    }
+
+    for (i = 0; i < TB_JMP_VICTIM_SIZE; i++) {
+        CPUJumpCacheEntry *v = &jc->victim[i];
+
+        tb = qatomic_read(&v->tb);
+        if (tb_jmp_cache_match(tb, v->pc, s)) {
+            qatomic_set(&jc->victim_hits, jc->victim_hits + 1);
+            qatomic_set(&v->tb, NULL);
+            tb_jmp_cache_insert(jc, set, s.pc, tb);
+            return tb;
+        }
+    }
+
+    tb = tb_htable_lookup(cpu, s);
+    if (tb == NULL) {
+        return NULL;
+    }
+
+    qatomic_set(&jc->misses, jc->misses + 1);
+    jc = tb_jmp_cache_maybe_grow(cpu, jc);
+    tb_jmp_cache_insert(jc, tb_jmp_cache_set(jc, s.pc), s.pc, tb);
+    return tb;
+}
+
 static inline TranslationBlock *tb_lookup(CPUState *cpu, TCGTBCPUState s)
 {
     TranslationBlock *tb;
     CPUJumpCache *jc;
-    uint32_t hash;
+    CPUJumpCacheEntry *set;
 
     /* we should never be trying to look up an INVALID tb */
     tcg_debug_assert(!(s.cflags & CF_INVALID));
 
-    hash = tb_jmp_cache_hash_func(s.pc);
+    /* Only this CPU replaces its cache, so no need for qatomic_rcu_read */
     jc = cpu->tb_jmp_cache;
+    set = tb_jmp_cache_set(jc, s.pc);
 
-    tb = qatomic_read(&jc->array[hash].tb);
-    if (likely(tb &&
-               jc->array[hash].pc == s.pc &&
-               tb->cs_base == s.cs_base &&
-               tb->flags == s.flags &&
-               tb_cflags(tb) == s.cflags)) {
+    tb = qatomic_read(&set[0].tb);
+    if (likely(tb_jmp_cache_match(tb, set[0].pc, s))) {
+        qatomic_set(&jc->hits, jc->hits + 1);
         goto hit;
     }
 
-    tb = tb_htable_lookup(cpu, s);
+    tb = tb_lookup_slow(cpu, jc, set, s);
     if (tb == NULL) {
         return NULL;
     }
 
-    jc->array[hash].pc = s.pc;
-    qatomic_set(&jc->array[hash].tb, tb);
-
 hit:
+    /*
+     * Keep the region from looking cold.  A hot loop that chains to
+     * itself comes back here whenever an interrupt or exit is pending.
+     */
+    tcg_region_mark_used(tb->tc.ptr);
     /*
      * As long as tb is not NULL, the contents are consistent.  Therefore,
      * the virtual PC has to match for non-CF_PCREL translations.
@@ -634,6 +793,7 @@ static inline void tb_add_jump(TranslationBlock *tb, int n,
 
     /* patch the native jump address */
     tb_set_jmp_target(tb, n, (uintptr_t)tb_next->tc.ptr);
+    tcg_region_mark_used(tb_next->tc.ptr);
 
     /* add in TB jmp list */
     tb->jmp_list_next[n] = tb_next->jmp_list_head;
@@ -947,20 +1107,21 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
             tb = tb_lookup(cpu, s);
             if (tb == NULL) {
                 CPUJumpCache *jc;
-                uint32_t h;
+                int64_t t0;
 
                 mmap_lock();
+                t0 = get_clock();
                 tb = tb_gen_code(cpu, s);
+                tb_account_miss(get_clock() - t0);
+                tb_worker_prefetch(cpu, tb, s);
                 mmap_unlock();
 
                 /*
                  * We add the TB in the virtual pc hash table
                  * for the fast lookup
                  */
-                h = tb_jmp_cache_hash_func(s.pc);
                 jc = cpu->tb_jmp_cache;
-                jc->array[h].pc = s.pc;
-                qatomic_set(&jc->array[h].tb, tb);
+                tb_jmp_cache_insert(jc, tb_jmp_cache_set(jc, s.pc), s.pc, tb);
             }
 
 #ifndef CONFIG_USER_ONLY
@@ -1048,7 +1209,7 @@ bool tcg_exec_realizefn(CPUState *cpu, Error **errp)
         tcg_target_initialized = true;
     }
 
-    cpu->tb_jmp_cache = g_new0(CPUJumpCache, 1);
+    cpu->tb_jmp_cache = tb_jmp_cache_new(TB_JMP_CACHE_MIN_BITS);
     tlb_init(cpu);
 #ifndef CONFIG_USER_ONLY
     tcg_iommu_init_notifier_list(cpu);
@@ -151,16 +151,23 @@ static void tlb_window_reset(CPUTLBDesc *desc, int64_t ns,
 static void tb_jmp_cache_clear_page(CPUState *cpu, vaddr page_addr)
 {
     CPUJumpCache *jc = cpu->tb_jmp_cache;
-    int i, i0;
+    size_t i, i0, n;
 
     if (unlikely(!jc)) {
         return;
     }
 
-    i0 = tb_jmp_cache_hash_page(page_addr);
-    for (i = 0; i < TB_JMP_PAGE_SIZE; i++) {
+    /* The sets for a page are contiguous */
+    i0 = (size_t)tb_jmp_cache_hash_page(jc, page_addr) * TB_JMP_CACHE_WAYS;
+    n = (size_t)TB_JMP_CACHE_WAYS << tb_jmp_cache_page_bits(jc);
+    for (i = 0; i < n; i++) {
         qatomic_set(&jc->array[i0 + i].tb, NULL);
     }
+    for (i = 0; i < TB_JMP_VICTIM_SIZE; i++) {
+        if ((jc->victim[i].pc & TARGET_PAGE_MASK) == page_addr) {
+            qatomic_set(&jc->victim[i].tb, NULL);
+        }
+    }
 }
 
 /**
@@ -741,7 +748,8 @@ static void tlb_flush_range_by_mmuidx_async_0(CPUState *cpu,
      * If the length is larger than the jump cache size, then it will take
      * longer to clear each entry individually than it will to clear it all.
      */
-    if (d.len >= (TARGET_PAGE_SIZE * TB_JMP_CACHE_SIZE)) {
+    if (d.len >= (TARGET_PAGE_SIZE *
+                  (TB_JMP_CACHE_WAYS << TB_JMP_CACHE_MIN_BITS))) {
         tcg_flush_jmp_cache(cpu);
         return;
     }
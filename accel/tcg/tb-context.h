@@ -22,6 +22,7 @@
 
 #include "qemu/thread.h"
 #include "qemu/qht.h"
+#include "qemu/stats64.h"
 
 #define CODE_GEN_HTABLE_BITS     15
 #define CODE_GEN_HTABLE_SIZE     (1 << CODE_GEN_HTABLE_BITS)
@@ -34,7 +35,13 @@ struct TBContext {
 
     /* statistics */
     unsigned tb_flush_count;
+    unsigned tb_reclaim_count;
     unsigned tb_phys_invalidate_count;
+
+    /* time from a lookup miss to the TB being installed, in ns */
+    Stat64 tb_miss_count;
+    Stat64 tb_miss_ns;
+    Stat64 tb_miss_max_ns;
 };
 
 extern TBContext tb_ctx;
@@ -12,8 +12,11 @@
 #include "qemu/rcu.h"
 #include "exec/cpu-common.h"
 
-#define TB_JMP_CACHE_BITS 12
-#define TB_JMP_CACHE_SIZE (1 << TB_JMP_CACHE_BITS)
+/* log2 of the number of sets, initially and at most */
+#define TB_JMP_CACHE_MIN_BITS 11
+#define TB_JMP_CACHE_MAX_BITS 14
+#define TB_JMP_CACHE_WAYS     2
+#define TB_JMP_VICTIM_SIZE    8
 
 /*
  * Invalidated in parallel; all accesses to 'tb' must be atomic.
@@ -22,12 +25,46 @@
  * non-NULL value of 'tb'.  Strictly speaking pc is only needed for
  * CF_PCREL, but it's used always for simplicity.
  */
+typedef struct CPUJumpCacheEntry {
+    TranslationBlock *tb;
+    vaddr pc;
+} CPUJumpCacheEntry;
+
+/*
+ * Each set holds TB_JMP_CACHE_WAYS entries, most recently used first.
+ * What falls out of the last way goes to a small victim buffer, which
+ * is searched before the hash table.  When too many lookups end up in
+ * the hash table anyway, the owning CPU replaces the cache with one
+ * twice the size; the old one is freed after an RCU grace period.
+ */
 typedef struct CPUJumpCache {
     struct rcu_head rcu;
-    struct {
-        TranslationBlock *tb;
-        vaddr pc;
-    } array[TB_JMP_CACHE_SIZE];
+    unsigned bits;              /* log2 of the number of sets */
+    unsigned victim_next;
+    /* statistics, only written by the owning CPU */
+    size_t hits;                /* found in a set */
+    size_t victim_hits;         /* found in the victim buffer */
+    size_t misses;              /* found in the hash table instead */
+    size_t resizes;
+    size_t window_lookups;      /* lookups when the window began */
+    size_t window_misses;
+    CPUJumpCacheEntry victim[TB_JMP_VICTIM_SIZE];
+    CPUJumpCacheEntry array[];
 } CPUJumpCache;
 
+static inline size_t tb_jmp_cache_entries(const CPUJumpCache *jc)
+{
+    return (size_t)TB_JMP_CACHE_WAYS << jc->bits;
+}
+
+static inline CPUJumpCache *tb_jmp_cache_new(unsigned bits)
+{
+    CPUJumpCache *jc = g_malloc0(sizeof(CPUJumpCache) +
+                                 sizeof(CPUJumpCacheEntry) *
+                                 ((size_t)TB_JMP_CACHE_WAYS << bits));
+
+    jc->bits = bits;
+    return jc;
+}
+
 #endif /* ACCEL_TCG_TB_JMP_CACHE_H */
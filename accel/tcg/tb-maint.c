@@ -34,6 +34,7 @@
 #include "tb-context.h"
 #include "tb-internal.h"
 #include "internal-common.h"
+#include "tb-worker.h"
 #ifdef CONFIG_USER_ONLY
 #include "user/page-protection.h"
 #endif
@@ -767,6 +768,7 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
         goto done;
     }
     did_flush = true;
+    tb_worker_flush_lock();
 
     CPU_FOREACH(cpu) {
         tcg_flush_jmp_cache(cpu);
@@ -778,6 +780,7 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
     tcg_region_reset_all();
     /* XXX: flush processor icache at this point if cache flush is expensive */
     qatomic_inc(&tb_ctx.tb_flush_count);
+    tb_worker_flush_unlock();
 
 done:
     mmap_unlock();
@@ -886,13 +889,21 @@ static void tb_jmp_cache_inval_tb(TranslationBlock *tb)
             tcg_flush_jmp_cache(cpu);
         }
     } else {
-        uint32_t h = tb_jmp_cache_hash_func(tb->pc);
+        RCU_READ_LOCK_GUARD();
 
         CPU_FOREACH(cpu) {
-            CPUJumpCache *jc = cpu->tb_jmp_cache;
+            CPUJumpCache *jc = qatomic_rcu_read(&cpu->tb_jmp_cache);
+            CPUJumpCacheEntry *set = tb_jmp_cache_set(jc, tb->pc);
 
-            if (qatomic_read(&jc->array[h].tb) == tb) {
-                qatomic_set(&jc->array[h].tb, NULL);
+            for (int i = 0; i < TB_JMP_CACHE_WAYS; i++) {
+                if (qatomic_read(&set[i].tb) == tb) {
+                    qatomic_set(&set[i].tb, NULL);
+                }
+            }
+            for (int i = 0; i < TB_JMP_VICTIM_SIZE; i++) {
+                if (qatomic_read(&jc->victim[i].tb) == tb) {
+                    qatomic_set(&jc->victim[i].tb, NULL);
+                }
             }
         }
     }
@@ -901,9 +912,11 @@ static void tb_jmp_cache_inval_tb(TranslationBlock *tb)
 /*
  * In user-mode, call with mmap_lock held.
  * In !user-mode, if @rm_from_page_list is set, call with the TB's pages'
- * locks held.
+ * locks held.  If @rm_from_jmp_cache is not set, the caller flushes the
+ * jump caches itself.
  */
-static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
+static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list,
+                                  bool rm_from_jmp_cache)
 {
     uint32_t h;
     tb_page_addr_t phys_pc;
@@ -916,12 +929,14 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
     qatomic_set(&tb->cflags, tb->cflags | CF_INVALID);
     qemu_spin_unlock(&tb->jmp_lock);
 
-    /* remove the TB from the hash list */
+    /* remove the TB from the hash list; one-shot TBs were never added */
     phys_pc = tb_page_addr0(tb);
-    h = tb_hash_func(phys_pc, (orig_cflags & CF_PCREL ? 0 : tb->pc),
-                     tb->flags, tb->cs_base, orig_cflags);
-    if (!qht_remove(&tb_ctx.htable, tb, h)) {
-        return;
+    if (phys_pc != -1) {
+        h = tb_hash_func(phys_pc, (orig_cflags & CF_PCREL ? 0 : tb->pc),
+                         tb->flags, tb->cs_base, orig_cflags);
+        if (!qht_remove(&tb_ctx.htable, tb, h)) {
+            return;
+        }
     }
 
     /* remove the TB from the page list */
@@ -930,7 +945,9 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
     }
 
     /* remove the TB from the hash list */
-    tb_jmp_cache_inval_tb(tb);
+    if (rm_from_jmp_cache) {
+        tb_jmp_cache_inval_tb(tb);
+    }
 
     /* suppress this TB from the two jump lists */
     tb_remove_from_jmp_list(tb, 0);
@@ -946,7 +963,7 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
 static void tb_phys_invalidate__locked(TranslationBlock *tb)
 {
     qemu_thread_jit_write();
-    do_tb_phys_invalidate(tb, true);
+    do_tb_phys_invalidate(tb, true, true);
     qemu_thread_jit_execute();
 }
 
@@ -958,10 +975,74 @@ void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr)
 {
     if (page_addr == -1 && tb_page_addr0(tb) != -1) {
         tb_lock_pages(tb);
-        do_tb_phys_invalidate(tb, true);
+        do_tb_phys_invalidate(tb, true, true);
+        tb_unlock_pages(tb);
+    } else {
+        do_tb_phys_invalidate(tb, false, true);
+    }
+}
+
+/*
+ * Invalidate @tb, whose code region is about to be reused.  One-shot
+ * TBs are on no page list, but may still be the target of a chained
+ * jump that must not run the overwritten code.
+ */
+static void tb_evict(TranslationBlock *tb)
+{
+    if (tb_page_addr0(tb) != -1) {
+        tb_lock_pages(tb);
+        do_tb_phys_invalidate(tb, true, false);
         tb_unlock_pages(tb);
     } else {
-        do_tb_phys_invalidate(tb, false);
+        do_tb_phys_invalidate(tb, false, false);
+    }
+}
+
+/*
+ * Make room in the code buffer by reclaiming its coldest region.  Only
+ * when every region is still being filled is everything flushed.
+ */
+static void do_tb_reclaim(CPUState *cpu, run_on_cpu_data tb_reclaim_gen)
+{
+    CPUState *other;
+    bool reclaimed;
+
+    mmap_lock();
+    /* If room has been made already on request of another CPU, retry. */
+    if (tb_ctx.tb_flush_count + tb_ctx.tb_reclaim_count !=
+        tb_reclaim_gen.host_int) {
+        mmap_unlock();
+        return;
+    }
+
+    tb_worker_flush_lock();
+    qemu_thread_jit_write();
+    reclaimed = tcg_region_reclaim(tb_evict);
+    qemu_thread_jit_execute();
+    if (reclaimed) {
+        CPU_FOREACH(other) {
+            tcg_flush_jmp_cache(other);
+        }
+        qatomic_inc(&tb_ctx.tb_reclaim_count);
+    }
+    tb_worker_flush_unlock();
+    mmap_unlock();
+
+    if (!reclaimed) {
+        do_tb_flush(cpu, RUN_ON_CPU_HOST_INT(tb_ctx.tb_flush_count));
+    }
+}
+
+/* Called by tb_gen_code when the code buffer is full. */
+void tb_reclaim(CPUState *cpu)
+{
+    unsigned gen = qatomic_read(&tb_ctx.tb_flush_count) +
+                   qatomic_read(&tb_ctx.tb_reclaim_count);
+
+    if (cpu_in_serial_context(cpu)) {
+        do_tb_reclaim(cpu, RUN_ON_CPU_HOST_INT(gen));
+    } else {
+        async_safe_run_on_cpu(cpu, do_tb_reclaim, RUN_ON_CPU_HOST_INT(gen));
     }
 }
 
@@ -0,0 +1,196 @@
+/*
+ * Background translation of likely successor TBs
+ *
+ * A lookup miss stalls the vCPU for as long as translation takes, and
+ * the miss itself cannot be moved off the vCPU thread: only the vCPU can
+ * fill its TLB for the code, or take the fault if it is not mapped, and
+ * it has nothing else to run meanwhile.  What can be moved is the next
+ * miss.  When a vCPU translates a TB, the same-page destinations of its
+ * direct jumps, usually both sides of the final branch, are queued here
+ * with the host address of the page, which the vCPU has just mapped.
+ * Worker threads, each with its own TCGContext and code region,
+ * translate them and install them in the hash table, where the vCPU
+ * finds them on its next lookup instead of missing.
+ *
+ * A block that would extend to a second page is abandoned, as is
+ * everything when the code buffer fills up: flushing is left to the
+ * vCPUs.  tb_flush waits for translations in progress to finish, and
+ * requests queued before it are dropped.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/rcu.h"
+#include "qemu/stats64.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
+#include "tcg/startup.h"
+#include "tcg/tcg.h"
+#include "tb-context.h"
+#include "internal-common.h"
+#include "tb-worker.h"
+
+#define TB_WORKER_QUEUE_LEN     256
+
+typedef struct TBWorkerReq {
+    CPUState *cpu;
+    TCGTBCPUState s;
+    tb_page_addr_t phys_pc;
+    void *host_pc;
+    unsigned flush_count;
+    int64_t queued_ns;
+} TBWorkerReq;
+
+typedef struct TBWorker {
+    QemuThread thread;
+    /* Held while translating, and by tb_flush */
+    QemuMutex xlate_lock;
+} TBWorker;
+
+static struct {
+    QemuMutex lock;
+    QemuCond cond;
+    /* Free-running indices into @queue, protected by @lock */
+    unsigned head, tail;
+    TBWorkerReq queue[TB_WORKER_QUEUE_LEN];
+    unsigned n;
+    TBWorker *workers;
+    Stat64 queued;
+    Stat64 installed;
+    Stat64 dropped;
+    Stat64 install_ns;
+    Stat64 install_max_ns;
+} tb_worker;
+
+static TBWorkerReq tb_worker_pop(void)
+{
+    TBWorkerReq r;
+
+    qemu_mutex_lock(&tb_worker.lock);
+    while (tb_worker.head == tb_worker.tail) {
+        qemu_cond_wait(&tb_worker.cond, &tb_worker.lock);
+    }
+    r = tb_worker.queue[tb_worker.head++ % TB_WORKER_QUEUE_LEN];
+    qemu_mutex_unlock(&tb_worker.lock);
+    return r;
+}
+
+static void *tb_worker_thread(void *opaque)
+{
+    TBWorker *w = opaque;
+
+    rcu_register_thread();
+
+    while (true) {
+        TBWorkerReq r = tb_worker_pop();
+        TranslationBlock *tb = NULL;
+        int64_t ns;
+
+        /*
+         * The context is copied from tcg_init_ctx, which only has the
+         * target's globals once the first vCPU is realized, well after
+         * the workers are started.  No request comes before that.
+         */
+        if (!tcg_ctx) {
+            tcg_register_thread();
+        }
+
+        qemu_mutex_lock(&w->xlate_lock);
+        if (r.flush_count == qatomic_read(&tb_ctx.tb_flush_count)) {
+            WITH_RCU_READ_LOCK_GUARD() {
+                tb = tb_gen_code_background(r.cpu, r.s, r.phys_pc,
+                                            r.host_pc);
+            }
+        }
+        qemu_mutex_unlock(&w->xlate_lock);
+
+        if (!tb) {
+            stat64_add(&tb_worker.dropped, 1);
+            continue;
+        }
+        ns = get_clock() - r.queued_ns;
+        stat64_add(&tb_worker.installed, 1);
+        stat64_add(&tb_worker.install_ns, ns);
+        stat64_max(&tb_worker.install_max_ns, ns);
+    }
+    return NULL;
+}
+
+/*
+ * Start @n workers.  Each claims a TCGContext, which tcg_init must
+ * have been told about.
+ */
+void tb_worker_init(unsigned n)
+{
+    qemu_mutex_init(&tb_worker.lock);
+    qemu_cond_init(&tb_worker.cond);
+    tb_worker.workers = g_new0(TBWorker, n);
+    for (unsigned i = 0; i < n; i++) {
+        TBWorker *w = &tb_worker.workers[i];
+
+        qemu_mutex_init(&w->xlate_lock);
+        qemu_thread_create(&w->thread, "TCG tb-worker", tb_worker_thread,
+                           w, QEMU_THREAD_DETACHED);
+    }
+    tb_worker.n = n;
+}
+
+unsigned tb_worker_count(void)
+{
+    return tb_worker.n;
+}
+
+/*
+ * Queue @s for translation.  The caller, a vCPU, has its guest code
+ * mapped at @phys_pc and @host_pc, on the page of a TB it just
+ * translated with the same cs_base, flags and cflags.
+ */
+void tb_worker_queue(CPUState *cpu, TCGTBCPUState s, tb_page_addr_t phys_pc,
+                     void *host_pc)
+{
+    TBWorkerReq *r;
+
+    qemu_mutex_lock(&tb_worker.lock);
+    if (tb_worker.tail - tb_worker.head == TB_WORKER_QUEUE_LEN) {
+        qemu_mutex_unlock(&tb_worker.lock);
+        stat64_add(&tb_worker.dropped, 1);
+        return;
+    }
+    r = &tb_worker.queue[tb_worker.tail++ % TB_WORKER_QUEUE_LEN];
+    *r = (TBWorkerReq) {
+        .cpu = cpu,
+        .s = s,
+        .phys_pc = phys_pc,
+        .host_pc = host_pc,
+        .flush_count = qatomic_read(&tb_ctx.tb_flush_count),
+        .queued_ns = get_clock(),
+    };
+    qemu_cond_signal(&tb_worker.cond);
+    qemu_mutex_unlock(&tb_worker.lock);
+    stat64_add(&tb_worker.queued, 1);
+}
+
+/* Wait for, and hold off, all background translation */
+void tb_worker_flush_lock(void)
+{
+    for (unsigned i = 0; i < tb_worker.n; i++) {
+        qemu_mutex_lock(&tb_worker.workers[i].xlate_lock);
+    }
+}
+
+void tb_worker_flush_unlock(void)
+{
+    for (unsigned i = 0; i < tb_worker.n; i++) {
+        qemu_mutex_unlock(&tb_worker.workers[i].xlate_lock);
+    }
+}
+
+void tb_worker_get_stats(TBWorkerStats *stats)
+{
+    stats->queued = stat64_get(&tb_worker.queued);
+    stats->installed = stat64_get(&tb_worker.installed);
+    stats->dropped = stat64_get(&tb_worker.dropped);
+    stats->install_ns = stat64_get(&tb_worker.install_ns);
+    stats->install_max_ns = stat64_get(&tb_worker.install_max_ns);
+}
@@ -0,0 +1,49 @@
+/*
+ * Background translation of likely successor TBs
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef ACCEL_TCG_TB_WORKER_H
+#define ACCEL_TCG_TB_WORKER_H
+
+#include "exec/translation-block.h"
+#include "accel/tcg/tb-cpu-state.h"
+
+typedef struct TBWorkerStats {
+    uint64_t queued;        /* successors handed to the workers */
+    uint64_t installed;     /* TBs they translated */
+    uint64_t dropped;       /* queue full, stale, or not translatable */
+    uint64_t install_ns;    /* total time from queueing to install */
+    uint64_t install_max_ns;
+} TBWorkerStats;
+
+#ifndef CONFIG_USER_ONLY
+void tb_worker_init(unsigned n);
+unsigned tb_worker_count(void);
+void tb_worker_queue(CPUState *cpu, TCGTBCPUState s, tb_page_addr_t phys_pc,
+                     void *host_pc);
+void tb_worker_flush_lock(void);
+void tb_worker_flush_unlock(void);
+void tb_worker_get_stats(TBWorkerStats *stats);
+#else
+static inline unsigned tb_worker_count(void)
+{
+    return 0;
+}
+
+static inline void tb_worker_queue(CPUState *cpu, TCGTBCPUState s,
+                                   tb_page_addr_t phys_pc, void *host_pc)
+{
+}
+
+static inline void tb_worker_flush_lock(void)
+{
+}
+
+static inline void tb_worker_flush_unlock(void)
+{
+}
+#endif
+
+#endif
@@ -43,6 +43,7 @@
 #include "accel/accel-cpu-ops.h"
 #include "accel/tcg/cpu-ops.h"
 #include "internal-common.h"
+#include "tb-worker.h"
 
 
 struct TCGState {
@@ -52,6 +53,7 @@ struct TCGState {
     bool one_insn_per_tb;
     int splitwx_enabled;
     unsigned long tb_size;
+    uint32_t tb_workers;
 };
 typedef struct TCGState TCGState;
 
@@ -130,6 +132,8 @@ static int tcg_init_machine(AccelState *as, MachineState *ms)
 
     page_init();
     tb_htable_init();
+    /* Each tb-worker thread needs a TCGContext of its own */
+    max_threads += s->tb_workers;
     tcg_init(s->tb_size * MiB, s->splitwx_enabled, max_threads);
 
 #if defined(CONFIG_SOFTMMU)
@@ -140,6 +144,12 @@ static int tcg_init_machine(AccelState *as, MachineState *ms)
     tcg_prologue_init();
 #endif
 
+#ifndef CONFIG_USER_ONLY
+    if (s->tb_workers) {
+        tb_worker_init(s->tb_workers);
+    }
+#endif
+
 #ifdef CONFIG_USER_ONLY
     qdev_create_fake_machine();
 #endif
@@ -195,6 +205,40 @@ static void tcg_set_tb_size(Object *obj, Visitor *v,
     s->tb_size = value;
 }
 
+static void tcg_get_tb_workers(Object *obj, Visitor *v,
+                               const char *name, void *opaque,
+                               Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->tb_workers;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_tb_workers(Object *obj, Visitor *v,
+                               const char *name, void *opaque,
+                               Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+#ifdef CONFIG_USER_ONLY
+    if (value) {
+        error_setg(errp, "tb-workers is only supported in system emulation");
+        return;
+    }
+#endif
+    if (value > 64) {
+        error_setg(errp, "tb-workers must be at most 64");
+        return;
+    }
+
+    s->tb_workers = value;
+}
+
 static bool tcg_get_splitwx(Object *obj, Error **errp)
 {
     TCGState *s = TCG_STATE(obj);
@@ -257,6 +301,13 @@ static void tcg_accel_class_init(ObjectClass *oc, const void *data)
     object_class_property_set_description(oc, "tb-size",
         "TCG translation block cache size");
 
+    object_class_property_add(oc, "tb-workers", "uint32",
+        tcg_get_tb_workers, tcg_set_tb_workers,
+        NULL, NULL);
+    object_class_property_set_description(oc, "tb-workers",
+        "Threads translating likely next blocks in the background "
+        "(0 = off)");
+
     object_class_property_add_bool(oc, "split-wx",
         tcg_get_splitwx, tcg_set_splitwx);
     object_class_property_set_description(oc, "split-wx",
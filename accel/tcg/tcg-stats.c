@@ -16,6 +16,8 @@
 #include "tcg/tcg.h"
 #include "internal-common.h"
 #include "tb-context.h"
+#include "tb-worker.h"
+#include "tb-jmp-cache.h"
 #include <math.h>
 
 static void dump_drift_info(GString *buf)
@@ -153,6 +155,8 @@ static void tcg_dump_flush_info(GString *buf)
 
     g_string_append_printf(buf, "TB flush count      %u\n",
                            qatomic_read(&tb_ctx.tb_flush_count));
+    g_string_append_printf(buf, "TB reclaim count    %u\n",
+                           qatomic_read(&tb_ctx.tb_reclaim_count));
     g_string_append_printf(buf, "TB invalidate count %u\n",
                            qatomic_read(&tb_ctx.tb_phys_invalidate_count));
 
@@ -162,6 +166,70 @@ static void tcg_dump_flush_info(GString *buf)
     g_string_append_printf(buf, "TLB elided flushes  %zu\n", flush_elide);
 }
 
+/* How long a vCPU waited on a lookup miss, and what the workers saved */
+static void tcg_dump_miss_info(GString *buf)
+{
+    uint64_t misses = stat64_get(&tb_ctx.tb_miss_count);
+
+    g_string_append_printf(buf, "TB miss count       %" PRIu64 "\n", misses);
+    g_string_append_printf(buf, "TB miss to install  avg %" PRIu64
+                           " max %" PRIu64 " ns\n",
+                           misses ? stat64_get(&tb_ctx.tb_miss_ns) / misses : 0,
+                           stat64_get(&tb_ctx.tb_miss_max_ns));
+
+#ifndef CONFIG_USER_ONLY
+    if (tb_worker_count()) {
+        TBWorkerStats tws;
+
+        tb_worker_get_stats(&tws);
+        g_string_append_printf(buf, "TB workers          %u (%" PRIu64
+                               " queued, %" PRIu64 " dropped)\n",
+                               tb_worker_count(), tws.queued, tws.dropped);
+        g_string_append_printf(buf, "TB worker installs  %" PRIu64 "\n",
+                               tws.installed);
+        g_string_append_printf(buf, "TB queue to install avg %" PRIu64
+                               " max %" PRIu64 " ns\n",
+                               tws.installed ?
+                               tws.install_ns / tws.installed : 0,
+                               tws.install_max_ns);
+    }
+#endif
+}
+
+/* How often the vCPUs' jump caches saved a hash table lookup */
+static void tcg_dump_jmp_cache_info(GString *buf)
+{
+    CPUState *cpu;
+    size_t hits = 0, victim_hits = 0, misses = 0, resizes = 0, lookups;
+    unsigned max_bits = 0;
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        CPU_FOREACH(cpu) {
+            CPUJumpCache *jc = qatomic_rcu_read(&cpu->tb_jmp_cache);
+
+            if (!jc) {
+                continue;
+            }
+            hits += qatomic_read(&jc->hits);
+            victim_hits += qatomic_read(&jc->victim_hits);
+            misses += qatomic_read(&jc->misses);
+            resizes += qatomic_read(&jc->resizes);
+            max_bits = MAX(max_bits, jc->bits);
+        }
+    }
+    lookups = hits + victim_hits + misses;
+
+    g_string_append_printf(buf, "jump cache hits     %zu (%zu%%, "
+                           "%zu from victims)\n",
+                           hits + victim_hits,
+                           lookups ? ((hits + victim_hits) * 100) / lookups : 0,
+                           victim_hits);
+    g_string_append_printf(buf, "jump cache misses   %zu\n", misses);
+    g_string_append_printf(buf, "jump cache resizes  %zu (max %u sets of %d)\n",
+                           resizes, max_bits ? 1u << max_bits : 0,
+                           TB_JMP_CACHE_WAYS);
+}
+
 static void dump_exec_info(GString *buf)
 {
     struct tb_tree_stats tst = {};
@@ -202,6 +270,9 @@ static void dump_exec_info(GString *buf)
     print_qht_statistics(hst, buf);
     qht_statistics_destroy(&hst);
 
+    tcg_dump_miss_info(buf);
+    tcg_dump_jmp_cache_info(buf);
+
     g_string_append_printf(buf, "\nStatistics:\n");
     tcg_dump_flush_info(buf);
 }
@@ -257,26 +257,17 @@ static int setjmp_gen_code(CPUArchState *env, TranslationBlock *tb,
     return tcg_gen_code(tcg_ctx, tb, pc);
 }
 
-/* Called with mmap_lock held for user mode emulation.  */
-TranslationBlock *tb_gen_code(CPUState *cpu, TCGTBCPUState s)
+/* Translate @s, whose guest code is at @phys_pc and @host_pc. */
+static TranslationBlock *tb_gen_code_at(CPUState *cpu, TCGTBCPUState s,
+                                        tb_page_addr_t phys_pc,
+                                        void *host_pc)
 {
     CPUArchState *env = cpu_env(cpu);
     TranslationBlock *tb, *existing_tb;
-    tb_page_addr_t phys_pc, phys_p2;
+    tb_page_addr_t phys_p2;
     tcg_insn_unit *gen_code_buf;
     int gen_code_size, search_size, max_insns;
     int64_t ti;
-    void *host_pc;
-
-    assert_memory_lock();
-    qemu_thread_jit_write();
-
-    phys_pc = get_page_addr_code_hostp(env, s.pc, &host_pc);
-
-    if (phys_pc == -1) {
-        /* Generate a one-shot TB with 1 insn in it */
-        s.cflags = (s.cflags & ~CF_COUNT_MASK) | 1;
-    }
 
     max_insns = s.cflags & CF_COUNT_MASK;
     if (max_insns == 0) {
@@ -288,8 +279,11 @@ TranslationBlock *tb_gen_code(CPUState *cpu, TCGTBCPUState s)
     assert_no_pages_locked();
     tb = tcg_tb_alloc(tcg_ctx);
     if (unlikely(!tb)) {
-        /* flush must be done */
-        tb_flush(cpu);
+        if (tcg_ctx->gen_background) {
+            return NULL;
+        }
+        /* room must be made */
+        tb_reclaim(cpu);
         mmap_unlock();
         /* Make the execution loop process the flush as soon as possible.  */
         cpu->exception_index = EXCP_INTERRUPT;
@@ -377,6 +371,16 @@ TranslationBlock *tb_gen_code(CPUState *cpu, TCGTBCPUState s)
                           "Restarting code generation with re-locked pages");
             goto restart_translate;
 
+        case -4:
+            /*
+             * A background translation reached the second page.  Give
+             * back the TB and leave the block to the vCPU.
+             */
+            tb_unlock_pages(tb);
+            tcg_ctx->gen_tb = NULL;
+            qatomic_set(&tcg_ctx->code_gen_ptr, (void *)tb);
+            return NULL;
+
         default:
             g_assert_not_reached();
         }
@@ -534,6 +538,46 @@ TranslationBlock *tb_gen_code(CPUState *cpu, TCGTBCPUState s)
     return tb;
 }
 
+/* Called with mmap_lock held for user mode emulation.  */
+TranslationBlock *tb_gen_code(CPUState *cpu, TCGTBCPUState s)
+{
+    tb_page_addr_t phys_pc;
+    void *host_pc;
+
+    assert_memory_lock();
+    qemu_thread_jit_write();
+
+    phys_pc = get_page_addr_code_hostp(cpu_env(cpu), s.pc, &host_pc);
+
+    if (phys_pc == -1) {
+        /* Generate a one-shot TB with 1 insn in it */
+        s.cflags = (s.cflags & ~CF_COUNT_MASK) | 1;
+    }
+
+    return tb_gen_code_at(cpu, s, phys_pc, host_pc);
+}
+
+#ifndef CONFIG_USER_ONLY
+/*
+ * Translate @s on a tb-worker thread, from guest code that a vCPU has
+ * already mapped at @phys_pc and @host_pc.  Return NULL, rather than
+ * flushing or faulting, if the code buffer is full or the block would
+ * extend to a second page.
+ */
+TranslationBlock *tb_gen_code_background(CPUState *cpu, TCGTBCPUState s,
+                                         tb_page_addr_t phys_pc,
+                                         void *host_pc)
+{
+    TranslationBlock *tb;
+
+    qemu_thread_jit_write();
+    tcg_ctx->gen_background = true;
+    tb = tb_gen_code_at(cpu, s, phys_pc, host_pc);
+    tcg_ctx->gen_background = false;
+    return tb;
+}
+#endif
+
 /* user-mode: call with mmap_lock held */
 void tb_check_watchpoint(CPUState *cpu, uintptr_t retaddr)
 {
@@ -620,14 +664,21 @@ void cpu_io_recompile(CPUState *cpu, uintptr_t retaddr)
  */
 void tcg_flush_jmp_cache(CPUState *cpu)
 {
-    CPUJumpCache *jc = cpu->tb_jmp_cache;
+    CPUJumpCache *jc;
+
+    /* The owning CPU may replace its cache while another one flushes it */
+    RCU_READ_LOCK_GUARD();
+    jc = qatomic_rcu_read(&cpu->tb_jmp_cache);
 
     /* During early initialization, the cache may not yet be allocated. */
     if (unlikely(jc == NULL)) {
         return;
     }
 
-    for (int i = 0; i < TB_JMP_CACHE_SIZE; i++) {
+    for (size_t i = 0; i < tb_jmp_cache_entries(jc); i++) {
         qatomic_set(&jc->array[i].tb, NULL);
     }
+    for (int i = 0; i < TB_JMP_VICTIM_SIZE; i++) {
+        qatomic_set(&jc->victim[i].tb, NULL);
+    }
 }
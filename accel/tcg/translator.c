@@ -116,7 +116,15 @@ bool translator_use_goto_tb(DisasContextBase *db, vaddr dest)
     }
 
     /* Check for the dest on the same page as the start of the TB.  */
-    return translator_is_same_page(db, dest);
+    if (!translator_is_same_page(db, dest)) {
+        return false;
+    }
+
+    if (tcg_ctx->nb_gen_succ < ARRAY_SIZE(tcg_ctx->gen_succ) &&
+        (tcg_ctx->nb_gen_succ == 0 || tcg_ctx->gen_succ[0] != dest)) {
+        tcg_ctx->gen_succ[tcg_ctx->nb_gen_succ++] = dest;
+    }
+    return true;
 }
 
 void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
@@ -142,6 +150,7 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
     db->record_start = 0;
     db->record_len = 0;
     db->code_mmuidx = cpu_mmu_index(cpu, true);
+    tcg_ctx->nb_gen_succ = 0;
 
     ops->init_disas_context(db, cpu);
     tcg_debug_assert(db->is_jmp == DISAS_NEXT);  /* no early exit */
@@ -298,6 +307,14 @@ static bool translator_ld(CPUArchState *env, DisasContextBase *db,
     if (host == NULL) {
         tb_page_addr_t page0, old_page1, new_page1;
 
+        /*
+         * Mapping the second page needs the vCPU's TLB, which a
+         * background translation must not touch: abandon it.
+         */
+        if (tcg_ctx->gen_background) {
+            siglongjmp(tcg_ctx->jmp_trans, -4);
+        }
+
         new_page1 = get_page_addr_code_hostp(env, base, &db->host_addr[1]);
 
         /*
@@ -226,6 +226,21 @@ SRST
     Show the active virtual memory mappings.
 ERST
 
+#if defined(TARGET_RISCV)
+    {
+        .name       = "pwc",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show page-walk cache statistics",
+        .cmd        = hmp_info_pwc,
+    },
+#endif
+
+SRST
+  ``info pwc``
+    Show page-walk cache hit rates of each CPU (RISC-V only).
+ERST
+
     {
         .name       = "mtree",
         .args_type  = "flatview:-f,dispatch_tree:-d,owner:-o,disabled:-D",
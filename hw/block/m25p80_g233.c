@@ -9,16 +9,29 @@
 
 #include "qemu/osdep.h"
 #include "hw/ssi/ssi.h"
+#include "hw/block/flash.h"
 #include "hw/qdev-properties.h"
+#include "hw/qdev-properties-system.h"
+#include "system/block-backend.h"
+#include "system/memory.h"
 #include "migration/vmstate.h"
+#include "qemu/bitmap.h"
 #include "qemu/bitops.h"
+#include "qemu/error-report.h"
 #include "qemu/log.h"
 #include "qemu/module.h"
 #include "qapi/error.h"
+#include "system/runstate.h"
+#include "trace.h"
 
-#define TYPE_G233_FLASH "g233-flash"
 OBJECT_DECLARE_SIMPLE_TYPE(G233FlashState, G233_FLASH)
 
+/*
+ * Granularity of lazy page-in from, and write-back to, the drive.
+ * Matches the erase sector size.
+ */
+#define G233_FLASH_SECTOR_SIZE  4096
+
 /* Flash commands */
 #define CMD_JEDEC_ID    0x9F
 #define CMD_READ        0x03
@@ -28,6 +41,18 @@ OBJECT_DECLARE_SIMPLE_TYPE(G233FlashState, G233_FLASH)
 #define CMD_WRSR        0x01
 #define CMD_PP          0x02  /* Page Program */
 #define CMD_SE          0x20  /* Sector Erase */
+#define CMD_FAST_READ   0x0B
+#define CMD_DOR         0x3B  /* Fast Read Dual Output */
+#define CMD_QOR         0x6B  /* Fast Read Quad Output */
+#define CMD_QIOR        0xEB  /* Fast Read Quad I/O */
+
+/*
+ * Mode bits M5-4 = 10b after a Quad I/O address keep the part in
+ * continuous read mode: the next transaction starts with the address
+ * and skips the command byte.
+ */
+#define QIOR_MODE_CONT_MASK 0x30
+#define QIOR_MODE_CONT      0x20
 
 /* Status register bits */
 #define SR_WIP          0x01  /* Write In Progress */
@@ -36,6 +61,7 @@ typedef enum {
     STATE_IDLE,
     STATE_READING_CMD,
     STATE_READING_ID,
+    STATE_DUMMY,
     STATE_READING_DATA,
     STATE_READING_SR,
     STATE_WRITING_SR,
@@ -51,11 +77,28 @@ struct G233FlashState {
     uint32_t size;
     uint8_t jedec_id[3];
 
+    /*
+     * storage is the RAM behind the XIP window.  With a drive attached
+     * sectors are read in on first use, and written back from a bottom
+     * half once programmed or erased, or when the VM stops; the window
+     * stays in MMIO mode until the first access through it pulls in the
+     * whole image.
+     */
+    MemoryRegion xip;
+    bool romd;
+    unsigned long *loaded;
+    unsigned long *dirty;
+    int32_t nr_sectors;
+    QEMUBH *writeback_bh;
+    VMChangeStateEntry *vmstate;
+
     FlashState state;
     uint8_t cmd;
     uint32_t addr;
     int addr_bytes;
     int data_pos;
+    int dummy;
+    bool continuous;
 
     uint8_t status_reg;
     bool write_enable;
@@ -72,11 +115,143 @@ static void g233_flash_reset(Object *obj, ResetType type)
     s->addr = 0;
     s->addr_bytes = 0;
     s->data_pos = 0;
+    s->dummy = 0;
+    s->continuous = false;
     s->status_reg = 0;
     s->write_enable = false;
     s->page_pos = 0;
 }
 
+/* Make sure [addr, addr + len) of storage reflects the drive. */
+static void g233_flash_page_in(G233FlashState *s, uint32_t addr, uint32_t len)
+{
+    uint32_t first, last;
+
+    if (!len || addr >= s->size) {
+        return;
+    }
+    len = MIN(len, s->size - addr);
+    first = addr / G233_FLASH_SECTOR_SIZE;
+    last = (addr + len - 1) / G233_FLASH_SECTOR_SIZE;
+
+    for (uint32_t i = find_next_zero_bit(s->loaded, last + 1, first);
+         i <= last;
+         i = find_next_zero_bit(s->loaded, last + 1, i + 1)) {
+        uint32_t off = i * G233_FLASH_SECTOR_SIZE;
+        uint32_t n = MIN(G233_FLASH_SECTOR_SIZE, s->size - off);
+
+        if (blk_pread(s->blk, off, n, s->storage + off, 0) < 0) {
+            error_report("g233-flash: failed to read sector at 0x%x", off);
+            memset(s->storage + off, 0xFF, n);
+        }
+        set_bit(i, s->loaded);
+    }
+}
+
+/* Note a modification of storage made through the SPI interface. */
+static void g233_flash_mark_dirty(G233FlashState *s, uint32_t addr,
+                                  uint32_t len)
+{
+    if (!len) {
+        return;
+    }
+    bitmap_set(s->dirty, addr / G233_FLASH_SECTOR_SIZE,
+               (addr + len - 1) / G233_FLASH_SECTOR_SIZE -
+               addr / G233_FLASH_SECTOR_SIZE + 1);
+    memory_region_flush_rom_device(&s->xip, addr, len);
+    if (s->writeback_bh) {
+        qemu_bh_schedule(s->writeback_bh);
+    }
+}
+
+/* Write dirty sectors back to the drive, off the vCPU thread */
+static void g233_flash_writeback(void *opaque)
+{
+    G233FlashState *s = opaque;
+    unsigned long i;
+
+    if (!s->blk || !blk_is_writable(s->blk)) {
+        bitmap_zero(s->dirty, s->nr_sectors);
+        return;
+    }
+
+    for (i = find_first_bit(s->dirty, s->nr_sectors); i < s->nr_sectors;
+         i = find_next_bit(s->dirty, s->nr_sectors, i + 1)) {
+        uint32_t off = i * G233_FLASH_SECTOR_SIZE;
+        uint32_t n = MIN(G233_FLASH_SECTOR_SIZE, s->size - off);
+
+        trace_g233_flash_writeback(s, off, n);
+        if (blk_pwrite(s->blk, off, n, s->storage + off, 0) < 0) {
+            error_report("g233-flash: failed to write sector at 0x%x", off);
+        }
+        clear_bit(i, s->dirty);
+    }
+}
+
+/* Commit a pending page program at chip-select release. */
+static void g233_flash_program(G233FlashState *s)
+{
+    trace_g233_flash_page_program(s, s->addr, s->page_pos);
+    if (s->addr + s->page_pos <= s->size) {
+        g233_flash_page_in(s, s->addr, s->page_pos);
+        memcpy(s->storage + s->addr, s->page_buf, s->page_pos);
+        g233_flash_mark_dirty(s, s->addr, s->page_pos);
+    }
+    s->write_enable = false;
+}
+
+static uint64_t g233_flash_xip_read(void *opaque, hwaddr addr, unsigned size)
+{
+    G233FlashState *s = opaque;
+
+    /*
+     * Code fetch needs the window direct-mapped, so the first access
+     * brings in everything and leaves MMIO mode for good.
+     */
+    g233_flash_page_in(s, 0, s->size);
+    s->romd = true;
+    memory_region_rom_device_set_romd(&s->xip, true);
+
+    return ldn_le_p(s->storage + addr, size);
+}
+
+static void g233_flash_xip_write(void *opaque, hwaddr addr, uint64_t value,
+                                 unsigned size)
+{
+    qemu_log_mask(LOG_GUEST_ERROR,
+                  "g233-flash: write to read-only XIP window at 0x%" HWADDR_PRIx
+                  "\n", addr);
+}
+
+static const MemoryRegionOps g233_flash_xip_ops = {
+    .read = g233_flash_xip_read,
+    .write = g233_flash_xip_write,
+    .endianness = DEVICE_LITTLE_ENDIAN,
+    .valid = {
+        .min_access_size = 1,
+        .max_access_size = 8,
+    },
+};
+
+/*
+ * Bytes clocked between the address and the first data byte.  The SSI
+ * bus carries whole bytes, so dual and quad transfers deliver the same
+ * data as single-lane ones and only the framing differs.
+ */
+static int g233_flash_dummy_bytes(uint8_t cmd)
+{
+    switch (cmd) {
+    case CMD_FAST_READ:
+    case CMD_DOR:
+    case CMD_QOR:
+        return 1;
+    case CMD_QIOR:
+        return 3;   /* mode byte + 4 dummy clocks on four lanes */
+    default:
+        return 0;
+    }
+}
+
 static uint32_t g233_flash_transfer(SSIPeripheral *ss, uint32_t tx)
 {
     G233FlashState *s = G233_FLASH(ss);
@@ -85,6 +260,14 @@ static uint32_t g233_flash_transfer(SSIPeripheral *ss, uint32_t tx)
 
     switch (s->state) {
     case STATE_IDLE:
+        if (s->continuous) {
+            /* Continuous read mode: this is the first address byte */
+            s->cmd = CMD_QIOR;
+            s->state = STATE_READING_CMD;
+            s->addr = tx;
+            s->addr_bytes = 1;
+            break;
+        }
         s->cmd = tx;
         switch (tx) {
         case CMD_JEDEC_ID:
@@ -101,6 +284,10 @@ static uint32_t g233_flash_transfer(SSIPeripheral *ss, uint32_t tx)
             s->write_enable = false;
             break;
         case CMD_READ:
+        case CMD_FAST_READ:
+        case CMD_DOR:
+        case CMD_QOR:
+        case CMD_QIOR:
             s->state = STATE_READING_CMD;
             s->addr = 0;
             s->addr_bytes = 0;
@@ -144,13 +331,23 @@ static uint32_t g233_flash_transfer(SSIPeripheral *ss, uint32_t tx)
             if (s->cmd == CMD_READ) {
                 s->state = STATE_READING_DATA;
                 s->data_pos = 0;
+            } else if (g233_flash_dummy_bytes(s->cmd)) {
+                s->state = STATE_DUMMY;
+                s->dummy = 0;
+                s->data_pos = 0;
             } else if (s->cmd == CMD_PP) {
                 s->state = STATE_WRITING_DATA;
             } else if (s->cmd == CMD_SE) {
                 /* Erase 4KB sector */
                 uint32_t sector_addr = s->addr & ~0xFFF;
                 if (sector_addr < s->size) {
-                    memset(s->storage + sector_addr, 0xFF, 4096);
+                    uint32_t n = MIN(G233_FLASH_SECTOR_SIZE,
+                                     s->size - sector_addr);
+
+                    trace_g233_flash_sector_erase(s, sector_addr);
+                    memset(s->storage + sector_addr, 0xFF, n);
+                    set_bit(sector_addr / G233_FLASH_SECTOR_SIZE, s->loaded);
+                    g233_flash_mark_dirty(s, sector_addr, n);
                 }
                 s->write_enable = false;
                 s->state = STATE_IDLE;
@@ -158,8 +355,18 @@ static uint32_t g233_flash_transfer(SSIPeripheral *ss, uint32_t tx)
         }
         break;
 
+    case STATE_DUMMY:
+        if (s->cmd == CMD_QIOR && s->dummy == 0) {
+            s->continuous = (tx & QIOR_MODE_CONT_MASK) == QIOR_MODE_CONT;
+        }
+        if (++s->dummy >= g233_flash_dummy_bytes(s->cmd)) {
+            s->state = STATE_READING_DATA;
+        }
+        break;
+
     case STATE_READING_DATA:
         if (s->addr + s->data_pos < s->size) {
+            g233_flash_page_in(s, s->addr + s->data_pos, 1);
             rx = s->storage[s->addr + s->data_pos];
         } else {
             rx = 0xFF;
@@ -182,28 +389,45 @@ static uint32_t g233_flash_transfer(SSIPeripheral *ss, uint32_t tx)
     return rx & 0xFF;
 }
 
+/*
+ * Stream a run of bytes in one call.  Array reads, which dominate boot,
+ * are copied straight out of storage; anything else goes through the
+ * byte state machine.
+ */
+static void g233_flash_transfer_bulk(SSIPeripheral *ss, const uint8_t *tx,
+                                     uint8_t *rx, uint32_t len)
+{
+    G233FlashState *s = G233_FLASH(ss);
+
+    while (len) {
+        if (s->state == STATE_READING_DATA) {
+            uint32_t pos = s->addr + s->data_pos;
+            uint32_t n = pos < s->size ? MIN(len, s->size - pos) : 0;
+
+            if (n) {
+                g233_flash_page_in(s, pos, n);
+                memcpy(rx, s->storage + pos, n);
+            }
+            memset(rx + n, 0xFF, len - n);
+            s->data_pos += len;
+            return;
+        }
+        *rx++ = g233_flash_transfer(ss, *tx++);
+        len--;
+    }
+}
+
 static void g233_flash_cs(void *opaque, int n, int level)
 {
-    fprintf(stderr, "!!!FLASH_CS_CALLED!!! n=%d, level=%d\n", n, level);
     G233FlashState *s = G233_FLASH(opaque);
 
-    fprintf(stderr, "FLASH_CS: level=%d, state=%d, page_pos=%d\n", level, s->state, s->page_pos);
+    trace_g233_flash_select(s, level, s->state);
 
     if (level) {
         /* CS deasserted - complete operation */
         if (s->state == STATE_WRITING_DATA && s->page_pos > 0) {
             /* Write page buffer to flash - use the exact address from command */
-            if (s->addr + s->page_pos <= s->size) {
-                fprintf(stderr, "FLASH: Writing %d bytes to address 0x%x\n", s->page_pos, s->addr);
-                fprintf(stderr, "FLASH: First 10 bytes: ");
-                for (int i = 0; i < 10 && i < s->page_pos; i++) {
-                    fprintf(stderr, "%02x ", s->page_buf[i]);
-                }
-                fprintf(stderr, "\n");
-                memcpy(s->storage + s->addr, s->page_buf, s->page_pos);
-                fprintf(stderr, "FLASH: Write complete, storage[0]=0x%02x\n", s->storage[s->addr]);
-            }
-            s->write_enable = false;
+            g233_flash_program(s);
         }
         s->state = STATE_IDLE;
         s->data_pos = 0;
@@ -213,13 +437,39 @@ static void g233_flash_cs(void *opaque, int n, int level)
     }
 }
 
+/*
+ * Stopping the VM, which migration does before it gives up the drive,
+ * writes everything back first.
+ */
+static void g233_flash_vm_state_change(void *opaque, bool running,
+                                       RunState state)
+{
+    G233FlashState *s = opaque;
+
+    if (!running) {
+        qemu_bh_cancel(s->writeback_bh);
+        g233_flash_writeback(s);
+    }
+}
+
+static int g233_flash_post_load(void *opaque, int version_id)
+{
+    G233FlashState *s = opaque;
+
+    memory_region_rom_device_set_romd(&s->xip, s->romd);
+    return 0;
+}
+
 static const VMStateDescription vmstate_g233_flash = {
     .name = TYPE_G233_FLASH,
-    .version_id = 1,
+    .version_id = 2,
     .minimum_version_id = 1,
+    .post_load = g233_flash_post_load,
     .fields = (const VMStateField[]) {
         VMSTATE_UINT8(status_reg, G233FlashState),
         VMSTATE_BOOL(write_enable, G233FlashState),
+        VMSTATE_BOOL_V(romd, G233FlashState, 2),
+        VMSTATE_BITMAP(loaded, G233FlashState, 2, nr_sectors),
         VMSTATE_END_OF_LIST()
     }
 };
@@ -228,6 +478,7 @@ static void g233_flash_realize(SSIPeripheral *ss, Error **errp)
 {
     G233FlashState *s = G233_FLASH(ss);
     DeviceState *dev = DEVICE(ss);
+    g_autofree char *xip_name = NULL;
 
     /* Default to W25X16 (2MB) */
     if (!s->size) {
@@ -243,10 +494,45 @@ static void g233_flash_realize(SSIPeripheral *ss, Error **errp)
         s->jedec_id[2] = 0x16;  /* W25X32 */
     }
 
-    s->storage = g_malloc0(s->size);
+    if (s->blk) {
+        uint64_t perm = BLK_PERM_CONSISTENT_READ |
+                        (blk_supports_write_perm(s->blk) ? BLK_PERM_WRITE : 0);
+
+        if (blk_set_perm(s->blk, perm, BLK_PERM_ALL, errp) < 0) {
+            return;
+        }
+        if (blk_getlength(s->blk) < s->size) {
+            error_setg(errp, "drive is smaller than the %u byte flash",
+                       s->size);
+            return;
+        }
+    }
 
-    /* Initialize with 0xFF (erased state) */
-    memset(s->storage, 0xFF, s->size);
+    /* The RAMBlock idstr comes from this name: one per chip select */
+    xip_name = g_strdup_printf("g233-flash%u.xip", ss->cs_index);
+    if (!memory_region_init_rom_device(&s->xip, OBJECT(s),
+                                       &g233_flash_xip_ops, s,
+                                       xip_name, s->size, errp)) {
+        return;
+    }
+    s->storage = memory_region_get_ram_ptr(&s->xip);
+
+    s->nr_sectors = DIV_ROUND_UP(s->size, G233_FLASH_SECTOR_SIZE);
+    s->loaded = bitmap_new(s->nr_sectors);
+    s->dirty = bitmap_new(s->nr_sectors);
+
+    if (s->blk) {
+        /* Contents arrive on demand, see g233_flash_page_in() */
+        memory_region_rom_device_set_romd(&s->xip, false);
+        s->writeback_bh = qemu_bh_new(g233_flash_writeback, s);
+        s->vmstate = qemu_add_vm_change_state_handler(
+            g233_flash_vm_state_change, s);
+    } else {
+        /* Initialize with 0xFF (erased state) */
+        memset(s->storage, 0xFF, s->size);
+        bitmap_fill(s->loaded, s->nr_sectors);
+        s->romd = true;
+    }
 
     qdev_init_gpio_in_named(dev, g233_flash_cs, SSI_GPIO_CS, 1);
 }
@@ -254,25 +540,37 @@ static void g233_flash_realize(SSIPeripheral *ss, Error **errp)
 static void g233_flash_finalize(Object *obj)
 {
     G233FlashState *s = G233_FLASH(obj);
-    g_free(s->storage);
+
+    if (s->vmstate) {
+        qemu_del_vm_change_state_handler(s->vmstate);
+    }
+    if (s->writeback_bh) {
+        qemu_bh_delete(s->writeback_bh);
+    }
+    g_free(s->loaded);
+    g_free(s->dirty);
+}
+
+MemoryRegion *g233_flash_get_xip(DeviceState *dev)
+{
+    return &G233_FLASH(dev)->xip;
 }
 
 static const Property g233_flash_properties[] = {
     DEFINE_PROP_UINT32("size", G233FlashState, size, 0),
+    DEFINE_PROP_DRIVE("drive", G233FlashState, blk),
 };
 
 static int g233_flash_set_cs(SSIPeripheral *ss, bool select)
 {
     G233FlashState *s = G233_FLASH(ss);
 
+    trace_g233_flash_select(s, !select, s->state);
     if (!select) {
         /* CS deasserted (going high) - complete operation */
         if (s->state == STATE_WRITING_DATA && s->page_pos > 0) {
             /* Write page buffer to flash */
-            if (s->addr + s->page_pos <= s->size) {
-                memcpy(s->storage + s->addr, s->page_buf, s->page_pos);
-            }
-            s->write_enable = false;
+            g233_flash_program(s);
         }
         s->state = STATE_IDLE;
         s->data_pos = 0;
@@ -292,6 +590,7 @@ static void g233_flash_class_init(ObjectClass *klass, const void *data)
 
     k->realize = g233_flash_realize;
     k->transfer = g233_flash_transfer;
+    k->transfer_bulk = g233_flash_transfer_bulk;
     k->set_cs = g233_flash_set_cs;
     k->cs_polarity = SSI_CS_LOW;
     rc->phases.hold = g233_flash_reset;
@@ -0,0 +1,436 @@
+/*
+ * QEMU model of the G233 DMA Controller
+ *
+ * Copyright (c) 2025 Learning QEMU 2025
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * An asynchronous counterpart of the G233 custom_dma/crush/expand
+ * instructions.  The guest points DESC at a chain of descriptors and
+ * rings DOORBELL; the chain then runs in a bottom half on the main loop
+ * while the vCPUs keep executing, and DONE (or ERR) is raised on the
+ * PLIC when it finishes.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bitops.h"
+#include "qemu/bswap.h"
+#include "qemu/log.h"
+#include "qemu/main-loop.h"
+#include "qemu/module.h"
+#include "qemu/units.h"
+#include "hw/irq.h"
+#include "hw/sysbus.h"
+#include "migration/vmstate.h"
+#include "system/dma.h"
+#include "system/address-spaces.h"
+#include "hw/dma/g233_dma.h"
+#include "trace.h"
+
+/* Descriptors run per bottom-half invocation before yielding. */
+#define G233_DMA_BURST 16
+/* Largest source a single descriptor may name. */
+#define G233_DMA_MAX_LEN (16 * MiB)
+
+typedef struct G233DMABuffer {
+    void *host;
+    dma_addr_t addr;
+    dma_addr_t len;
+    DMADirection dir;
+    bool mapped;
+} G233DMABuffer;
+
+static void g233_dma_update_irq(G233DMAState *s)
+{
+    bool level = false;
+
+    if ((s->ctrl & G233_DMA_CTRL_DONEIE) && (s->status & G233_DMA_STATUS_DONE)) {
+        level = true;
+    }
+    if ((s->ctrl & G233_DMA_CTRL_ERRIE) && (s->status & G233_DMA_STATUS_ERR)) {
+        level = true;
+    }
+
+    qemu_set_irq(s->irq, level);
+}
+
+/*
+ * Map @len bytes at @addr for the engine.  RAM is used in place through
+ * dma_memory_map(); anything else (MMIO, a short mapping, or a source
+ * that must not alias the destination) goes through a bounce buffer.
+ */
+static bool g233_dma_buf_get(G233DMAState *s, G233DMABuffer *b,
+                             dma_addr_t addr, dma_addr_t len,
+                             DMADirection dir, bool bounce)
+{
+    dma_addr_t maplen = len;
+
+    b->addr = addr;
+    b->len = len;
+    b->dir = dir;
+    b->mapped = false;
+
+    if (!bounce) {
+        b->host = dma_memory_map(s->as, addr, &maplen, dir,
+                                 MEMTXATTRS_UNSPECIFIED);
+        if (b->host && maplen == len) {
+            b->mapped = true;
+            return true;
+        }
+        if (b->host) {
+            dma_memory_unmap(s->as, b->host, maplen, dir, 0);
+        }
+    }
+
+    b->host = g_malloc(len);
+    if (dir == DMA_DIRECTION_TO_DEVICE &&
+        dma_memory_read(s->as, addr, b->host, len,
+                        MEMTXATTRS_UNSPECIFIED) != MEMTX_OK) {
+        g_free(b->host);
+        b->host = NULL;
+        return false;
+    }
+    return true;
+}
+
+static bool g233_dma_buf_put(G233DMAState *s, G233DMABuffer *b, bool done)
+{
+    bool ok = true;
+
+    if (b->mapped) {
+        dma_memory_unmap(s->as, b->host, b->len, b->dir, done ? b->len : 0);
+        return true;
+    }
+
+    if (done && b->dir == DMA_DIRECTION_FROM_DEVICE) {
+        ok = dma_memory_write(s->as, b->addr, b->host, b->len,
+                              MEMTXATTRS_UNSPECIFIED) == MEMTX_OK;
+    }
+    g_free(b->host);
+    return ok;
+}
+
+static void g233_dma_transpose(uint8_t *dst, const uint8_t *src, int n)
+{
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            stl_he_p(dst + (i * n + j) * sizeof(uint32_t),
+                     ldl_he_p(src + (j * n + i) * sizeof(uint32_t)));
+        }
+    }
+}
+
+static void g233_dma_crush(uint8_t *dst, const uint8_t *src, dma_addr_t len)
+{
+    dma_addr_t i;
+
+    for (i = 0; i + 1 < len; i += 2) {
+        dst[i / 2] = (src[i] & 0x0F) | ((src[i + 1] & 0x0F) << 4);
+    }
+    if (i < len) {
+        dst[i / 2] = src[i] & 0x0F;
+    }
+}
+
+static void g233_dma_expand(uint8_t *dst, const uint8_t *src, dma_addr_t len)
+{
+    for (dma_addr_t i = 0; i < len; i++) {
+        dst[2 * i] = src[i] & 0x0F;
+        dst[2 * i + 1] = (src[i] >> 4) & 0x0F;
+    }
+}
+
+/* Run the descriptor at @addr, returning the next one through @next. */
+static bool g233_dma_run_desc(G233DMAState *s, dma_addr_t addr,
+                              dma_addr_t *next)
+{
+    uint32_t ctrl, len;
+    uint64_t src, dst;
+    dma_addr_t src_len, dst_len;
+    G233DMABuffer sbuf, dbuf;
+    int op, n = 0;
+    bool overlap, ok;
+
+    if (ldl_le_dma(s->as, addr, &ctrl, MEMTXATTRS_UNSPECIFIED) ||
+        ldl_le_dma(s->as, addr + 0x04, &len, MEMTXATTRS_UNSPECIFIED) ||
+        ldq_le_dma(s->as, addr + 0x08, &src, MEMTXATTRS_UNSPECIFIED) ||
+        ldq_le_dma(s->as, addr + 0x10, &dst, MEMTXATTRS_UNSPECIFIED) ||
+        ldq_le_dma(s->as, addr + 0x18, next, MEMTXATTRS_UNSPECIFIED)) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "g233_dma: cannot read descriptor at 0x%" PRIx64 "\n",
+                      (uint64_t)addr);
+        return false;
+    }
+
+    op = ctrl & G233_DMA_DESC_OP_MASK;
+    trace_g233_dma_desc(addr, op, len, src, dst);
+
+    switch (op) {
+    case G233_DMA_OP_COPY:
+        src_len = dst_len = len;
+        break;
+    case G233_DMA_OP_TRANSPOSE:
+        n = 8 << G233_DMA_DESC_GRAIN(ctrl);
+        if (n > 32) {
+            n = 8;  /* reserved grain, as custom_dma */
+        }
+        src_len = dst_len = n * n * sizeof(uint32_t);
+        break;
+    case G233_DMA_OP_CRUSH:
+        src_len = len;
+        dst_len = ((dma_addr_t)len + 1) / 2;
+        break;
+    case G233_DMA_OP_EXPAND:
+        src_len = len;
+        dst_len = (dma_addr_t)len * 2;
+        break;
+    default:
+        qemu_log_mask(LOG_GUEST_ERROR, "g233_dma: bad op %d\n", op);
+        return false;
+    }
+
+    if (src_len == 0) {
+        return true;
+    }
+    if (src_len > G233_DMA_MAX_LEN) {
+        qemu_log_mask(LOG_GUEST_ERROR, "g233_dma: length %u too large\n", len);
+        return false;
+    }
+
+    overlap = src < dst + dst_len && dst < src + src_len;
+    if (!g233_dma_buf_get(s, &sbuf, src, src_len,
+                          DMA_DIRECTION_TO_DEVICE, overlap)) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "g233_dma: cannot read 0x%" PRIx64 "\n", src);
+        return false;
+    }
+    g233_dma_buf_get(s, &dbuf, dst, dst_len, DMA_DIRECTION_FROM_DEVICE, false);
+
+    switch (op) {
+    case G233_DMA_OP_COPY:
+        memcpy(dbuf.host, sbuf.host, len);
+        break;
+    case G233_DMA_OP_TRANSPOSE:
+        g233_dma_transpose(dbuf.host, sbuf.host, n);
+        break;
+    case G233_DMA_OP_CRUSH:
+        g233_dma_crush(dbuf.host, sbuf.host, len);
+        break;
+    case G233_DMA_OP_EXPAND:
+        g233_dma_expand(dbuf.host, sbuf.host, len);
+        break;
+    }
+
+    g233_dma_buf_put(s, &sbuf, true);
+    ok = g233_dma_buf_put(s, &dbuf, true);
+    if (!ok) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "g233_dma: cannot write 0x%" PRIx64 "\n", dst);
+    }
+    return ok;
+}
+
+static void g233_dma_bh(void *opaque)
+{
+    G233DMAState *s = opaque;
+
+    for (int i = 0; i < G233_DMA_BURST; i++) {
+        dma_addr_t next;
+
+        if (!(s->status & G233_DMA_STATUS_BUSY)) {
+            return;
+        }
+        if (!(s->ctrl & G233_DMA_CTRL_EN)) {
+            /* Disabling the engine aborts the chain. */
+            s->status &= ~G233_DMA_STATUS_BUSY;
+            return;
+        }
+
+        if (!g233_dma_run_desc(s, s->desc, &next)) {
+            s->status &= ~G233_DMA_STATUS_BUSY;
+            s->status |= G233_DMA_STATUS_ERR;
+            trace_g233_dma_done(s->completed, true);
+            g233_dma_update_irq(s);
+            return;
+        }
+
+        s->completed++;
+        s->desc = next;
+        if (next == 0) {
+            s->status &= ~G233_DMA_STATUS_BUSY;
+            s->status |= G233_DMA_STATUS_DONE;
+            trace_g233_dma_done(s->completed, false);
+            g233_dma_update_irq(s);
+            return;
+        }
+    }
+
+    /* Let the rest of the main loop run before the next burst. */
+    qemu_bh_schedule(s->bh);
+}
+
+static uint64_t g233_dma_read(void *opaque, hwaddr addr, unsigned size)
+{
+    G233DMAState *s = G233_DMA(opaque);
+
+    switch (addr) {
+    case G233_DMA_CTRL:
+        return s->ctrl;
+    case G233_DMA_STATUS:
+        return s->status;
+    case G233_DMA_DESC_LO:
+        return extract64(s->desc, 0, 32);
+    case G233_DMA_DESC_HI:
+        return extract64(s->desc, 32, 32);
+    case G233_DMA_DOORBELL:
+        return 0;
+    case G233_DMA_COMPLETED:
+        return s->completed;
+    default:
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "g233_dma_read: Bad offset 0x%" HWADDR_PRIx "\n", addr);
+        return 0;
+    }
+}
+
+static void g233_dma_write(void *opaque, hwaddr addr, uint64_t value,
+                           unsigned size)
+{
+    G233DMAState *s = G233_DMA(opaque);
+
+    switch (addr) {
+    case G233_DMA_CTRL:
+        s->ctrl = value & (G233_DMA_CTRL_EN | G233_DMA_CTRL_DONEIE |
+                           G233_DMA_CTRL_ERRIE);
+        g233_dma_update_irq(s);
+        break;
+    case G233_DMA_STATUS:
+        s->status &= ~(value & (G233_DMA_STATUS_DONE | G233_DMA_STATUS_ERR));
+        g233_dma_update_irq(s);
+        break;
+    case G233_DMA_DESC_LO:
+        if (!(s->status & G233_DMA_STATUS_BUSY)) {
+            s->desc = deposit64(s->desc, 0, 32, value);
+        }
+        break;
+    case G233_DMA_DESC_HI:
+        if (!(s->status & G233_DMA_STATUS_BUSY)) {
+            s->desc = deposit64(s->desc, 32, 32, value);
+        }
+        break;
+    case G233_DMA_DOORBELL:
+        if (!(value & 1) || (s->status & G233_DMA_STATUS_BUSY)) {
+            break;
+        }
+        if (!(s->ctrl & G233_DMA_CTRL_EN)) {
+            qemu_log_mask(LOG_GUEST_ERROR,
+                          "g233_dma: doorbell while disabled\n");
+            break;
+        }
+        trace_g233_dma_start(s->desc);
+        s->completed = 0;
+        s->status &= ~(G233_DMA_STATUS_DONE | G233_DMA_STATUS_ERR);
+        s->status |= G233_DMA_STATUS_BUSY;
+        g233_dma_update_irq(s);
+        qemu_bh_schedule(s->bh);
+        break;
+    case G233_DMA_COMPLETED:
+        break;
+    default:
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "g233_dma_write: Bad offset 0x%" HWADDR_PRIx "\n", addr);
+        break;
+    }
+}
+
+static const MemoryRegionOps g233_dma_ops = {
+    .read = g233_dma_read,
+    .write = g233_dma_write,
+    .endianness = DEVICE_LITTLE_ENDIAN,
+    .valid = {
+        .min_access_size = 4,
+        .max_access_size = 4,
+    },
+};
+
+static void g233_dma_reset(Object *obj, ResetType type)
+{
+    G233DMAState *s = G233_DMA(obj);
+
+    qemu_bh_cancel(s->bh);
+    s->ctrl = 0;
+    s->status = 0;
+    s->desc = 0;
+    s->completed = 0;
+    g233_dma_update_irq(s);
+}
+
+static void g233_dma_realize(DeviceState *dev, Error **errp)
+{
+    G233DMAState *s = G233_DMA(dev);
+
+    s->as = &address_space_memory;
+    s->bh = qemu_bh_new_guarded(g233_dma_bh, s, &dev->mem_reentrancy_guard);
+
+    sysbus_init_irq(SYS_BUS_DEVICE(dev), &s->irq);
+    memory_region_init_io(&s->iomem, OBJECT(s), &g233_dma_ops, s,
+                          TYPE_G233_DMA, G233_DMA_REG_SIZE);
+    sysbus_init_mmio(SYS_BUS_DEVICE(s), &s->iomem);
+}
+
+static void g233_dma_unrealize(DeviceState *dev)
+{
+    G233DMAState *s = G233_DMA(dev);
+
+    qemu_bh_delete(s->bh);
+}
+
+static int g233_dma_post_load(void *opaque, int version_id)
+{
+    G233DMAState *s = opaque;
+
+    /* Resume a chain that was in flight when the state was saved. */
+    if (s->status & G233_DMA_STATUS_BUSY) {
+        qemu_bh_schedule(s->bh);
+    }
+    return 0;
+}
+
+static const VMStateDescription vmstate_g233_dma = {
+    .name = TYPE_G233_DMA,
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .post_load = g233_dma_post_load,
+    .fields = (const VMStateField[]) {
+        VMSTATE_UINT32(ctrl, G233DMAState),
+        VMSTATE_UINT32(status, G233DMAState),
+        VMSTATE_UINT64(desc, G233DMAState),
+        VMSTATE_UINT32(completed, G233DMAState),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
+static void g233_dma_class_init(ObjectClass *klass, const void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+    ResettableClass *rc = RESETTABLE_CLASS(klass);
+
+    dc->realize = g233_dma_realize;
+    dc->unrealize = g233_dma_unrealize;
+    rc->phases.hold = g233_dma_reset;
+    dc->vmsd = &vmstate_g233_dma;
+}
+
+static const TypeInfo g233_dma_info = {
+    .name          = TYPE_G233_DMA,
+    .parent        = TYPE_SYS_BUS_DEVICE,
+    .instance_size = sizeof(G233DMAState),
+    .class_init    = g233_dma_class_init,
+};
+
+static void g233_dma_register_types(void)
+{
+    type_register_static(&g233_dma_info);
+}
+
+type_init(g233_dma_register_types)
@@ -30,21 +30,27 @@
 #include "hw/sysbus.h"
 #include "hw/riscv/g233.h"
 #include "hw/riscv/boot.h"
+#include "hw/riscv/numa.h"
 #include "hw/intc/riscv_aclint.h"
 #include "hw/intc/sifive_plic.h"
 #include "hw/misc/unimp.h"
 #include "hw/char/pl011.h"
 #include "hw/ssi/ssi.h"
 #include "system/block-backend.h"
+#include "system/blockdev.h"
+#include "hw/block/flash.h"
 
 static const MemMapEntry g233_memmap[] = {
     [G233_DEV_MROM] =     {     0x1000,     0x2000 },
     [G233_DEV_CLINT] =    {  0x2000000,    0x10000 },
-    [G233_DEV_PLIC] =     {  0xc000000,  0x4000000 },
+    [G233_DEV_PLIC] =     {  0xc000000, G233_PLIC_SIZE(G233_CPUS_MAX) },
     [G233_DEV_UART0] =    { 0x10000000,     0x1000 },
     [G233_DEV_GPIO0] =    { 0x10012000,     0x1000 },
     [G233_DEV_PWM0] =     { 0x10015000,     0x1000 },
     [G233_DEV_SPI0] =     { 0x10018000,     0x1000 },
+    [G233_DEV_DMA] =      { 0x10019000,     0x1000 },
+    [G233_DEV_XIP0] =     { 0x20000000,   0x200000 },
+    [G233_DEV_XIP1] =     { 0x20400000,   0x400000 },
     [G233_DEV_DRAM] =     { 0x80000000, 0x40000000 },
 };
 
@@ -57,16 +63,89 @@ static void g233_soc_init(Object *obj)
      */
     G233SoCState *s = RISCV_G233_SOC(obj);
 
-    /* CPU 子系统初始化 */
-    object_initialize_child(obj, "g233-cpus", &s->cpus, TYPE_RISCV_HART_ARRAY);
-    qdev_prop_set_uint32(DEVICE(&s->cpus), "num-harts", 1);
-    qdev_prop_set_uint32(DEVICE(&s->cpus), "hartid-base", 0);
-    qdev_prop_set_string(DEVICE(&s->cpus), "cpu-type",
-                         TYPE_RISCV_CPU_GEVICO_G233);
-    qdev_prop_set_uint64(DEVICE(&s->cpus), "resetvec", 0x1004);
-
     /* gpio */
     object_initialize_child(obj, "sifive.gpio0", &s->gpio, TYPE_SIFIVE_GPIO);
+
+    /* dma */
+    object_initialize_child(obj, "g233.dma", &s->dma, TYPE_G233_DMA);
+}
+
+/* Every hart has a single M-mode PLIC context */
+static char *g233_plic_hart_config(int hart_count)
+{
+    g_autofree const char **vals = g_new(const char *, hart_count + 1);
+    int i;
+
+    for (i = 0; i < hart_count; i++) {
+        vals[i] = G233_PLIC_HART_CONFIG;
+    }
+    vals[i] = NULL;
+
+    /* g_strjoinv() obliges us to cast away const here */
+    return g_strjoinv(",", (char **)vals);
+}
+
+/*
+ * Harts, CLINT and PLIC of one socket.  Socket N's CLINT and PLIC sit
+ * N apertures above socket 0's.
+ */
+static bool g233_soc_realize_socket(G233SoCState *s, int socket, Error **errp)
+{
+    MachineState *ms = MACHINE(qdev_get_machine());
+    const MemMapEntry *memmap = g233_memmap;
+    g_autofree char *name = g_strdup_printf("g233-cpus%d", socket);
+    g_autofree char *hart_config = NULL;
+    int base_hartid, hart_count;
+    hwaddr clint_base, plic_base;
+
+    if (!riscv_socket_check_hartids(ms, socket)) {
+        error_setg(errp, "discontinuous hartids in socket%d", socket);
+        return false;
+    }
+    base_hartid = riscv_socket_first_hartid(ms, socket);
+    hart_count = riscv_socket_hart_count(ms, socket);
+    if (base_hartid < 0 || hart_count < 0) {
+        error_setg(errp, "can't find harts for socket%d", socket);
+        return false;
+    }
+
+    /* CPU 子系统初始化 */
+    object_initialize_child(OBJECT(s), name, &s->cpus[socket],
+                            TYPE_RISCV_HART_ARRAY);
+    qdev_prop_set_uint32(DEVICE(&s->cpus[socket]), "num-harts", hart_count);
+    qdev_prop_set_uint32(DEVICE(&s->cpus[socket]), "hartid-base",
+                         base_hartid);
+    qdev_prop_set_string(DEVICE(&s->cpus[socket]), "cpu-type", ms->cpu_type);
+    qdev_prop_set_uint64(DEVICE(&s->cpus[socket]), "resetvec", 0x1004);
+    if (!sysbus_realize(SYS_BUS_DEVICE(&s->cpus[socket]), errp)) {
+        return false;
+    }
+
+    clint_base = memmap[G233_DEV_CLINT].base +
+                 socket * memmap[G233_DEV_CLINT].size;
+    riscv_aclint_swi_create(clint_base, base_hartid, hart_count, false);
+    riscv_aclint_mtimer_create(clint_base + RISCV_ACLINT_SWI_SIZE,
+                               RISCV_ACLINT_DEFAULT_MTIMER_SIZE,
+                               base_hartid, hart_count,
+                               RISCV_ACLINT_DEFAULT_MTIMECMP,
+                               RISCV_ACLINT_DEFAULT_MTIME,
+                               32768, false); /* TODO: set default freq */
+
+    plic_base = memmap[G233_DEV_PLIC].base +
+                socket * memmap[G233_DEV_PLIC].size;
+    hart_config = g233_plic_hart_config(hart_count);
+    s->plic[socket] = sifive_plic_create(plic_base, hart_config,
+                                         hart_count, base_hartid,
+                                         G233_PLIC_NUM_SOURCES,
+                                         G233_PLIC_NUM_PRIORITIES,
+                                         G233_PLIC_PRIORITY_BASE,
+                                         G233_PLIC_PENDING_BASE,
+                                         G233_PLIC_ENABLE_BASE,
+                                         G233_PLIC_ENABLE_STRIDE,
+                                         G233_PLIC_CONTEXT_BASE,
+                                         G233_PLIC_CONTEXT_STRIDE,
+                                         memmap[G233_DEV_PLIC].size);
+    return true;
 }
 
 /* 完成硬件模拟准备 */
@@ -76,42 +155,27 @@ static void g233_soc_realize(DeviceState *dev, Error **errp)
     G233SoCState *s = RISCV_G233_SOC(dev);
     MemoryRegion *sys_mem = get_system_memory();
     const MemMapEntry *memmap = g233_memmap;
+    int socket_count = riscv_socket_count(ms);
 
-    /* CPUs realize */
-    if (!sysbus_realize(SYS_BUS_DEVICE(&s->cpus), errp)) {
+    if (socket_count > G233_SOCKETS_MAX) {
+        error_setg(errp, "number of sockets/nodes should be at most %d",
+                   G233_SOCKETS_MAX);
         return;
     }
 
+    /* CPUs, CLINTs and PLICs; on-chip peripherals interrupt socket 0 */
+    for (int i = 0; i < socket_count; i++) {
+        if (!g233_soc_realize_socket(s, i, errp)) {
+            return;
+        }
+    }
+
     /* Mask ROM */
     memory_region_init_rom(&s->mask_rom, OBJECT(dev), "riscv.g233.mrom",
                            memmap[G233_DEV_MROM].size, &error_fatal);
     memory_region_add_subregion(sys_mem, memmap[G233_DEV_MROM].base,
                                 &s->mask_rom);
 
-    /* MMIO */
-    /* 设备模型方式 */
-    s->plic = sifive_plic_create(memmap[G233_DEV_PLIC].base,
-                                 (char *)G233_PLIC_HART_CONFIG,
-                                 ms->smp.cpus, 0,
-                                 G233_PLIC_NUM_SOURCES,
-                                 G233_PLIC_NUM_PRIORITIES,
-                                 G233_PLIC_PRIORITY_BASE,
-                                 G233_PLIC_PENDING_BASE,
-                                 G233_PLIC_ENABLE_BASE,
-                                 G233_PLIC_ENABLE_STRIDE,
-                                 G233_PLIC_CONTEXT_BASE,
-                                 G233_PLIC_CONTEXT_STRIDE,
-                                 memmap[G233_DEV_PLIC].size);
-    riscv_aclint_swi_create(memmap[G233_DEV_CLINT].base,
-                            0, ms->smp.cpus, false);
-    riscv_aclint_mtimer_create(memmap[G233_DEV_CLINT].base +
-                               RISCV_ACLINT_SWI_SIZE,
-                               RISCV_ACLINT_DEFAULT_MTIMER_SIZE,
-                               0, ms->smp.cpus,
-                               RISCV_ACLINT_DEFAULT_MTIMECMP,
-                               RISCV_ACLINT_DEFAULT_MTIME,
-                               32768, false); /* TODO: set default freq */
-
     /* GPIO */
     if (!sysbus_realize(SYS_BUS_DEVICE(&s->gpio), errp)) {
         return;
@@ -126,13 +190,13 @@ static void g233_soc_realize(DeviceState *dev, Error **errp)
     /* Connect GPIO interrupts to the PLIC */
     for (int i = 0; i < 32; i++) {
         sysbus_connect_irq(SYS_BUS_DEVICE(&s->gpio), i,
-                           qdev_get_gpio_in(DEVICE(s->plic),
+                           qdev_get_gpio_in(DEVICE(s->plic[0]),
                                             G233_GPIO0_IRQ0 + i));
     }
 
     /* Add UART (PL011) */
     s->uart0 = pl011_create(memmap[G233_DEV_UART0].base,
-                            qdev_get_gpio_in(DEVICE(s->plic), G233_UART0_IRQ),
+                            qdev_get_gpio_in(DEVICE(s->plic[0]), G233_UART0_IRQ),
                             serial_hd(0));
 
     /* SiFive.PWM0 */
@@ -148,7 +212,15 @@ static void g233_soc_realize(DeviceState *dev, Error **errp)
                     memmap[G233_DEV_SPI0].base);
     /* 将 SPI 控制器的中断输出连接到 PLIC（中断控制器） 的输入 */
     sysbus_connect_irq(SYS_BUS_DEVICE(s->spi0), 0,
-                       qdev_get_gpio_in(DEVICE(s->plic), G233_SPI0_IRQ));
+                       qdev_get_gpio_in(DEVICE(s->plic[0]), G233_SPI0_IRQ));
+
+    /* DMA */
+    if (!sysbus_realize(SYS_BUS_DEVICE(&s->dma), errp)) {
+        return;
+    }
+    sysbus_mmio_map(SYS_BUS_DEVICE(&s->dma), 0, memmap[G233_DEV_DMA].base);
+    sysbus_connect_irq(SYS_BUS_DEVICE(&s->dma), 0,
+                       qdev_get_gpio_in(DEVICE(s->plic[0]), G233_DMA_IRQ));
 }
 
 static void g233_soc_class_init(ObjectClass *oc, const void *data)
@@ -214,7 +286,7 @@ static void g233_machine_init(MachineState *machine)
                           memmap[G233_DEV_MROM].base, &address_space_memory);
 
     /* 初始化引导信息结构体 */
-    riscv_boot_info_init(&boot_info, &s->soc.cpus);
+    riscv_boot_info_init(&boot_info, &s->soc.cpus[0]);
     if (machine->kernel_filename) {
         riscv_load_kernel(machine, &boot_info,
                           memmap[G233_DEV_DRAM].base,
@@ -222,47 +294,40 @@ static void g233_machine_init(MachineState *machine)
     }
 
     {
-        /* Connect 2 flash to SPI0 */
+        /*
+         * Connect 2 flash to SPI0: W25X16 (2MB) on CS0 and W25X32 (4MB)
+         * on CS1.  "-drive if=mtd,index=N" backs flash N with an image,
+         * and each flash is also readable through its XIP window.
+         */
+        static const struct {
+            uint32_t size;
+            int xip;
+        } flashes[] = {
+            { 2 * 1024 * 1024, G233_DEV_XIP0 },
+            { 4 * 1024 * 1024, G233_DEV_XIP1 },
+        };
         SSIBus *spi_bus0 = (SSIBus *)qdev_get_child_bus(s->soc.spi0, "ssi");
-        // BlockBackend *blk0, *blk1;
-        DeviceState *flash_dev0, *flash_dev1;
-        qemu_irq flash_cs0, flash_cs1;
-
-        /* Flash 0: W25X16 (2MB) on CS0 */
-        
-        // flash_dev0 = qdev_new("w25x16");
-        // qdev_prop_set_uint8(flash_dev0, "cs", 0);
-        // blk0 = blk_by_name("flash0");
-        // qdev_prop_set_drive_err(flash_dev0, "drive", blk0, &error_fatal);
-        // qdev_realize_and_unref(flash_dev0, BUS(s->soc.spi0.ssi), &error_fatal);
-        // flash_cs0 = qdev_get_gpio_in_named(flash_dev0, SSI_GPIO_CS, 0);
-        // sysbus_connect_irq(SYS_BUS_DEVICE(&s->soc.spi0), 1, flash_cs0);
-        
-        flash_dev0 = qdev_new("g233-flash");
-        qdev_prop_set_uint8(flash_dev0, "cs", 0);
-        qdev_prop_set_uint32(flash_dev0, "size", 2 * 1024 * 1024);
-        qdev_realize_and_unref(flash_dev0, BUS(spi_bus0), &error_fatal);
-        flash_cs0 = qdev_get_gpio_in_named(flash_dev0, SSI_GPIO_CS, 0);
-        /* 将 SPI 控制器的片选(CS)输出连接到 Flash 设备的片选输入 */
-        qdev_connect_gpio_out_named(s->soc.spi0, SSI_GPIO_CS, 0, flash_cs0);
-
-        /* Flash 1: W25X32 (4MB) on CS1 */
-
-        // flash_dev1 = qdev_new("w25x32");
-        // qdev_prop_set_uint8(flash_dev1, "cs", 1);
-        // blk1 = blk_by_name("flash1");
-        // qdev_prop_set_drive_err(flash_dev1, "drive", blk1, &error_fatal);
-        // qdev_realize_and_unref(flash_dev1, BUS(s->soc.spi0.ssi), &error_fatal);
-        // flash_cs1 = qdev_get_gpio_in_named(flash_dev1, SSI_GPIO_CS, 0);
-        // sysbus_connect_irq(SYS_BUS_DEVICE(&s->soc.spi0), 2, flash_cs1);
-
-        flash_dev1 = qdev_new("g233-flash");
-        qdev_prop_set_uint8(flash_dev1, "cs", 1);
-        qdev_prop_set_uint32(flash_dev1, "size", 4 * 1024 * 1024);
-        qdev_realize_and_unref(flash_dev1, BUS(spi_bus0), &error_fatal);
-        flash_cs1 = qdev_get_gpio_in_named(flash_dev1, SSI_GPIO_CS, 0);
-        /* 将 SPI 控制器的片选(CS)输出连接到 Flash 设备的片选输入 */
-        qdev_connect_gpio_out_named(s->soc.spi0, SSI_GPIO_CS, 1, flash_cs1);
+
+        for (i = 0; i < ARRAY_SIZE(flashes); i++) {
+            DriveInfo *dinfo = drive_get(IF_MTD, 0, i);
+            DeviceState *flash_dev = qdev_new(TYPE_G233_FLASH);
+            qemu_irq flash_cs;
+
+            qdev_prop_set_uint8(flash_dev, "cs", i);
+            qdev_prop_set_uint32(flash_dev, "size", flashes[i].size);
+            if (dinfo) {
+                qdev_prop_set_drive_err(flash_dev, "drive",
+                                        blk_by_legacy_dinfo(dinfo),
+                                        &error_fatal);
+            }
+            qdev_realize_and_unref(flash_dev, BUS(spi_bus0), &error_fatal);
+            flash_cs = qdev_get_gpio_in_named(flash_dev, SSI_GPIO_CS, 0);
+            /* 将 SPI 控制器的片选(CS)输出连接到 Flash 设备的片选输入 */
+            qdev_connect_gpio_out_named(s->soc.spi0, SSI_GPIO_CS, i, flash_cs);
+
+            memory_region_add_subregion(sys_mem, memmap[flashes[i].xip].base,
+                                        g233_flash_get_xip(flash_dev));
+        }
     }
 }
 
@@ -276,8 +341,15 @@ static void g233_machine_class_init(ObjectClass *oc, const void *data)
 
     mc->desc = "QEMU RISC-V G233 Board with Learning QEMU 2025";
     mc->init = g233_machine_init;
-    mc->max_cpus = 1;
+    mc->max_cpus = G233_CPUS_MAX;
     mc->default_cpu_type = TYPE_RISCV_CPU_GEVICO_G233;
+    mc->possible_cpu_arch_ids = riscv_numa_possible_cpu_arch_ids;
+    mc->cpu_index_to_instance_props = riscv_numa_cpu_index_to_props;
+    mc->get_default_cpu_node_id = riscv_numa_get_default_cpu_node_id;
+    mc->numa_mem_supported = true;
+    /* platform instead of architectural choice */
+    mc->cpu_cluster_has_numa_boundary = true;
+    mc->smp_props.clusters_supported = true;
     mc->default_ram_id = "riscv.g233.ram"; /* DDR */
     mc->default_ram_size = g233_memmap[G233_DEV_DRAM].size;
 }
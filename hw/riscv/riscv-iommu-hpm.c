@@ -292,8 +292,10 @@ void riscv_iommu_process_hpmcycle_write(RISCVIOMMUState *s)
 
 static inline bool check_valid_event_id(unsigned event_id)
 {
-    return event_id > RISCV_IOMMU_HPMEVENT_INVALID &&
-           event_id < RISCV_IOMMU_HPMEVENT_MAX;
+    return (event_id > RISCV_IOMMU_HPMEVENT_INVALID &&
+            event_id < RISCV_IOMMU_HPMEVENT_MAX) ||
+           (event_id >= RISCV_IOMMU_HPMEVENT_IOTLB_HIT &&
+            event_id < RISCV_IOMMU_HPMEVENT_CUSTOM_MAX);
 }
 
 static gboolean hpm_event_equal(gpointer key, gpointer value, gpointer udata)
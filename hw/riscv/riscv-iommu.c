@@ -34,7 +34,8 @@
 #include "trace.h"
 
 #define LIMIT_CACHE_CTX               (1U << 7)
-#define LIMIT_CACHE_IOT               (1U << 20)
+#define LIMIT_CACHE_IOT               (1U << 12)
+#define IOTLB_WAYS                    8
 
 /* Physical page number coversions */
 #define PPN_PHYS(ppn)                 ((ppn) << TARGET_PAGE_BITS)
@@ -67,6 +68,7 @@ struct RISCVIOMMUEntry {
     uint64_t phys:44;           /* Physical Page Number */
     uint64_t gscid:16;          /* Guest Soft-Context identifier */
     uint64_t perm:2;            /* IOMMU_RW flags */
+    uint64_t lru;               /* Last use, for replacement in a set */
 };
 
 /* IOMMU index for transactions without process_id specified. */
@@ -1231,168 +1233,157 @@ static AddressSpace *riscv_iommu_space(RISCVIOMMUState *s, uint32_t devid)
     return &as->iova_as;
 }
 
-/* Translation Object cache support */
-static gboolean riscv_iommu_iot_equal(gconstpointer v1, gconstpointer v2)
-{
-    RISCVIOMMUEntry *t1 = (RISCVIOMMUEntry *) v1;
-    RISCVIOMMUEntry *t2 = (RISCVIOMMUEntry *) v2;
-    return t1->gscid == t2->gscid && t1->pscid == t2->pscid &&
-           t1->iova == t2->iova && t1->tag == t2->tag;
-}
+/*
+ * Translation Object cache support
+ *
+ * The IOTLB is set-associative with IOTLB_WAYS ways, indexed by IOVA page
+ * number so that address selective invalidations only visit the sets
+ * that can hold the address. Entries with perm == IOMMU_NONE are free.
+ */
+typedef struct RISCVIOMMUIotMatch {
+    RISCVIOMMUTransTag tag;
+    bool gv;                    /* match gscid */
+    bool pscv;                  /* match pscid */
+    bool av;                    /* match [first, last] IOVA page numbers */
+    uint32_t gscid;
+    uint32_t pscid;
+    uint64_t first;
+    uint64_t last;
+} RISCVIOMMUIotMatch;
 
-static guint riscv_iommu_iot_hash(gconstpointer v)
+static inline RISCVIOMMUEntry *riscv_iommu_iot_set(RISCVIOMMUState *s,
+                                                   uint64_t iova_ppn)
 {
-    RISCVIOMMUEntry *t = (RISCVIOMMUEntry *) v;
-    return (guint)t->iova;
+    return &s->iot_cache[(iova_ppn & (s->iot_sets - 1)) * IOTLB_WAYS];
 }
 
-/* GV: 0 AV: 0 PSCV: 0 GVMA: 0 */
-/* GV: 0 AV: 0 GVMA: 1 */
-static
-void riscv_iommu_iot_inval_all(gpointer key, gpointer value, gpointer data)
+static bool riscv_iommu_iot_match(RISCVIOMMUEntry *iot,
+                                  RISCVIOMMUIotMatch *m)
 {
-    RISCVIOMMUEntry *iot = (RISCVIOMMUEntry *) value;
-    RISCVIOMMUEntry *arg = (RISCVIOMMUEntry *) data;
-    if (iot->tag == arg->tag) {
-        iot->perm = IOMMU_NONE;
-    }
+    return iot->perm != IOMMU_NONE && iot->tag == m->tag &&
+           (!m->gv || iot->gscid == m->gscid) &&
+           (!m->pscv || iot->pscid == m->pscid) &&
+           (!m->av || (iot->iova >= m->first && iot->iova <= m->last));
 }
 
-/* GV: 0 AV: 0 PSCV: 1 GVMA: 0 */
-static
-void riscv_iommu_iot_inval_pscid(gpointer key, gpointer value, gpointer data)
+/*
+ * Copy out a matching translation. Returns false on a miss.
+ */
+static bool riscv_iommu_iot_lookup(RISCVIOMMUState *s, RISCVIOMMUContext *ctx,
+    hwaddr iova, RISCVIOMMUTransTag transtag, RISCVIOMMUEntry *out)
 {
-    RISCVIOMMUEntry *iot = (RISCVIOMMUEntry *) value;
-    RISCVIOMMUEntry *arg = (RISCVIOMMUEntry *) data;
-    if (iot->tag == arg->tag &&
-        iot->pscid == arg->pscid) {
-        iot->perm = IOMMU_NONE;
-    }
-}
+    uint32_t gscid = get_field(ctx->gatp, RISCV_IOMMU_DC_IOHGATP_GSCID);
+    uint32_t pscid = get_field(ctx->ta, RISCV_IOMMU_DC_TA_PSCID);
+    uint64_t ppn = PPN_DOWN(iova);
+    RISCVIOMMUEntry *set;
+    bool hit = false;
+    int way;
 
-/* GV: 0 AV: 1 PSCV: 0 GVMA: 0 */
-static
-void riscv_iommu_iot_inval_iova(gpointer key, gpointer value, gpointer data)
-{
-    RISCVIOMMUEntry *iot = (RISCVIOMMUEntry *) value;
-    RISCVIOMMUEntry *arg = (RISCVIOMMUEntry *) data;
-    if (iot->tag == arg->tag &&
-        iot->iova == arg->iova) {
-        iot->perm = IOMMU_NONE;
+    if (!s->iot_sets) {
+        return false;
     }
-}
 
-/* GV: 0 AV: 1 PSCV: 1 GVMA: 0 */
-static void riscv_iommu_iot_inval_pscid_iova(gpointer key, gpointer value,
-                                             gpointer data)
-{
-    RISCVIOMMUEntry *iot = (RISCVIOMMUEntry *) value;
-    RISCVIOMMUEntry *arg = (RISCVIOMMUEntry *) data;
-    if (iot->tag == arg->tag &&
-        iot->pscid == arg->pscid &&
-        iot->iova == arg->iova) {
-        iot->perm = IOMMU_NONE;
-    }
-}
+    qemu_mutex_lock(&s->iot_lock);
+    set = riscv_iommu_iot_set(s, ppn);
+    for (way = 0; way < IOTLB_WAYS; way++) {
+        RISCVIOMMUEntry *iot = &set[way];
 
-/* GV: 1 AV: 0 PSCV: 0 GVMA: 0 */
-/* GV: 1 AV: 0 GVMA: 1 */
-static
-void riscv_iommu_iot_inval_gscid(gpointer key, gpointer value, gpointer data)
-{
-    RISCVIOMMUEntry *iot = (RISCVIOMMUEntry *) value;
-    RISCVIOMMUEntry *arg = (RISCVIOMMUEntry *) data;
-    if (iot->tag == arg->tag &&
-        iot->gscid == arg->gscid) {
-        iot->perm = IOMMU_NONE;
+        if (iot->perm != IOMMU_NONE && iot->iova == ppn &&
+            iot->tag == transtag && iot->gscid == gscid &&
+            iot->pscid == pscid) {
+            iot->lru = ++s->iot_clock;
+            *out = *iot;
+            hit = true;
+            break;
+        }
     }
-}
+    qemu_mutex_unlock(&s->iot_lock);
 
-/* GV: 1 AV: 0 PSCV: 1 GVMA: 0 */
-static void riscv_iommu_iot_inval_gscid_pscid(gpointer key, gpointer value,
-                                              gpointer data)
-{
-    RISCVIOMMUEntry *iot = (RISCVIOMMUEntry *) value;
-    RISCVIOMMUEntry *arg = (RISCVIOMMUEntry *) data;
-    if (iot->tag == arg->tag &&
-        iot->gscid == arg->gscid &&
-        iot->pscid == arg->pscid) {
-        iot->perm = IOMMU_NONE;
-    }
+    return hit;
 }
 
-/* GV: 1 AV: 1 PSCV: 0 GVMA: 0 */
-/* GV: 1 AV: 1 GVMA: 1 */
-static void riscv_iommu_iot_inval_gscid_iova(gpointer key, gpointer value,
-                                             gpointer data)
+/*
+ * Insert a translation, replacing a stale copy of it, a free way or the
+ * least recently used one. Returns true if a live entry was evicted.
+ */
+static bool riscv_iommu_iot_update(RISCVIOMMUState *s, RISCVIOMMUEntry *iot)
 {
-    RISCVIOMMUEntry *iot = (RISCVIOMMUEntry *) value;
-    RISCVIOMMUEntry *arg = (RISCVIOMMUEntry *) data;
-    if (iot->tag == arg->tag &&
-        iot->gscid == arg->gscid &&
-        iot->iova == arg->iova) {
-        iot->perm = IOMMU_NONE;
+    RISCVIOMMUEntry *set, *victim = NULL;
+    bool evicted;
+    int way;
+
+    if (!s->iot_sets) {
+        return false;
     }
-}
 
-/* GV: 1 AV: 1 PSCV: 1 GVMA: 0 */
-static void riscv_iommu_iot_inval_gscid_pscid_iova(gpointer key, gpointer value,
-                                                   gpointer data)
-{
-    RISCVIOMMUEntry *iot = (RISCVIOMMUEntry *) value;
-    RISCVIOMMUEntry *arg = (RISCVIOMMUEntry *) data;
-    if (iot->tag == arg->tag &&
-        iot->gscid == arg->gscid &&
-        iot->pscid == arg->pscid &&
-        iot->iova == arg->iova) {
-        iot->perm = IOMMU_NONE;
+    qemu_mutex_lock(&s->iot_lock);
+    set = riscv_iommu_iot_set(s, iot->iova);
+    for (way = 0; way < IOTLB_WAYS; way++) {
+        RISCVIOMMUEntry *e = &set[way];
+
+        if (e->perm != IOMMU_NONE && e->iova == iot->iova &&
+            e->tag == iot->tag && e->gscid == iot->gscid &&
+            e->pscid == iot->pscid) {
+            victim = e;
+            break;
+        }
+        if (!victim || (victim->perm != IOMMU_NONE &&
+                        (e->perm == IOMMU_NONE || e->lru < victim->lru))) {
+            victim = e;
+        }
     }
-}
+    evicted = victim->perm != IOMMU_NONE &&
+              !(victim->iova == iot->iova && victim->tag == iot->tag &&
+                victim->gscid == iot->gscid && victim->pscid == iot->pscid);
+    *victim = *iot;
+    victim->lru = ++s->iot_clock;
+    qemu_mutex_unlock(&s->iot_lock);
 
-/* caller should keep ref-count for iot_cache object */
-static RISCVIOMMUEntry *riscv_iommu_iot_lookup(RISCVIOMMUContext *ctx,
-    GHashTable *iot_cache, hwaddr iova, RISCVIOMMUTransTag transtag)
-{
-    RISCVIOMMUEntry key = {
-        .tag   = transtag,
-        .gscid = get_field(ctx->gatp, RISCV_IOMMU_DC_IOHGATP_GSCID),
-        .pscid = get_field(ctx->ta, RISCV_IOMMU_DC_TA_PSCID),
-        .iova  = PPN_DOWN(iova),
-    };
-    return g_hash_table_lookup(iot_cache, &key);
+    return evicted;
 }
 
-/* caller should keep ref-count for iot_cache object */
-static void riscv_iommu_iot_update(RISCVIOMMUState *s,
-    GHashTable *iot_cache, RISCVIOMMUEntry *iot)
+static void riscv_iommu_iot_inval(RISCVIOMMUState *s, RISCVIOMMUIotMatch *m)
 {
-    if (!s->iot_limit) {
+    uint64_t ppn, nsets;
+    int way;
+
+    if (!s->iot_sets) {
         return;
     }
 
-    if (g_hash_table_size(s->iot_cache) >= s->iot_limit) {
-        iot_cache = g_hash_table_new_full(riscv_iommu_iot_hash,
-                                          riscv_iommu_iot_equal,
-                                          g_free, NULL);
-        g_hash_table_unref(qatomic_xchg(&s->iot_cache, iot_cache));
+    qemu_mutex_lock(&s->iot_lock);
+    nsets = m->av ? m->last - m->first + 1 : UINT64_MAX;
+    if (nsets < s->iot_sets) {
+        /* Only the sets the range maps to */
+        for (ppn = m->first; ppn <= m->last; ppn++) {
+            RISCVIOMMUEntry *set = riscv_iommu_iot_set(s, ppn);
+
+            for (way = 0; way < IOTLB_WAYS; way++) {
+                if (riscv_iommu_iot_match(&set[way], m)) {
+                    set[way].perm = IOMMU_NONE;
+                }
+            }
+        }
+    } else {
+        for (ppn = 0; ppn < (uint64_t)s->iot_sets * IOTLB_WAYS; ppn++) {
+            if (riscv_iommu_iot_match(&s->iot_cache[ppn], m)) {
+                s->iot_cache[ppn].perm = IOMMU_NONE;
+            }
+        }
     }
-    g_hash_table_add(iot_cache, iot);
+    qemu_mutex_unlock(&s->iot_lock);
 }
 
-static void riscv_iommu_iot_inval(RISCVIOMMUState *s, GHFunc func,
-    uint32_t gscid, uint32_t pscid, hwaddr iova, RISCVIOMMUTransTag transtag)
+static void riscv_iommu_iot_inval_all(RISCVIOMMUState *s)
 {
-    GHashTable *iot_cache;
-    RISCVIOMMUEntry key = {
-        .tag = transtag,
-        .gscid = gscid,
-        .pscid = pscid,
-        .iova  = PPN_DOWN(iova),
-    };
+    if (!s->iot_sets) {
+        return;
+    }
 
-    iot_cache = g_hash_table_ref(s->iot_cache);
-    g_hash_table_foreach(iot_cache, func, &key);
-    g_hash_table_unref(iot_cache);
+    qemu_mutex_lock(&s->iot_lock);
+    memset(s->iot_cache, 0,
+           sizeof(RISCVIOMMUEntry) * s->iot_sets * IOTLB_WAYS);
+    qemu_mutex_unlock(&s->iot_lock);
 }
 
 static RISCVIOMMUTransTag riscv_iommu_get_transtag(RISCVIOMMUContext *ctx)
@@ -1413,16 +1404,13 @@ static int riscv_iommu_translate(RISCVIOMMUState *s, RISCVIOMMUContext *ctx,
     IOMMUTLBEntry *iotlb, bool enable_cache)
 {
     RISCVIOMMUTransTag transtag = riscv_iommu_get_transtag(ctx);
-    RISCVIOMMUEntry *iot;
-    IOMMUAccessFlags perm;
+    RISCVIOMMUEntry iot;
     bool enable_pid;
     bool enable_pri;
-    GHashTable *iot_cache;
     int fault;
 
     riscv_iommu_hpm_incr_ctr(s, ctx, RISCV_IOMMU_HPMEVENT_URQ);
 
-    iot_cache = g_hash_table_ref(s->iot_cache);
     /*
      * TC[32] is reserved for custom extensions, used here to temporarily
      * enable automatic page-request generation for ATS queries.
@@ -1441,12 +1429,11 @@ static int riscv_iommu_translate(RISCVIOMMUState *s, RISCVIOMMUContext *ctx,
         }
     }
 
-    iot = riscv_iommu_iot_lookup(ctx, iot_cache, iotlb->iova, transtag);
-    perm = iot ? iot->perm : IOMMU_NONE;
-    if (perm != IOMMU_NONE) {
-        iotlb->translated_addr = PPN_PHYS(iot->phys);
+    if (riscv_iommu_iot_lookup(s, ctx, iotlb->iova, transtag, &iot)) {
+        riscv_iommu_hpm_incr_ctr(s, ctx, RISCV_IOMMU_HPMEVENT_IOTLB_HIT);
+        iotlb->translated_addr = PPN_PHYS(iot.phys);
         iotlb->addr_mask = ~TARGET_PAGE_MASK;
-        iotlb->perm = perm;
+        iotlb->perm = iot.perm;
         fault = 0;
         goto done;
     }
@@ -1468,19 +1455,21 @@ static int riscv_iommu_translate(RISCVIOMMUState *s, RISCVIOMMUContext *ctx,
      * IOMMU hardware model.
      */
     if (!fault && iotlb->translated_addr != iotlb->iova && enable_cache) {
-        iot = g_new0(RISCVIOMMUEntry, 1);
-        iot->iova = PPN_DOWN(iotlb->iova);
-        iot->phys = PPN_DOWN(iotlb->translated_addr);
-        iot->gscid = get_field(ctx->gatp, RISCV_IOMMU_DC_IOHGATP_GSCID);
-        iot->pscid = get_field(ctx->ta, RISCV_IOMMU_DC_TA_PSCID);
-        iot->perm = iotlb->perm;
-        iot->tag = transtag;
-        riscv_iommu_iot_update(s, iot_cache, iot);
+        iot = (RISCVIOMMUEntry) {
+            .iova = PPN_DOWN(iotlb->iova),
+            .phys = PPN_DOWN(iotlb->translated_addr),
+            .gscid = get_field(ctx->gatp, RISCV_IOMMU_DC_IOHGATP_GSCID),
+            .pscid = get_field(ctx->ta, RISCV_IOMMU_DC_TA_PSCID),
+            .perm = iotlb->perm,
+            .tag = transtag,
+        };
+        if (riscv_iommu_iot_update(s, &iot)) {
+            riscv_iommu_hpm_incr_ctr(s, ctx,
+                                     RISCV_IOMMU_HPMEVENT_IOTLB_EVICT);
+        }
     }
 
 done:
-    g_hash_table_unref(iot_cache);
-
     if (enable_pri && fault) {
         struct riscv_iommu_pq_record pr = {0};
         if (enable_pid) {
@@ -1631,6 +1620,22 @@ static void riscv_iommu_process_ddtp(RISCVIOMMUState *s)
 /* Command function and opcode field. */
 #define RISCV_IOMMU_CMD(func, op) (((func) << 7) | (op))
 
+static RISCVIOMMUIotMatch riscv_iommu_iot_cmd_match(
+    struct riscv_iommu_command *cmd)
+{
+    hwaddr iova = (cmd->dword1 << 2) & TARGET_PAGE_MASK;
+
+    return (RISCVIOMMUIotMatch) {
+        .gv = !!(cmd->dword0 & RISCV_IOMMU_CMD_IOTINVAL_GV),
+        .pscv = !!(cmd->dword0 & RISCV_IOMMU_CMD_IOTINVAL_PSCV),
+        .av = !!(cmd->dword0 & RISCV_IOMMU_CMD_IOTINVAL_AV),
+        .gscid = get_field(cmd->dword0, RISCV_IOMMU_CMD_IOTINVAL_GSCID),
+        .pscid = get_field(cmd->dword0, RISCV_IOMMU_CMD_IOTINVAL_PSCID),
+        .first = PPN_DOWN(iova),
+        .last = PPN_DOWN(iova),
+    };
+}
+
 static void riscv_iommu_process_cq_tail(RISCVIOMMUState *s)
 {
     struct riscv_iommu_command cmd;
@@ -1683,69 +1688,36 @@ static void riscv_iommu_process_cq_tail(RISCVIOMMUState *s)
         case RISCV_IOMMU_CMD(RISCV_IOMMU_CMD_IOTINVAL_FUNC_GVMA,
                              RISCV_IOMMU_CMD_IOTINVAL_OPCODE):
         {
-            bool gv = !!(cmd.dword0 & RISCV_IOMMU_CMD_IOTINVAL_GV);
-            bool av = !!(cmd.dword0 & RISCV_IOMMU_CMD_IOTINVAL_AV);
             bool pscv = !!(cmd.dword0 & RISCV_IOMMU_CMD_IOTINVAL_PSCV);
-            uint32_t gscid = get_field(cmd.dword0,
-                                       RISCV_IOMMU_CMD_IOTINVAL_GSCID);
-            uint32_t pscid = get_field(cmd.dword0,
-                                       RISCV_IOMMU_CMD_IOTINVAL_PSCID);
-            hwaddr iova = (cmd.dword1 << 2) & TARGET_PAGE_MASK;
+            RISCVIOMMUIotMatch m = riscv_iommu_iot_cmd_match(&cmd);
 
             if (pscv) {
                 /* illegal command arguments IOTINVAL.GVMA & PSCV == 1 */
                 goto cmd_ill;
             }
 
-            func = riscv_iommu_iot_inval_all;
-
-            if (gv) {
-                func = (av) ? riscv_iommu_iot_inval_gscid_iova :
-                              riscv_iommu_iot_inval_gscid;
+            if (!m.gv) {
+                /* ADDR is ignored unless GV is set */
+                m.av = false;
             }
 
-            riscv_iommu_iot_inval(
-                s, func, gscid, pscid, iova, RISCV_IOMMU_TRANS_TAG_VG);
-
-            riscv_iommu_iot_inval(
-                s, func, gscid, pscid, iova, RISCV_IOMMU_TRANS_TAG_VN);
+            /* G-stage changes affect both G-only and nested entries */
+            m.tag = RISCV_IOMMU_TRANS_TAG_VG;
+            riscv_iommu_iot_inval(s, &m);
+            m.tag = RISCV_IOMMU_TRANS_TAG_VN;
+            riscv_iommu_iot_inval(s, &m);
             break;
         }
 
         case RISCV_IOMMU_CMD(RISCV_IOMMU_CMD_IOTINVAL_FUNC_VMA,
                              RISCV_IOMMU_CMD_IOTINVAL_OPCODE):
         {
-            bool gv = !!(cmd.dword0 & RISCV_IOMMU_CMD_IOTINVAL_GV);
-            bool av = !!(cmd.dword0 & RISCV_IOMMU_CMD_IOTINVAL_AV);
-            bool pscv = !!(cmd.dword0 & RISCV_IOMMU_CMD_IOTINVAL_PSCV);
-            uint32_t gscid = get_field(cmd.dword0,
-                                       RISCV_IOMMU_CMD_IOTINVAL_GSCID);
-            uint32_t pscid = get_field(cmd.dword0,
-                                       RISCV_IOMMU_CMD_IOTINVAL_PSCID);
-            hwaddr iova = (cmd.dword1 << 2) & TARGET_PAGE_MASK;
-            RISCVIOMMUTransTag transtag;
-
-            if (gv) {
-                transtag = RISCV_IOMMU_TRANS_TAG_VN;
-                if (pscv) {
-                    func = (av) ? riscv_iommu_iot_inval_gscid_pscid_iova :
-                                  riscv_iommu_iot_inval_gscid_pscid;
-                } else {
-                    func = (av) ? riscv_iommu_iot_inval_gscid_iova :
-                                  riscv_iommu_iot_inval_gscid;
-                }
-            } else {
-                transtag = RISCV_IOMMU_TRANS_TAG_SS;
-                if (pscv) {
-                    func = (av) ? riscv_iommu_iot_inval_pscid_iova :
-                                  riscv_iommu_iot_inval_pscid;
-                } else {
-                    func = (av) ? riscv_iommu_iot_inval_iova :
-                                  riscv_iommu_iot_inval_all;
-                }
-            }
+            RISCVIOMMUIotMatch m = riscv_iommu_iot_cmd_match(&cmd);
 
-            riscv_iommu_iot_inval(s, func, gscid, pscid, iova, transtag);
+            /* Without GV only single stage entries are targeted */
+            m.tag = m.gv ? RISCV_IOMMU_TRANS_TAG_VN :
+                           RISCV_IOMMU_TRANS_TAG_SS;
+            riscv_iommu_iot_inval(s, &m);
             break;
         }
 
@@ -2325,10 +2297,6 @@ static void riscv_iommu_instance_init(Object *obj)
                                          riscv_iommu_ctx_equal,
                                          g_free, NULL);
 
-    s->iot_cache = g_hash_table_new_full(riscv_iommu_iot_hash,
-                                         riscv_iommu_iot_equal,
-                                         g_free, NULL);
-
     s->iommus.le_next = NULL;
     s->iommus.le_prev = NULL;
     QLIST_INIT(&s->spaces);
@@ -2338,6 +2306,13 @@ static void riscv_iommu_realize(DeviceState *dev, Error **errp)
 {
     RISCVIOMMUState *s = RISCV_IOMMU(dev);
 
+    /* ioatc-limit is rounded down to whole power-of-two number of sets */
+    if (s->iot_limit) {
+        s->iot_sets = pow2floor(MAX(s->iot_limit / IOTLB_WAYS, 1));
+        s->iot_cache = g_new0(RISCVIOMMUEntry, s->iot_sets * IOTLB_WAYS);
+    }
+    qemu_mutex_init(&s->iot_lock);
+
     s->cap |= s->version & RISCV_IOMMU_CAP_VERSION;
     if (s->enable_msi) {
         s->cap |= RISCV_IOMMU_CAP_MSI_FLAT | RISCV_IOMMU_CAP_MSI_MRIF;
@@ -2449,7 +2424,8 @@ static void riscv_iommu_unrealize(DeviceState *dev)
 {
     RISCVIOMMUState *s = RISCV_IOMMU(dev);
 
-    g_hash_table_unref(s->iot_cache);
+    g_free(s->iot_cache);
+    qemu_mutex_destroy(&s->iot_lock);
     g_hash_table_unref(s->ctx_cache);
 
     if (s->cap & RISCV_IOMMU_CAP_HPM) {
@@ -2490,7 +2466,7 @@ void riscv_iommu_reset(RISCVIOMMUState *s)
     riscv_iommu_reg_set32(s, RISCV_IOMMU_REG_IPSR, 0);
 
     g_hash_table_remove_all(s->ctx_cache);
-    g_hash_table_remove_all(s->iot_cache);
+    riscv_iommu_iot_inval_all(s);
 }
 
 static const Property riscv_iommu_properties[] = {
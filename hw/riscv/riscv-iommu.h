@@ -20,6 +20,7 @@
 #define HW_RISCV_IOMMU_STATE_H
 
 #include "qom/object.h"
+#include "qemu/thread.h"
 #include "hw/qdev-properties.h"
 #include "system/dma.h"
 #include "hw/riscv/iommu.h"
@@ -70,8 +71,11 @@ struct RISCVIOMMUState {
 
     GHashTable *ctx_cache;          /* Device translation Context Cache */
 
-    GHashTable *iot_cache;          /* IO Translated Address Cache */
+    struct RISCVIOMMUEntry *iot_cache; /* IO Translated Address Cache */
     unsigned iot_limit;             /* IO Translation Cache size limit */
+    unsigned iot_sets;              /* IOTLB sets, 0 if disabled */
+    uint64_t iot_clock;             /* IOTLB LRU clock */
+    QemuMutex iot_lock;             /* IOTLB contents and LRU state */
 
     /* MMIO Hardware Interface */
     MemoryRegion regs_mr;
@@ -10,9 +10,11 @@
 #include "hw/sysbus.h"
 #include "hw/irq.h"
 #include "hw/ssi/ssi.h"
+#include "hw/qdev-properties.h"
 #include "migration/vmstate.h"
 #include "qemu/log.h"
 #include "qemu/module.h"
+#include "qapi/error.h"
 #include "hw/ssi/g233_spi.h"
 
 /* Register offsets */
@@ -21,6 +23,8 @@
 #define SPI_SR      0x08
 #define SPI_DR      0x0C
 #define SPI_CSCTRL  0x10
+#define SPI_FCR     0x14
+#define SPI_FSR     0x18
 
 /* CR1 bits */
 #define SPI_CR1_SPE     (1 << 6)   /* SPI Enable */
@@ -36,8 +40,63 @@
 #define SPI_SR_RXNE     (1 << 0)   /* Receive buffer not empty */
 #define SPI_SR_UDR      (1 << 2)   /* Underrun flag */
 #define SPI_SR_OVR      (1 << 3)   /* Overrun flag */
+#define SPI_SR_RXTH     (1 << 4)   /* RX FIFO level reached threshold */
 #define SPI_SR_BSY      (1 << 7)   /* Busy flag */
 
+/* FCR bits */
+#define SPI_FCR_FIFOEN      (1 << 0)   /* Use the full FIFO depth */
+#define SPI_FCR_RXTHIE      (1 << 1)   /* RX threshold interrupt enable */
+#define SPI_FCR_RXTH_SHIFT  8          /* RX threshold, in bytes */
+#define SPI_FCR_RXTH_MASK   (0x3f << SPI_FCR_RXTH_SHIFT)
+#define SPI_FCR_BURST_SHIFT 16         /* Bytes per DR access, minus one */
+#define SPI_FCR_BURST_MASK  (0x3 << SPI_FCR_BURST_SHIFT)
+#define SPI_FCR_MASK        (SPI_FCR_FIFOEN | SPI_FCR_RXTHIE | \
+                             SPI_FCR_RXTH_MASK | SPI_FCR_BURST_MASK)
+
+/* FSR fields */
+#define SPI_FSR_RXLVL_SHIFT 0
+#define SPI_FSR_TXLVL_SHIFT 8
+
+static uint32_t g233_spi_fifo_depth(G233SPIState *s)
+{
+    return (s->fcr & SPI_FCR_FIFOEN) ? s->fifo_depth : 1;
+}
+
+/*
+ * A burst never exceeds what the FIFOs can hold, so in legacy mode a
+ * DR access always moves a single byte whatever the burst field says.
+ */
+static uint32_t g233_spi_burst(G233SPIState *s)
+{
+    uint32_t burst = ((s->fcr & SPI_FCR_BURST_MASK) >> SPI_FCR_BURST_SHIFT) + 1;
+
+    return MIN(burst, g233_spi_fifo_depth(s));
+}
+
+static uint32_t g233_spi_rx_threshold(G233SPIState *s)
+{
+    uint32_t th = (s->fcr & SPI_FCR_RXTH_MASK) >> SPI_FCR_RXTH_SHIFT;
+
+    return MIN(MAX(th, 1), g233_spi_fifo_depth(s));
+}
+
+/* Recompute the FIFO-derived SR bits. */
+static void g233_spi_update_sr(G233SPIState *s)
+{
+    uint32_t rx_used = fifo8_num_used(&s->rx_fifo);
+
+    s->sr &= ~(SPI_SR_RXNE | SPI_SR_TXE | SPI_SR_RXTH);
+    if (rx_used) {
+        s->sr |= SPI_SR_RXNE;
+    }
+    if (rx_used >= g233_spi_rx_threshold(s)) {
+        s->sr |= SPI_SR_RXTH;
+    }
+    if (fifo8_is_empty(&s->tx_fifo)) {
+        s->sr |= SPI_SR_TXE;
+    }
+}
+
 static void g233_spi_update_irq(G233SPIState *s)
 {
     bool irq_state = false;
@@ -57,6 +116,11 @@ static void g233_spi_update_irq(G233SPIState *s)
         irq_state = true;
     }
 
+    /* RX FIFO threshold interrupt */
+    if ((s->fcr & SPI_FCR_RXTHIE) && (s->sr & SPI_SR_RXTH)) {
+        irq_state = true;
+    }
+
     if (irq_state) {
         s->interrupt_count++;
     }
@@ -64,6 +128,35 @@ static void g233_spi_update_irq(G233SPIState *s)
     qemu_set_irq(s->irq, irq_state);
 }
 
+/*
+ * Shift out everything queued for transmit while the controller is
+ * enabled.  A byte received into a full RX FIFO sets OVR and replaces
+ * the oldest entry, so with a depth of one the newest byte is kept as
+ * the single data register used to.
+ */
+static void g233_spi_flush_tx(G233SPIState *s)
+{
+    uint8_t tx[G233_SPI_FIFO_DEPTH_MAX];
+    uint8_t rx[G233_SPI_FIFO_DEPTH_MAX];
+    uint32_t len;
+
+    if (!(s->cr1 & SPI_CR1_SPE)) {
+        return;
+    }
+
+    /* Hand the whole queue to the bus so a peripheral can stream it. */
+    len = fifo8_pop_buf(&s->tx_fifo, tx, sizeof(tx));
+    ssi_transfer_bulk(s->ssi, tx, rx, len);
+
+    for (uint32_t i = 0; i < len; i++) {
+        if (fifo8_num_used(&s->rx_fifo) >= g233_spi_fifo_depth(s)) {
+            s->sr |= SPI_SR_OVR;
+            fifo8_pop(&s->rx_fifo);
+        }
+        fifo8_push(&s->rx_fifo, rx[i]);
+    }
+}
+
 static uint64_t g233_spi_read(void *opaque, hwaddr addr, unsigned size)
 {
     G233SPIState *s = G233_SPI(opaque);
@@ -80,15 +173,32 @@ static uint64_t g233_spi_read(void *opaque, hwaddr addr, unsigned size)
         ret = s->sr;
         break;
     case SPI_DR:
-        ret = s->dr_rx;
-        /* Clear RXNE after reading */
-        s->sr &= ~SPI_SR_RXNE;
-        s->rx_fifo_has_data = false;
+        /*
+         * Pop up to one burst, packed LSB first.  An empty FIFO returns
+         * the last byte received, as the single data register did.
+         */
+        if (fifo8_is_empty(&s->rx_fifo)) {
+            ret = s->dr_rx;
+            break;
+        }
+        for (uint32_t i = 0; i < g233_spi_burst(s) &&
+                             !fifo8_is_empty(&s->rx_fifo); i++) {
+            s->dr_rx = fifo8_pop(&s->rx_fifo);
+            ret |= s->dr_rx << (i * 8);
+        }
+        g233_spi_update_sr(s);
         g233_spi_update_irq(s);
         break;
     case SPI_CSCTRL:
         ret = s->csctrl;
         break;
+    case SPI_FCR:
+        ret = s->fcr;
+        break;
+    case SPI_FSR:
+        ret = fifo8_num_used(&s->rx_fifo) << SPI_FSR_RXLVL_SHIFT |
+              fifo8_num_used(&s->tx_fifo) << SPI_FSR_TXLVL_SHIFT;
+        break;
     default:
         qemu_log_mask(LOG_GUEST_ERROR, "g233_spi_read: Bad offset 0x%lx\n", addr);
         break;
@@ -104,6 +214,10 @@ static void g233_spi_write(void *opaque, hwaddr addr, uint64_t value, unsigned s
     switch (addr) {
     case SPI_CR1:
         s->cr1 = value;
+        /* Enabling the controller drains whatever was queued. */
+        g233_spi_flush_tx(s);
+        g233_spi_update_sr(s);
+        g233_spi_update_irq(s);
         break;
     case SPI_CR2:
         s->cr2 = value;
@@ -115,36 +229,25 @@ static void g233_spi_write(void *opaque, hwaddr addr, uint64_t value, unsigned s
         g233_spi_update_irq(s);
         break;
     case SPI_DR:
-        // qemu_log_mask(LOG_TRACE, 
-        //     "SPI: Write DR=0x%02X, CR1=0x%02X, CSCTRL=0x%02X\n",
-        //     (uint8_t)value, s->cr1, s->csctrl);
-        if (s->cr1 & SPI_CR1_SPE) {
-            /* Check for overrun BEFORE starting transfer - if RX has unread data */
-            bool overrun = (s->rx_fifo_has_data && (s->sr & SPI_SR_RXNE));
-
-            s->dr_tx = value & 0xFF;
-            s->sr &= ~SPI_SR_TXE;  /* Clear TXE */
-            s->sr |= SPI_SR_BSY;   /* Set busy */
-
-            /* Transfer byte through SSI bus */
-            uint32_t rx = ssi_transfer(s->ssi, s->dr_tx);
-
-            // qemu_log_mask(LOG_TRACE,
-            //               "SPI: Transfer TX=0x%02X -> RX=0x%02X\n",
-            //               s->dr_tx, rx & 0xFF);
-            
-            /* Now handle overrun AFTER transfer */
-            if (overrun) {
-                s->sr |= SPI_SR_OVR;  /* Set overrun flag */
+        /*
+         * Queue one burst of bytes, LSB first.  In legacy mode a write
+         * while the controller is disabled is dropped.
+         */
+        if (!(s->cr1 & SPI_CR1_SPE) && !(s->fcr & SPI_FCR_FIFOEN)) {
+            break;
+        }
+        for (uint32_t i = 0; i < g233_spi_burst(s); i++) {
+            if (fifo8_num_used(&s->tx_fifo) >= g233_spi_fifo_depth(s)) {
+                qemu_log_mask(LOG_GUEST_ERROR,
+                              "g233_spi_write: TX FIFO full, byte dropped\n");
+                break;
             }
-
-            s->dr_rx = rx & 0xFF;
-            s->sr |= SPI_SR_TXE | SPI_SR_RXNE;  /* Set TXE and RXNE */
-            s->sr &= ~SPI_SR_BSY;                /* Clear busy */
-            s->rx_fifo_has_data = true;
-
-            g233_spi_update_irq(s);
+            s->dr_tx = extract64(value, i * 8, 8);
+            fifo8_push(&s->tx_fifo, s->dr_tx);
         }
+        g233_spi_flush_tx(s);
+        g233_spi_update_sr(s);
+        g233_spi_update_irq(s);
         break;
     case SPI_CSCTRL:
         // qemu_log_mask(LOG_TRACE, 
@@ -166,6 +269,20 @@ static void g233_spi_write(void *opaque, hwaddr addr, uint64_t value, unsigned s
             qemu_set_irq(s->cs_lines[1], !cs1_active); /* CS is active low */
         }
         break;
+    case SPI_FCR:
+        s->fcr = value & SPI_FCR_MASK;
+        /* Shrinking the FIFO keeps the most recent bytes. */
+        while (fifo8_num_used(&s->rx_fifo) > g233_spi_fifo_depth(s)) {
+            fifo8_pop(&s->rx_fifo);
+        }
+        while (fifo8_num_used(&s->tx_fifo) > g233_spi_fifo_depth(s)) {
+            fifo8_pop(&s->tx_fifo);
+        }
+        g233_spi_update_sr(s);
+        g233_spi_update_irq(s);
+        break;
+    case SPI_FSR:
+        break;
     default:
         qemu_log_mask(LOG_GUEST_ERROR, "g233_spi_write: Bad offset 0x%lx\n", addr);
         break;
@@ -193,7 +310,9 @@ static void g233_spi_reset(Object *obj, ResetType type)
     s->dr_rx = 0;
     s->csctrl = 0;
     s->prev_csctrl = 0;
-    s->rx_fifo_has_data = false;
+    s->fcr = 0;
+    fifo8_reset(&s->tx_fifo);
+    fifo8_reset(&s->rx_fifo);
     s->interrupt_count = 0;
 
     /* 取消断言所有CS线 */
@@ -210,6 +329,14 @@ static void g233_spi_realize(DeviceState *dev, Error **errp)
 {
     G233SPIState *s = G233_SPI(dev);
 
+    if (s->fifo_depth < 1 || s->fifo_depth > G233_SPI_FIFO_DEPTH_MAX) {
+        error_setg(errp, "fifo-depth must be between 1 and %d",
+                   G233_SPI_FIFO_DEPTH_MAX);
+        return;
+    }
+    fifo8_create(&s->tx_fifo, s->fifo_depth);
+    fifo8_create(&s->rx_fifo, s->fifo_depth);
+
     s->ssi = ssi_create_bus(dev, "ssi");
     sysbus_init_irq(SYS_BUS_DEVICE(dev), &s->irq);
 
@@ -222,10 +349,19 @@ static void g233_spi_realize(DeviceState *dev, Error **errp)
     sysbus_init_mmio(SYS_BUS_DEVICE(s), &s->iomem);
 }
 
+static void g233_spi_unrealize(DeviceState *dev)
+{
+    G233SPIState *s = G233_SPI(dev);
+
+    fifo8_destroy(&s->tx_fifo);
+    fifo8_destroy(&s->rx_fifo);
+    g_free(s->cs_lines);
+}
+
 static const VMStateDescription vmstate_g233_spi = {
     .name = TYPE_G233_SPI,
-    .version_id = 1,
-    .minimum_version_id = 1,
+    .version_id = 2,
+    .minimum_version_id = 2,
     .fields = (const VMStateField[]) {
         VMSTATE_UINT32(cr1, G233SPIState),
         VMSTATE_UINT32(cr2, G233SPIState),
@@ -233,18 +369,27 @@ static const VMStateDescription vmstate_g233_spi = {
         VMSTATE_UINT32(dr_tx, G233SPIState),
         VMSTATE_UINT32(dr_rx, G233SPIState),
         VMSTATE_UINT32(csctrl, G233SPIState),
+        VMSTATE_UINT32(fcr, G233SPIState),
+        VMSTATE_FIFO8(tx_fifo, G233SPIState),
+        VMSTATE_FIFO8(rx_fifo, G233SPIState),
         VMSTATE_END_OF_LIST()
     }
 };
 
+static const Property g233_spi_properties[] = {
+    DEFINE_PROP_UINT32("fifo-depth", G233SPIState, fifo_depth, 16),
+};
+
 static void g233_spi_class_init(ObjectClass *klass, const void *data)
 {
     DeviceClass *dc = DEVICE_CLASS(klass);
     ResettableClass *rc = RESETTABLE_CLASS(klass);
 
     dc->realize = g233_spi_realize;
+    dc->unrealize = g233_spi_unrealize;
     rc->phases.hold = g233_spi_reset;
     dc->vmsd = &vmstate_g233_spi;
+    device_class_set_props(dc, g233_spi_properties);
 }
 
 static const TypeInfo g233_spi_info = {
@@ -167,6 +167,41 @@ uint32_t ssi_transfer(SSIBus *bus, uint32_t val)
     return r;
 }
 
+void ssi_transfer_bulk(SSIBus *bus, const uint8_t *tx, uint8_t *rx,
+                       uint32_t len)
+{
+    BusState *b = BUS(bus);
+    BusChild *kid;
+    uint8_t buf[64];
+
+    memset(rx, 0, len);
+
+    QTAILQ_FOREACH(kid, &b->children, sibling) {
+        SSIPeripheral *p = SSI_PERIPHERAL(kid->child);
+        SSIPeripheralClass *ssc = p->spc;
+
+        if (ssc->transfer_bulk &&
+            ssc->transfer_raw == ssi_transfer_raw_default) {
+            if (ssc->cs_polarity != SSI_CS_NONE &&
+                p->cs != (ssc->cs_polarity == SSI_CS_HIGH)) {
+                continue;
+            }
+            for (uint32_t done = 0; done < len; done += sizeof(buf)) {
+                uint32_t n = MIN(len - done, sizeof(buf));
+
+                ssc->transfer_bulk(p, tx + done, buf, n);
+                for (uint32_t i = 0; i < n; i++) {
+                    rx[done + i] |= buf[i];
+                }
+            }
+        } else {
+            for (uint32_t i = 0; i < len; i++) {
+                rx[i] |= ssc->transfer_raw(p, tx[i]);
+            }
+        }
+    }
+}
+
 const VMStateDescription vmstate_ssi_peripheral = {
     .name = "SSISlave",
     .version_id = 1,
@@ -50,4 +50,10 @@ PFlashCFI02 *pflash_cfi02_register(hwaddr base,
 
 BlockBackend *m25p80_get_blk(DeviceState *dev);
 
+/* m25p80_g233.c */
+
+#define TYPE_G233_FLASH "g233-flash"
+
+MemoryRegion *g233_flash_get_xip(DeviceState *dev);
+
 #endif
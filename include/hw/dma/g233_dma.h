@@ -0,0 +1,69 @@
+/*
+ * QEMU model of the G233 DMA Controller
+ *
+ * Copyright (c) 2025 Learning QEMU 2025
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef HW_G233_DMA_H
+#define HW_G233_DMA_H
+
+#include "hw/sysbus.h"
+
+#define TYPE_G233_DMA "g233-dma"
+#define G233_DMA(obj) OBJECT_CHECK(G233DMAState, (obj), TYPE_G233_DMA)
+
+/* Register offsets */
+#define G233_DMA_CTRL       0x00
+#define G233_DMA_STATUS     0x04
+#define G233_DMA_DESC_LO    0x08
+#define G233_DMA_DESC_HI    0x0C
+#define G233_DMA_DOORBELL   0x10
+#define G233_DMA_COMPLETED  0x14
+#define G233_DMA_REG_SIZE   0x1000
+
+/* CTRL bits */
+#define G233_DMA_CTRL_EN        (1 << 0)
+#define G233_DMA_CTRL_DONEIE    (1 << 1)
+#define G233_DMA_CTRL_ERRIE     (1 << 2)
+
+/* STATUS bits, DONE and ERR are write-1-to-clear */
+#define G233_DMA_STATUS_BUSY    (1 << 0)
+#define G233_DMA_STATUS_DONE    (1 << 1)
+#define G233_DMA_STATUS_ERR     (1 << 2)
+
+/*
+ * Descriptors are 32 bytes, little-endian, in guest memory:
+ *   0x00  u32  op, and the transpose grain in bits [9:8]
+ *   0x04  u32  length in bytes of the source (ignored for transpose)
+ *   0x08  u64  source address
+ *   0x10  u64  destination address
+ *   0x18  u64  next descriptor address, 0 ends the chain
+ */
+#define G233_DMA_DESC_SIZE      32
+#define G233_DMA_DESC_OP_MASK   0xf
+#define G233_DMA_DESC_GRAIN(c)  (((c) >> 8) & 0x3)
+
+enum {
+    G233_DMA_OP_COPY      = 0,
+    G233_DMA_OP_TRANSPOSE = 1,  /* like custom_dma */
+    G233_DMA_OP_CRUSH     = 2,  /* like custom_crush */
+    G233_DMA_OP_EXPAND    = 3,  /* like custom_expand */
+};
+
+typedef struct G233DMAState {
+    SysBusDevice parent_obj;
+
+    MemoryRegion iomem;
+    qemu_irq irq;
+    QEMUBH *bh;
+    AddressSpace *as;
+
+    uint32_t ctrl;
+    uint32_t status;
+    uint64_t desc;      /* next descriptor to run */
+    uint32_t completed;
+} G233DMAState;
+
+#endif /* HW_G233_DMA_H */
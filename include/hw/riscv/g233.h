@@ -25,6 +25,12 @@
 #include "hw/riscv/riscv_hart.h"
 #include "hw/gpio/sifive_gpio.h"
 #include "hw/ssi/g233_spi.h"
+#include "hw/dma/g233_dma.h"
+
+#define G233_CPUS_MAX_BITS      3
+#define G233_CPUS_MAX           (1 << G233_CPUS_MAX_BITS)
+#define G233_SOCKETS_MAX_BITS   2
+#define G233_SOCKETS_MAX        (1 << G233_SOCKETS_MAX_BITS)
 
 #define TYPE_RISCV_G233_SOC "riscv.gevico.g233.soc"
 #define RISCV_G233_SOC(obj) \
@@ -35,13 +41,15 @@ typedef struct G233SoCState {
     DeviceState parent_obj;
 
     /*< public >*/
-    RISCVHartArrayState cpus;
-    DeviceState *plic;
+    /* One hart array, CLINT and PLIC per socket (-numa node) */
+    RISCVHartArrayState cpus[G233_SOCKETS_MAX];
+    DeviceState *plic[G233_SOCKETS_MAX];
     DeviceState *uart0;
     DeviceState *pwm0;
     SIFIVEGPIOState gpio;
     DeviceState *spi0;
     // G233SPIState spi0;
+    G233DMAState dma;
     MemoryRegion mask_rom;
 } G233SoCState;
 
@@ -66,6 +74,9 @@ enum {
     G233_DEV_UART0, /* PL011 */
     G233_DEV_PWM0,
     G233_DEV_SPI0,
+    G233_DEV_DMA,
+    G233_DEV_XIP0,
+    G233_DEV_XIP1,
     G233_DEV_DRAM
 };
 
@@ -73,6 +84,7 @@ enum {
     G233_UART0_IRQ  = 1,
     G233_PWM0_IRQ   = 2,
     G233_SPI0_IRQ   = 3,
+    G233_DMA_IRQ    = 4,
     G233_GPIO0_IRQ0 = 8
 };
 
@@ -90,5 +102,7 @@ enum {
 #define G233_PLIC_ENABLE_STRIDE 0x80
 #define G233_PLIC_CONTEXT_BASE 0x200000
 #define G233_PLIC_CONTEXT_STRIDE 0x1000
+#define G233_PLIC_SIZE(__num_context) \
+    (G233_PLIC_CONTEXT_BASE + (__num_context) * G233_PLIC_CONTEXT_STRIDE)
 
 #endif /* HW_G233_H */
@@ -15,6 +15,8 @@
 #define TYPE_G233_SPI "g233-spi"
 #define G233_SPI(obj) OBJECT_CHECK(G233SPIState, (obj), TYPE_G233_SPI)
 
+#define G233_SPI_FIFO_DEPTH_MAX 64
+
 typedef struct G233SPIState {
     SysBusDevice parent_obj;
 
@@ -30,8 +32,16 @@ typedef struct G233SPIState {
     uint32_t dr_rx;
     uint32_t csctrl;
     uint32_t prev_csctrl;
+    uint32_t fcr;
+
+    /*
+     * Without FCR.FIFOEN both FIFOs hold a single byte, which is the
+     * original single-buffer behaviour; with it they hold fifo_depth.
+     */
+    uint32_t fifo_depth;
+    Fifo8 tx_fifo;
+    Fifo8 rx_fifo;
 
-    bool rx_fifo_has_data;
     int interrupt_count;
 } G233SPIState;
 
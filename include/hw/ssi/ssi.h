@@ -40,6 +40,12 @@ struct SSIPeripheralClass {
      * This is called when the device cs is active (true by default).
      */
     uint32_t (*transfer)(SSIPeripheral *dev, uint32_t val);
+    /* Optional: shift @len bytes in one call, with the same semantics as
+     * calling transfer for each byte of @tx.  Only used for devices with
+     * standard CS behaviour.
+     */
+    void (*transfer_bulk)(SSIPeripheral *dev, const uint8_t *tx, uint8_t *rx,
+                          uint32_t len);
     /* called when the CS line changes. Optional, devices only need to implement
      * this if they have side effects associated with the cs line (beyond
      * tristating the txrx lines).
@@ -112,6 +118,19 @@ SSIBus *ssi_create_bus(DeviceState *parent, const char *name);
 
 uint32_t ssi_transfer(SSIBus *bus, uint32_t val);
 
+/**
+ * ssi_transfer_bulk: shift a run of bytes through the bus
+ * @bus: SSI bus
+ * @tx: @len bytes to send
+ * @rx: receives @len bytes
+ * @len: number of bytes
+ *
+ * Equivalent to calling ssi_transfer() for each byte of @tx, but lets
+ * peripherals that implement transfer_bulk handle the run at once.
+ */
+void ssi_transfer_bulk(SSIBus *bus, const uint8_t *tx, uint8_t *rx,
+                       uint32_t len);
+
 DeviceState *ssi_get_cs(SSIBus *bus, uint8_t cs_index);
 
 #endif
@@ -403,6 +403,16 @@ struct TCGContext {
 
     TCGLabel *exitreq_label;
 
+    /*
+     * Same-page destinations of the direct jumps in the TB being
+     * translated, as candidates for background translation.
+     */
+    uint64_t gen_succ[2];
+    int nb_gen_succ;
+
+    /* Translating on a tb-worker thread, without the vCPU's TLB */
+    bool gen_background;
+
 #ifdef CONFIG_PLUGIN
     /*
      * We keep one plugin_tb struct per TCGContext. Note that on every TB
@@ -651,6 +661,8 @@ void tcg_pool_reset(TCGContext *s);
 TranslationBlock *tcg_tb_alloc(TCGContext *s);
 
 void tcg_region_reset_all(void);
+bool tcg_region_reclaim(void (*invalidate)(TranslationBlock *tb));
+void tcg_region_mark_used(const void *tc_ptr);
 
 size_t tcg_code_size(void);
 size_t tcg_code_capacity(void);
@@ -233,6 +233,7 @@ DEF("accel", HAS_ARG, QEMU_OPTION_accel,
     "                one-insn-per-tb=on|off (one guest instruction per TCG translation block)\n"
     "                split-wx=on|off (enable TCG split w^x mapping)\n"
     "                tb-size=n (TCG translation block cache size)\n"
+    "                tb-workers=n (TCG background translation threads, default 0)\n"
     "                dirty-ring-size=n (KVM dirty ring GFN count, default 0)\n"
     "                eager-split-size=n (KVM Eager Page Split chunk size, default 0, disabled. ARM only)\n"
     "                notify-vmexit=run|internal-error|disable,notify-window=n (enable notify VM exit and set notify window, x86 only)\n"
@@ -275,6 +276,17 @@ SRST
 
     ``tb-size=n``
         Controls the size (in MiB) of the TCG translation block cache.
+        In system emulation, when the cache fills up, only the part of
+        it that has gone unused longest is discarded, rather than all
+        of it.
+
+    ``tb-workers=n``
+        Start ``n`` threads that translate, in the background, the blocks
+        a newly translated block jumps to within the same page, so that
+        vCPUs find them already translated instead of stopping to
+        translate them. ``info jit`` shows how long vCPUs wait on a
+        lookup miss and how many blocks the workers installed. System
+        emulation only. The default, 0, disables background translation.
 
     ``thread=single|multi``
         Controls number of TCG threads. When the TCG is multi-threaded
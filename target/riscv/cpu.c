@@ -24,6 +24,7 @@
 #include "cpu.h"
 #include "cpu_vendorid.h"
 #include "internals.h"
+#include "pmu.h"
 #include "qapi/error.h"
 #include "qapi/visitor.h"
 #include "qemu/error-report.h"
@@ -763,6 +764,10 @@ static void riscv_cpu_reset_hold(Object *obj, ResetType type)
     }
 
     pmp_unlock_entries(env);
+    riscv_cpu_pwc_flush(env);
+
+    memset(env->pmu_insn_count, 0, sizeof(env->pmu_insn_count));
+    riscv_pmu_refresh_insn_events(env);
 #else
     env->priv = PRV_U;
     env->senvcfg = 0;
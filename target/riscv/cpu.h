@@ -183,6 +183,46 @@ extern RISCVCPUImpliedExtsRule *riscv_multi_ext_implied_rules[];
 #endif
 
 #define RV_VLEN_MAX 1024
+
+/* 32-bit instructions have 32 major opcodes, selected by insn[6:2] */
+#define RISCV_MAJOR_OPCODES 32
+
+/*
+ * Page-walk cache: non-leaf PTEs of first and G-stage walks, and G-stage
+ * translations of VS-stage page-table pages.
+ */
+#define RISCV_PWC_ENTRIES 64
+#define RISCV_PWC_G_ENTRIES 16
+
+enum {
+    RISCV_PWC_S_STAGE = 1,
+    RISCV_PWC_VS_STAGE,
+    RISCV_PWC_G_STAGE,
+};
+
+typedef struct RISCVPWCEntry {
+    hwaddr root;        /* root table of the walk */
+    uint32_t asid;      /* ASID, VMID, or both for VS-stage walks */
+    target_ulong tag;   /* VA bits above the index of level */
+    hwaddr base;        /* table to walk at level */
+    uint8_t level;      /* 0 if the entry is invalid */
+    uint8_t stage;      /* RISCV_PWC_*_STAGE */
+} RISCVPWCEntry;
+
+typedef struct RISCVPWCGEntry {
+    hwaddr gpa;         /* guest physical page of a VS-stage table */
+    hwaddr hpa;
+    bool valid;
+} RISCVPWCGEntry;
+
+typedef struct RISCVPWCache {
+    RISCVPWCEntry pte[RISCV_PWC_ENTRIES];
+    RISCVPWCGEntry g[RISCV_PWC_G_ENTRIES];
+    uint64_t pte_hits;
+    uint64_t pte_misses;
+    uint64_t g_hits;
+    uint64_t g_misses;
+} RISCVPWCache;
 #define RV_MAX_MHPMEVENTS 32
 #define RV_MAX_MHPMCOUNTERS 32
 
@@ -206,6 +246,15 @@ typedef struct PMUCTRState {
     target_ulong irq_overflow_left;
 } PMUCTRState;
 
+/* PMU events counted inline by translated code */
+typedef enum RISCVPMUInsnEvent {
+    RISCV_PMU_INSN_LOAD,
+    RISCV_PMU_INSN_STORE,
+    RISCV_PMU_INSN_BRANCH,
+    RISCV_PMU_INSN_BRANCH_TAKEN,
+    RISCV_PMU_INSN_EVENTS
+} RISCVPMUInsnEvent;
+
 typedef struct PMUFixedCtrState {
         /* Track cycle and icount for each privilege mode */
         uint64_t counter[4];
@@ -435,6 +484,18 @@ struct CPUArchState {
 
     PMUFixedCtrState pmu_fixed_ctrs[2];
 
+    /*
+     * Events counted by code emitted in the translator, see pmu.c.
+     * pmu_insn_count holds events not yet folded into their counter and
+     * pmu_insn_limit the count at which that counter wraps.
+     */
+    uint64_t pmu_insn_count[RISCV_PMU_INSN_EVENTS];
+    uint64_t pmu_insn_limit[RISCV_PMU_INSN_EVENTS];
+    /* Counter each event is mapped to, 0 if none */
+    uint8_t pmu_insn_ctr[RISCV_PMU_INSN_EVENTS];
+    /* Events to instrument, indexed by [virt][priv] */
+    uint8_t pmu_insn_mask[2][4];
+
     target_ulong sscratch;
     target_ulong mscratch;
 
@@ -447,6 +508,9 @@ struct CPUArchState {
     pmp_table_t pmp_state;
     target_ulong mseccfg;
 
+    /* page-walk cache, not migrated */
+    RISCVPWCache pwc;
+
     /* trigger module */
     target_ulong trigger_cur;
     target_ulong tdata1[RV_MAX_TRIGGERS];
@@ -551,7 +615,8 @@ struct ArchCPU {
     uint32_t pmu_avail_ctrs;
     /* Mapping of events to counters */
     GHashTable *pmu_event_ctr_map;
-    const GPtrArray *decoders;
+    /* Enabled 32-bit decoders, indexed by major opcode (insn[6:2]) */
+    const GPtrArray *decoders[RISCV_MAJOR_OPCODES];
 };
 
 typedef struct RISCVCSR RISCVCSR;
@@ -634,6 +699,7 @@ void riscv_cpu_do_transaction_failed(CPUState *cs, hwaddr physaddr,
                                      int mmu_idx, MemTxAttrs attrs,
                                      MemTxResult response, uintptr_t retaddr);
 hwaddr riscv_cpu_get_phys_page_debug(CPUState *cpu, vaddr addr);
+void riscv_cpu_pwc_flush(CPURISCVState *env);
 bool riscv_cpu_exec_interrupt(CPUState *cs, int interrupt_request);
 void riscv_cpu_swap_hypervisor_regs(CPURISCVState *env);
 int riscv_cpu_claim_interrupts(RISCVCPU *cpu, uint64_t interrupts);
@@ -703,6 +769,10 @@ FIELD(TB_FLAGS, BCFI_ENABLED, 28, 1)
 FIELD(TB_FLAGS, PM_PMM, 29, 2)
 FIELD(TB_FLAGS, PM_SIGNEXTEND, 31, 1)
 
+/* TB_FLAGS2 lives in tb->cs_base, which is otherwise unused. */
+/* Bitmap of RISCVPMUInsnEvent counted by the TB */
+FIELD(TB_FLAGS2, PMU_EVENTS, 0, 4)
+
 #ifdef TARGET_RISCV32
 #define riscv_cpu_mxl(env)  ((void)(env), MXL_RV32)
 #else
@@ -934,6 +1004,12 @@ enum riscv_pmu_event_idx {
     RISCV_PMU_EVENT_CACHE_DTLB_READ_MISS = 0x10019,
     RISCV_PMU_EVENT_CACHE_DTLB_WRITE_MISS = 0x1001B,
     RISCV_PMU_EVENT_CACHE_ITLB_PREFETCH_MISS = 0x10021,
+    RISCV_PMU_EVENT_HW_BRANCH_INSTRUCTIONS = 0x05,
+    RISCV_PMU_EVENT_CACHE_L1D_READ_ACCESS = 0x10000,
+    RISCV_PMU_EVENT_CACHE_L1D_WRITE_ACCESS = 0x10002,
+    /* Raw events, written to mhpmevent as is */
+    RISCV_PMU_EVENT_RAW_BRANCH_TAKEN = 0x20001,
+    RISCV_PMU_EVENT_RAW_EXCEPTION = 0x20002,
 };
 
 /* used by tcg/tcg-cpu.c*/
@@ -1162,6 +1162,89 @@ static bool check_svukte_addr(CPURISCVState *env, vaddr addr)
     return !high_bit;
 }
 
+/*
+ * Page-walk cache
+ *
+ * Non-leaf PTEs may be cached until the next sfence.vma/hfence.*, so keep
+ * the table bases found by recent walks, keyed by root table, ASID, level and
+ * the VA bits that select the table, and resume the next walk from the
+ * deepest one that matches. For VS-stage walks also keep the G-stage
+ * translation of each page-table page, as otherwise every level costs a
+ * full G-stage walk. Everything is dropped whenever the translation
+ * regime, PMP or a fence could have changed what a walk would see.
+ */
+void riscv_cpu_pwc_flush(CPURISCVState *env)
+{
+    memset(env->pwc.pte, 0, sizeof(env->pwc.pte));
+    memset(env->pwc.g, 0, sizeof(env->pwc.g));
+}
+
+static inline target_ulong pwc_tag(vaddr addr, int levels, int level,
+                                   int ptidxbits)
+{
+    return addr >> (PGSHIFT + (levels - level) * ptidxbits);
+}
+
+/* The ASID field of @atp, which for hgatp holds the VMID */
+static inline uint32_t pwc_asid(CPURISCVState *env, target_ulong atp)
+{
+    return riscv_cpu_mxl(env) == MXL_RV32 ? get_field(atp, SATP32_ASID) :
+                                            get_field(atp, SATP64_ASID);
+}
+
+static inline RISCVPWCEntry *pwc_entry(CPURISCVState *env, target_ulong tag,
+                                       int level)
+{
+    return &env->pwc.pte[(tag ^ (tag >> 7) ^ level) %
+                         RISCV_PWC_ENTRIES];
+}
+
+/*
+ * Return the level the walk of addr can start at, and its table in *base.
+ * Level 0 with *base unchanged means no entry matched.
+ */
+static int pwc_lookup(CPURISCVState *env, int stage, hwaddr root,
+                      uint32_t asid, vaddr addr, int levels, int ptidxbits,
+                      hwaddr *base)
+{
+    int level;
+
+    for (level = levels - 1; level > 0; level--) {
+        target_ulong tag = pwc_tag(addr, levels, level, ptidxbits);
+        RISCVPWCEntry *e = pwc_entry(env, tag, level);
+
+        if (e->level == level && e->stage == stage &&
+            e->root == root && e->asid == asid && e->tag == tag) {
+            env->pwc.pte_hits++;
+            *base = e->base;
+            return level;
+        }
+    }
+
+    env->pwc.pte_misses++;
+    return 0;
+}
+
+static void pwc_insert(CPURISCVState *env, int stage, hwaddr root,
+                       uint32_t asid, vaddr addr, int levels, int level,
+                       int ptidxbits, hwaddr base)
+{
+    target_ulong tag = pwc_tag(addr, levels, level, ptidxbits);
+    RISCVPWCEntry *e = pwc_entry(env, tag, level);
+
+    e->root = root;
+    e->asid = asid;
+    e->tag = tag;
+    e->base = base;
+    e->level = level;
+    e->stage = stage;
+}
+
+static inline RISCVPWCGEntry *pwc_g_entry(CPURISCVState *env, hwaddr gpa)
+{
+    return &env->pwc.g[(gpa >> PGSHIFT) % RISCV_PWC_G_ENTRIES];
+}
+
 /*
  * get_physical_address - get the physical address for this virtual address
  *
@@ -1316,13 +1399,31 @@ static int get_physical_address(CPURISCVState *env, hwaddr *physical,
         adue = adue && (env->henvcfg & HENVCFG_ADUE);
     }
 
-    int ptshift = (levels - 1) * ptidxbits;
+    hwaddr root = base;
+    int stage = !first_stage ? RISCV_PWC_G_STAGE :
+                two_stage ? RISCV_PWC_VS_STAGE : RISCV_PWC_S_STAGE;
+    /*
+     * A freed root table may be reused for a new address space without
+     * an intervening fence, so entries are per ASID and VMID as well.
+     * The ASID comes from the register the root was read from.
+     */
+    target_ulong atp = use_background ? env->vsatp : env->satp;
+    uint32_t asid = stage == RISCV_PWC_G_STAGE ? pwc_asid(env, env->hgatp) :
+                    stage == RISCV_PWC_S_STAGE ? pwc_asid(env, atp) :
+                    pwc_asid(env, atp) | pwc_asid(env, env->hgatp) << 16;
+    int ptshift;
     target_ulong pte;
     hwaddr pte_addr;
     int i;
 
  restart:
-    for (i = 0; i < levels; i++, ptshift -= ptidxbits) {
+    base = root;
+    /* Debug walks come from other threads, keep them off the cache */
+    i = is_debug ? 0 : pwc_lookup(env, stage, root, asid, addr, levels,
+                                  ptidxbits, &base);
+    ptshift = (levels - 1 - i) * ptidxbits;
+
+    for (; i < levels; i++, ptshift -= ptidxbits) {
         target_ulong idx;
         if (i == 0) {
             idx = (addr >> (PGSHIFT + ptshift)) &
@@ -1335,20 +1436,37 @@ static int get_physical_address(CPURISCVState *env, hwaddr *physical,
         /* check that physical address of PTE is legal */
 
         if (two_stage && first_stage) {
-            int vbase_prot;
+            RISCVPWCGEntry *g = pwc_g_entry(env, base);
             hwaddr vbase;
 
-            /* Do the second stage translation on the base PTE address. */
-            int vbase_ret = get_physical_address(env, &vbase, &vbase_prot,
-                                                 base, NULL, MMU_DATA_LOAD,
-                                                 MMUIdx_U, false, true,
-                                                 is_debug, false);
+            if (!is_debug && g->valid && g->gpa == base) {
+                env->pwc.g_hits++;
+                vbase = g->hpa;
+            } else {
+                int vbase_prot;
+
+                if (!is_debug) {
+                    env->pwc.g_misses++;
+                }
+
+                /* Do the second stage translation on the base PTE address. */
+                int vbase_ret = get_physical_address(env, &vbase, &vbase_prot,
+                                                     base, NULL, MMU_DATA_LOAD,
+                                                     MMUIdx_U, false, true,
+                                                     is_debug, false);
+
+                if (vbase_ret != TRANSLATE_SUCCESS) {
+                    if (fault_pte_addr) {
+                        *fault_pte_addr = (base + idx * ptesize) >> 2;
+                    }
+                    return TRANSLATE_G_STAGE_FAIL;
+                }
 
-            if (vbase_ret != TRANSLATE_SUCCESS) {
-                if (fault_pte_addr) {
-                    *fault_pte_addr = (base + idx * ptesize) >> 2;
+                if (!is_debug) {
+                    g->gpa = base;
+                    g->hpa = vbase;
+                    g->valid = true;
                 }
-                return TRANSLATE_G_STAGE_FAIL;
             }
 
             pte_addr = vbase + idx * ptesize;
@@ -1423,6 +1541,10 @@ static int get_physical_address(CPURISCVState *env, hwaddr *physical,
         }
         /* Inner PTE, continue walking */
         base = ppn << PGSHIFT;
+        if (!is_debug && i + 1 < levels) {
+            pwc_insert(env, stage, root, asid, addr, levels, i + 1,
+                       ptidxbits, base);
+        }
     }
 
     /* No leaf pte at any translation level. */
@@ -1822,7 +1944,8 @@ bool riscv_cpu_tlb_fill(CPUState *cs, vaddr address, int size,
             if (ret == TRANSLATE_SUCCESS) {
                 ret = get_physical_address_pmp(env, &prot_pmp, pa,
                                                size, access_type, mode);
-                tlb_size = pmp_get_tlb_size(env, pa);
+                tlb_size = pmp_get_tlb_size(env, pa, 1 << access_type,
+                                            mode);
 
                 qemu_log_mask(CPU_LOG_MMU,
                               "%s PMP address=" HWADDR_FMT_plx " ret %d prot"
@@ -1857,7 +1980,7 @@ bool riscv_cpu_tlb_fill(CPUState *cs, vaddr address, int size,
         if (ret == TRANSLATE_SUCCESS) {
             ret = get_physical_address_pmp(env, &prot_pmp, pa,
                                            size, access_type, mode);
-            tlb_size = pmp_get_tlb_size(env, pa);
+            tlb_size = pmp_get_tlb_size(env, pa, 1 << access_type, mode);
 
             qemu_log_mask(CPU_LOG_MMU,
                           "%s PMP address=" HWADDR_FMT_plx " ret %d prot"
@@ -2272,6 +2395,9 @@ void riscv_cpu_do_interrupt(CPUState *cs)
                 cause = RISCV_EXCP_U_ECALL;
             }
         }
+
+        /* Counted in the mode that took the exception */
+        riscv_pmu_incr_ctr(cpu, RISCV_PMU_EVENT_RAW_EXCEPTION);
     }
 
     trace_riscv_trap(env->mhartid, async, cause, env->pc, tval,
@@ -1308,6 +1308,7 @@ static RISCVException riscv_pmu_write_ctr(CPURISCVState *env, target_ulong val,
     PMUCTRState *counter = &env->pmu_ctrs[ctr_idx];
     uint64_t mhpmctr_val = val;
 
+    riscv_pmu_sync_insn_events(env);
     counter->mhpmcounter_val = val;
     if (!get_field(env->mcountinhibit, BIT(ctr_idx)) &&
         (riscv_pmu_ctr_monitor_cycles(env, ctr_idx) ||
@@ -1325,6 +1326,8 @@ static RISCVException riscv_pmu_write_ctr(CPURISCVState *env, target_ulong val,
         /* Other counters can keep incrementing from the given value */
         counter->mhpmcounter_prev = val;
     }
+    /* Recompute the overflow limits of inline-counted events */
+    riscv_pmu_sync_insn_events(env);
 
     return RISCV_EXCP_NONE;
 }
@@ -1333,9 +1336,11 @@ static RISCVException riscv_pmu_write_ctrh(CPURISCVState *env, target_ulong val,
                                           uint32_t ctr_idx)
 {
     PMUCTRState *counter = &env->pmu_ctrs[ctr_idx];
-    uint64_t mhpmctr_val = counter->mhpmcounter_val;
+    uint64_t mhpmctr_val;
     uint64_t mhpmctrh_val = val;
 
+    riscv_pmu_sync_insn_events(env);
+    mhpmctr_val = counter->mhpmcounter_val;
     counter->mhpmcounterh_val = val;
     mhpmctr_val = mhpmctr_val | (mhpmctrh_val << 32);
     if (!get_field(env->mcountinhibit, BIT(ctr_idx)) &&
@@ -1349,6 +1354,7 @@ static RISCVException riscv_pmu_write_ctrh(CPURISCVState *env, target_ulong val,
     } else {
         counter->mhpmcounterh_prev = val;
     }
+    riscv_pmu_sync_insn_events(env);
 
     return RISCV_EXCP_NONE;
 }
@@ -1375,8 +1381,11 @@ RISCVException riscv_pmu_read_ctr(CPURISCVState *env, target_ulong *val,
     PMUCTRState *counter = &env->pmu_ctrs[ctr_idx];
     target_ulong ctr_prev = upper_half ? counter->mhpmcounterh_prev :
                                          counter->mhpmcounter_prev;
-    target_ulong ctr_val = upper_half ? counter->mhpmcounterh_val :
-                                        counter->mhpmcounter_val;
+    target_ulong ctr_val;
+
+    riscv_pmu_sync_insn_events(env);
+    ctr_val = upper_half ? counter->mhpmcounterh_val :
+                           counter->mhpmcounter_val;
 
     if (get_field(env->mcountinhibit, BIT(ctr_idx))) {
         /*
@@ -1927,17 +1936,26 @@ static bool validate_vm(CPURISCVState *env, target_ulong vm)
     return vm <= satp_mode_supported_max && valid_vm[vm];
 }
 
+/*
+ * @idxmap is the set of mmu_idx translated through this register.
+ * The page-walk cache is keyed by root table and ASID, so for first-stage
+ * roots (@pwc_by_root) only a mode change invalidates it, and walks of
+ * other address spaces survive context switches.
+ */
 static target_ulong legalize_xatp(CPURISCVState *env, target_ulong old_xatp,
-                                  target_ulong val)
+                                  target_ulong val, uint16_t idxmap,
+                                  bool pwc_by_root)
 {
-    target_ulong mask;
+    target_ulong mask, pwc_mask;
     bool vm;
     if (riscv_cpu_mxl(env) == MXL_RV32) {
         vm = validate_vm(env, get_field(val, SATP32_MODE));
         mask = (val ^ old_xatp) & (SATP32_MODE | SATP32_ASID | SATP32_PPN);
+        pwc_mask = pwc_by_root ? SATP32_MODE : mask;
     } else {
         vm = validate_vm(env, get_field(val, SATP64_MODE));
         mask = (val ^ old_xatp) & (SATP64_MODE | SATP64_ASID | SATP64_PPN);
+        pwc_mask = pwc_by_root ? SATP64_MODE : mask;
     }
 
     if (vm && mask) {
@@ -1947,7 +1965,10 @@ static target_ulong legalize_xatp(CPURISCVState *env, target_ulong old_xatp,
          * performance.  Flushing the TLB on SATP writes with paging
          * enabled avoids leaking those invalid cached mappings.
          */
-        tlb_flush(env_cpu(env));
+        if (mask & pwc_mask) {
+            riscv_cpu_pwc_flush(env);
+        }
+        tlb_flush_by_mmuidx(env_cpu(env), idxmap);
         return val;
     }
     return old_xatp;
@@ -3064,6 +3085,8 @@ static RISCVException write_mcountinhibit(CPURISCVState *env, int csrno,
         }
     }
 
+    riscv_pmu_refresh_insn_events(env);
+
     return RISCV_EXCP_NONE;
 }
 
@@ -4351,7 +4374,10 @@ static RISCVException write_satp(CPURISCVState *env, int csrno,
         return RISCV_EXCP_NONE;
     }
 
-    env->satp = legalize_xatp(env, env->satp, val);
+    /* With V=1 this is the guest's vsatp, swapped in at the world switch */
+    env->satp = legalize_xatp(env, env->satp, val,
+                              env->virt_enabled ? MMU_IDX_MASK_VSU :
+                                                  MMU_IDX_MASK_SU, true);
     return RISCV_EXCP_NONE;
 }
 
@@ -4960,7 +4986,8 @@ static RISCVException read_hgatp(CPURISCVState *env, int csrno,
 static RISCVException write_hgatp(CPURISCVState *env, int csrno,
                                   target_ulong val, uintptr_t ra)
 {
-    env->hgatp = legalize_xatp(env, env->hgatp, val);
+    env->hgatp = legalize_xatp(env, env->hgatp, val, MMU_IDX_MASK_VSU,
+                               false);
     return RISCV_EXCP_NONE;
 }
 
@@ -5249,7 +5276,7 @@ static RISCVException read_vsatp(CPURISCVState *env, int csrno,
 static RISCVException write_vsatp(CPURISCVState *env, int csrno,
                                   target_ulong val, uintptr_t ra)
 {
-    env->vsatp = legalize_xatp(env, env->vsatp, val);
+    env->vsatp = legalize_xatp(env, env->vsatp, val, MMU_IDX_MASK_VSU, true);
     return RISCV_EXCP_NONE;
 }
 
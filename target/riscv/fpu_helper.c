@@ -17,6 +17,8 @@
  */
 
 #include "qemu/osdep.h"
+#include <math.h>
+#include <float.h>
 #include "cpu.h"
 #include "qemu/host-utils.h"
 #include "exec/helper-proto.h"
@@ -117,6 +119,104 @@ void helper_set_rounding_mode_chkfrm(CPURISCVState *env, uint32_t rm)
     set_float_rounding_mode(softrm, &env->fp_status);
 }
 
+/*
+ * Host FPU fast paths for the conversions and min/max, which softfloat
+ * has no hardfloat version of (muladd, sqrt and the arithmetic ops are
+ * already covered there under the same conditions).
+ *
+ * Results that can be inexact are only computed on the host when the
+ * inexact flag is already set and the rounding mode is the host's
+ * nearest-even (or an exact truncation), so no flag needs tracking.
+ * NaNs, overflow, tiny results and out-of-range integers take the
+ * softfloat path, which raises whatever flags they need.
+ */
+static inline bool fp_fast_inexact(CPURISCVState *env)
+{
+    return likely(get_float_exception_flags(&env->fp_status) &
+                  float_flag_inexact);
+}
+
+static inline bool fp_fast_rne(CPURISCVState *env)
+{
+    return fp_fast_inexact(env) &&
+           get_float_rounding_mode(&env->fp_status) ==
+           float_round_nearest_even;
+}
+
+static inline float fp_host_s(float32 f)
+{
+    union { float32 s; float h; } u = { .s = f };
+    return u.h;
+}
+
+static inline float32 fp_soft_s(float f)
+{
+    union { float32 s; float h; } u = { .h = f };
+    return u.s;
+}
+
+static inline double fp_host_d(float64 f)
+{
+    union { float64 s; double h; } u = { .s = f };
+    return u.h;
+}
+
+static inline float64 fp_soft_d(double f)
+{
+    union { float64 s; double h; } u = { .h = f };
+    return u.s;
+}
+
+/*
+ * Round @d to an integer in [@lo, @hi) with the current rounding mode.
+ * RTZ and RNE are the modes compilers use for casts and lrint().
+ */
+static bool fp_fast_to_int(CPURISCVState *env, double d, double lo,
+                           double hi, double *ret)
+{
+    if (!fp_fast_inexact(env)) {
+        return false;
+    }
+    switch (get_float_rounding_mode(&env->fp_status)) {
+    case float_round_to_zero:
+        d = trunc(d);
+        break;
+    case float_round_nearest_even:
+        d = rint(d);
+        break;
+    default:
+        return false;
+    }
+    /* Also false for NaN */
+    if (!(d >= lo && d < hi)) {
+        return false;
+    }
+    *ret = d;
+    return true;
+}
+
+/*
+ * minimumNumber/maximumNumber of two non-NaN values.  Equal values are
+ * identical or zeros of either sign, and or-ing (and-ing) the encodings
+ * then gives -0 for the minimum (+0 for the maximum).
+ */
+#define FP_FAST_MINMAX(name, type, host)                            \
+static inline bool name(type a, type b, bool is_min, type *ret)    \
+{                                                                   \
+    if (isnan(host(a)) || isnan(host(b))) {                         \
+        return false;                                               \
+    }                                                               \
+    if (host(a) != host(b)) {                                       \
+        *ret = (host(a) < host(b)) == is_min ? a : b;               \
+    } else {                                                        \
+        *ret = is_min ? a | b : a & b;                              \
+    }                                                               \
+    return true;                                                    \
+}
+
+FP_FAST_MINMAX(fp_fast_minmax_s, float32, fp_host_s)
+FP_FAST_MINMAX(fp_fast_minmax_d, float64, fp_host_d)
+
 static uint64_t do_fmadd_h(CPURISCVState *env, uint64_t rs1, uint64_t rs2,
                            uint64_t rs3, int flags)
 {
@@ -246,6 +346,12 @@ uint64_t helper_fmin_s(CPURISCVState *env, uint64_t rs1, uint64_t rs2)
 {
     float32 frs1 = check_nanbox_s(env, rs1);
     float32 frs2 = check_nanbox_s(env, rs2);
+    float32 ret;
+
+    if (env->priv_ver >= PRIV_VERSION_1_11_0 &&
+        fp_fast_minmax_s(frs1, frs2, true, &ret)) {
+        return nanbox_s(env, ret);
+    }
     return nanbox_s(env, env->priv_ver < PRIV_VERSION_1_11_0 ?
                          float32_minnum(frs1, frs2, &env->fp_status) :
                          float32_minimum_number(frs1, frs2, &env->fp_status));
@@ -263,6 +369,12 @@ uint64_t helper_fmax_s(CPURISCVState *env, uint64_t rs1, uint64_t rs2)
 {
     float32 frs1 = check_nanbox_s(env, rs1);
     float32 frs2 = check_nanbox_s(env, rs2);
+    float32 ret;
+
+    if (env->priv_ver >= PRIV_VERSION_1_11_0 &&
+        fp_fast_minmax_s(frs1, frs2, false, &ret)) {
+        return nanbox_s(env, ret);
+    }
     return nanbox_s(env, env->priv_ver < PRIV_VERSION_1_11_0 ?
                          float32_maxnum(frs1, frs2, &env->fp_status) :
                          float32_maximum_number(frs1, frs2, &env->fp_status));
@@ -320,44 +432,76 @@ target_ulong helper_feq_s(CPURISCVState *env, uint64_t rs1, uint64_t rs2)
 target_ulong helper_fcvt_w_s(CPURISCVState *env, uint64_t rs1)
 {
     float32 frs1 = check_nanbox_s(env, rs1);
+    double ret;
+
+    if (fp_fast_to_int(env, fp_host_s(frs1), -0x1p31, 0x1p31, &ret)) {
+        return (int32_t)ret;
+    }
     return float32_to_int32(frs1, &env->fp_status);
 }
 
 target_ulong helper_fcvt_wu_s(CPURISCVState *env, uint64_t rs1)
 {
     float32 frs1 = check_nanbox_s(env, rs1);
+    double ret;
+
+    if (fp_fast_to_int(env, fp_host_s(frs1), 0, 0x1p32, &ret)) {
+        return (int32_t)(uint32_t)ret;
+    }
     return (int32_t)float32_to_uint32(frs1, &env->fp_status);
 }
 
 target_ulong helper_fcvt_l_s(CPURISCVState *env, uint64_t rs1)
 {
     float32 frs1 = check_nanbox_s(env, rs1);
+    double ret;
+
+    if (fp_fast_to_int(env, fp_host_s(frs1), -0x1p63, 0x1p63, &ret)) {
+        return (int64_t)ret;
+    }
     return float32_to_int64(frs1, &env->fp_status);
 }
 
 target_ulong helper_fcvt_lu_s(CPURISCVState *env, uint64_t rs1)
 {
     float32 frs1 = check_nanbox_s(env, rs1);
+    double ret;
+
+    if (fp_fast_to_int(env, fp_host_s(frs1), 0, 0x1p64, &ret)) {
+        return (uint64_t)ret;
+    }
     return float32_to_uint64(frs1, &env->fp_status);
 }
 
 uint64_t helper_fcvt_s_w(CPURISCVState *env, target_ulong rs1)
 {
+    if (fp_fast_rne(env)) {
+        return nanbox_s(env, fp_soft_s((int32_t)rs1));
+    }
     return nanbox_s(env, int32_to_float32((int32_t)rs1, &env->fp_status));
 }
 
 uint64_t helper_fcvt_s_wu(CPURISCVState *env, target_ulong rs1)
 {
+    if (fp_fast_rne(env)) {
+        return nanbox_s(env, fp_soft_s((uint32_t)rs1));
+    }
     return nanbox_s(env, uint32_to_float32((uint32_t)rs1, &env->fp_status));
 }
 
 uint64_t helper_fcvt_s_l(CPURISCVState *env, target_ulong rs1)
 {
+    if (fp_fast_rne(env)) {
+        return nanbox_s(env, fp_soft_s((int64_t)rs1));
+    }
     return nanbox_s(env, int64_to_float32(rs1, &env->fp_status));
 }
 
 uint64_t helper_fcvt_s_lu(CPURISCVState *env, target_ulong rs1)
 {
+    if (fp_fast_rne(env)) {
+        return nanbox_s(env, fp_soft_s((uint64_t)rs1));
+    }
     return nanbox_s(env, uint64_to_float32(rs1, &env->fp_status));
 }
 
@@ -413,6 +557,12 @@ uint64_t helper_fdiv_d(CPURISCVState *env, uint64_t frs1, uint64_t frs2)
 
 uint64_t helper_fmin_d(CPURISCVState *env, uint64_t frs1, uint64_t frs2)
 {
+    float64 ret;
+
+    if (env->priv_ver >= PRIV_VERSION_1_11_0 &&
+        fp_fast_minmax_d(frs1, frs2, true, &ret)) {
+        return ret;
+    }
     return env->priv_ver < PRIV_VERSION_1_11_0 ?
            float64_minnum(frs1, frs2, &env->fp_status) :
            float64_minimum_number(frs1, frs2, &env->fp_status);
@@ -425,6 +575,12 @@ uint64_t helper_fminm_d(CPURISCVState *env, uint64_t frs1, uint64_t frs2)
 
 uint64_t helper_fmax_d(CPURISCVState *env, uint64_t frs1, uint64_t frs2)
 {
+    float64 ret;
+
+    if (env->priv_ver >= PRIV_VERSION_1_11_0 &&
+        fp_fast_minmax_d(frs1, frs2, false, &ret)) {
+        return ret;
+    }
     return env->priv_ver < PRIV_VERSION_1_11_0 ?
            float64_maxnum(frs1, frs2, &env->fp_status) :
            float64_maximum_number(frs1, frs2, &env->fp_status);
@@ -437,12 +593,25 @@ uint64_t helper_fmaxm_d(CPURISCVState *env, uint64_t frs1, uint64_t frs2)
 
 uint64_t helper_fcvt_s_d(CPURISCVState *env, uint64_t rs1)
 {
+    if (fp_fast_rne(env)) {
+        double d = fp_host_d(rs1);
+        float r = d;
+
+        if (likely(isfinite(r) && (fabsf(r) > FLT_MIN || d == 0))) {
+            return nanbox_s(env, fp_soft_s(r));
+        }
+    }
     return nanbox_s(env, float64_to_float32(rs1, &env->fp_status));
 }
 
 uint64_t helper_fcvt_d_s(CPURISCVState *env, uint64_t rs1)
 {
     float32 frs1 = check_nanbox_s(env, rs1);
+
+    /* Exact unless it is a NaN */
+    if (likely(!isnan(fp_host_s(frs1)))) {
+        return fp_soft_d(fp_host_s(frs1));
+    }
     return float32_to_float64(frs1, &env->fp_status);
 }
 
@@ -478,6 +647,11 @@ target_ulong helper_feq_d(CPURISCVState *env, uint64_t frs1, uint64_t frs2)
 
 target_ulong helper_fcvt_w_d(CPURISCVState *env, uint64_t frs1)
 {
+    double ret;
+
+    if (fp_fast_to_int(env, fp_host_d(frs1), -0x1p31, 0x1p31, &ret)) {
+        return (int32_t)ret;
+    }
     return float64_to_int32(frs1, &env->fp_status);
 }
 
@@ -488,36 +662,59 @@ uint64_t helper_fcvtmod_w_d(CPURISCVState *env, uint64_t value)
 
 target_ulong helper_fcvt_wu_d(CPURISCVState *env, uint64_t frs1)
 {
+    double ret;
+
+    if (fp_fast_to_int(env, fp_host_d(frs1), 0, 0x1p32, &ret)) {
+        return (int32_t)(uint32_t)ret;
+    }
     return (int32_t)float64_to_uint32(frs1, &env->fp_status);
 }
 
 target_ulong helper_fcvt_l_d(CPURISCVState *env, uint64_t frs1)
 {
+    double ret;
+
+    if (fp_fast_to_int(env, fp_host_d(frs1), -0x1p63, 0x1p63, &ret)) {
+        return (int64_t)ret;
+    }
     return float64_to_int64(frs1, &env->fp_status);
 }
 
 target_ulong helper_fcvt_lu_d(CPURISCVState *env, uint64_t frs1)
 {
+    double ret;
+
+    if (fp_fast_to_int(env, fp_host_d(frs1), 0, 0x1p64, &ret)) {
+        return (uint64_t)ret;
+    }
     return float64_to_uint64(frs1, &env->fp_status);
 }
 
 uint64_t helper_fcvt_d_w(CPURISCVState *env, target_ulong rs1)
 {
-    return int32_to_float64((int32_t)rs1, &env->fp_status);
+    /* Always exact */
+    return fp_soft_d((int32_t)rs1);
 }
 
 uint64_t helper_fcvt_d_wu(CPURISCVState *env, target_ulong rs1)
 {
-    return uint32_to_float64((uint32_t)rs1, &env->fp_status);
+    /* Always exact */
+    return fp_soft_d((uint32_t)rs1);
 }
 
 uint64_t helper_fcvt_d_l(CPURISCVState *env, target_ulong rs1)
 {
+    if (fp_fast_rne(env)) {
+        return fp_soft_d((int64_t)rs1);
+    }
     return int64_to_float64(rs1, &env->fp_status);
 }
 
 uint64_t helper_fcvt_d_lu(CPURISCVState *env, target_ulong rs1)
 {
+    if (fp_fast_rne(env)) {
+        return fp_soft_d((uint64_t)rs1);
+    }
     return uint64_to_float64(rs1, &env->fp_status);
 }
 
@@ -135,9 +135,10 @@ DEF_HELPER_1(mnret, tl, env)
 DEF_HELPER_1(ctr_clear, void, env)
 DEF_HELPER_1(wfi, void, env)
 DEF_HELPER_1(wrs_nto, void, env)
-DEF_HELPER_1(tlb_flush, void, env)
+DEF_HELPER_4(sfence_vma, void, env, tl, tl, i32)
 DEF_HELPER_1(tlb_flush_all, void, env)
 DEF_HELPER_4(ctr_add_entry, void, env, tl, tl, tl)
+DEF_HELPER_FLAGS_1(pmu_insn_sync, TCG_CALL_NO_WG, void, env)
 /* Native Debug */
 DEF_HELPER_1(itrigger_match, void, env)
 #endif
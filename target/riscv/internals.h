@@ -62,6 +62,17 @@ static inline bool mmuidx_2stage(int mmu_idx)
     return mmu_idx & MMU_2STAGE_BIT;
 }
 
+/*
+ * mmu_idx sets translated through satp (U, S, S+SUM, with and without
+ * shadow stack), and through vsatp/hgatp. M-mode is never translated.
+ */
+#define MMU_IDX_MASK_SU     0x0707
+#define MMU_IDX_MASK_VSU    (MMU_IDX_MASK_SU << 4)
+
+/* Which of rs1 (address) and rs2 (ASID) an sfence.vma names */
+#define SFENCE_VMA_ADDR     (1 << 0)
+#define SFENCE_VMA_ASID     (1 << 1)
+
 /* share data between vector helpers and decode code */
 FIELD(VDATA, VM, 0, 1)
 FIELD(VDATA, LMUL, 1, 3)
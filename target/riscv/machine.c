@@ -23,6 +23,7 @@
 #include "migration/cpu.h"
 #include "exec/icount.h"
 #include "debug.h"
+#include "pmu.h"
 
 static bool pmp_needed(void *opaque)
 {
@@ -257,6 +258,17 @@ static int riscv_cpu_post_load(void *opaque, int version_id)
     CPURISCVState *env = &cpu->env;
 
     env->xl = cpu_recompute_xl(env);
+    riscv_cpu_pwc_flush(env);
+    riscv_pmu_refresh_insn_events(env);
+    return 0;
+}
+
+static int riscv_cpu_pre_save(void *opaque)
+{
+    RISCVCPU *cpu = opaque;
+
+    /* Inline-counted PMU events are migrated as part of their counter */
+    riscv_pmu_sync_insn_events(&cpu->env);
     return 0;
 }
 
@@ -404,6 +416,7 @@ const VMStateDescription vmstate_riscv_cpu = {
     .name = "cpu",
     .version_id = 10,
     .minimum_version_id = 10,
+    .pre_save = riscv_cpu_pre_save,
     .post_load = riscv_cpu_post_load,
     .fields = (const VMStateField[]) {
         VMSTATE_UINTTL_ARRAY(env.gpr, RISCVCPU, 32),
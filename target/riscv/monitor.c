@@ -236,3 +236,31 @@ void hmp_info_mem(Monitor *mon, const QDict *qdict)
 
     mem_info_svxx(mon, env);
 }
+
+static void print_pwc_stat(Monitor *mon, const char *name,
+                           uint64_t hits, uint64_t misses)
+{
+    uint64_t total = hits + misses;
+
+    monitor_printf(mon, "  %-10s %12" PRIu64 " hits %12" PRIu64 " misses",
+                   name, hits, misses);
+    if (total) {
+        monitor_printf(mon, " (%" PRIu64 "%% hit)", hits * 100 / total);
+    }
+    monitor_printf(mon, "\n");
+}
+
+void hmp_info_pwc(Monitor *mon, const QDict *qdict)
+{
+    CPUState *cs;
+
+    CPU_FOREACH(cs) {
+        CPURISCVState *env = cpu_env(cs);
+
+        monitor_printf(mon, "CPU#%d\n", cs->cpu_index);
+        print_pwc_stat(mon, "non-leaf", env->pwc.pte_hits,
+                       env->pwc.pte_misses);
+        print_pwc_stat(mon, "g-stage", env->pwc.g_hits,
+                       env->pwc.g_misses);
+    }
+}
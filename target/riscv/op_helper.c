@@ -21,11 +21,13 @@
 #include "qemu/osdep.h"
 #include "cpu.h"
 #include "internals.h"
+#include "pmu.h"
 #include "exec/cputlb.h"
 #include "accel/tcg/cpu-ldst.h"
 #include "accel/tcg/probe.h"
 #include "exec/helper-proto.h"
 #include "exec/tlb-flags.h"
+#include "exec/target_page.h"
 #include "trace.h"
 
 /* Exceptions processing helpers */
@@ -495,6 +497,12 @@ void helper_ctr_add_entry(CPURISCVState *env, target_ulong src,
                         env->priv, env->virt_enabled);
 }
 
+/* An inline-counted PMU event reached the point where its counter wraps */
+void helper_pmu_insn_sync(CPURISCVState *env)
+{
+    riscv_pmu_sync_insn_events(env);
+}
+
 void helper_ctr_clear(CPURISCVState *env)
 {
     /*
@@ -555,18 +563,51 @@ void helper_wrs_nto(CPURISCVState *env)
     }
 }
 
-void helper_tlb_flush(CPURISCVState *env)
+/*
+ * The softmmu TLB only ever holds translations of the current address
+ * space, as satp/vsatp writes flush it, so a fence naming another ASID
+ * has nothing to drop there and one naming an address only needs that
+ * page. The page-walk cache is always flushed whole. With V=1, env->satp
+ * holds the live vsatp; env->vsatp is only the copy saved at the last
+ * world switch.
+ */
+void helper_sfence_vma(CPURISCVState *env, target_ulong addr,
+                       target_ulong asid, uint32_t args)
 {
     CPUState *cs = env_cpu(env);
-    if (!env->virt_enabled &&
+    bool virt = env->virt_enabled;
+    uint16_t idxmap = virt ? MMU_IDX_MASK_VSU : MMU_IDX_MASK_SU;
+    target_ulong atp = env->satp;
+    target_ulong cur_asid;
+
+    if (!virt &&
         (env->priv == PRV_U ||
          (env->priv == PRV_S && get_field(env->mstatus, MSTATUS_TVM)))) {
         riscv_raise_exception(env, RISCV_EXCP_ILLEGAL_INST, GETPC());
-    } else if (env->virt_enabled &&
+    } else if (virt &&
                (env->priv == PRV_U || get_field(env->hstatus, HSTATUS_VTVM))) {
         riscv_raise_exception(env, RISCV_EXCP_VIRT_INSTRUCTION_FAULT, GETPC());
+    }
+
+    riscv_cpu_pwc_flush(env);
+
+    if (args & SFENCE_VMA_ASID) {
+        if (riscv_cpu_sxl(env) == MXL_RV32) {
+            cur_asid = get_field(atp, SATP32_ASID);
+            asid &= SATP32_ASID >> ctz32(SATP32_ASID);
+        } else {
+            cur_asid = get_field(atp, SATP64_ASID);
+            asid &= SATP64_ASID >> ctz64(SATP64_ASID);
+        }
+        if (asid != cur_asid) {
+            return;
+        }
+    }
+
+    if (args & SFENCE_VMA_ADDR) {
+        tlb_flush_page_by_mmuidx(cs, addr, idxmap);
     } else {
-        tlb_flush(cs);
+        tlb_flush_by_mmuidx(cs, idxmap);
     }
 }
 
@@ -586,6 +627,7 @@ void helper_hyp_tlb_flush(CPURISCVState *env)
 
     if (env->priv == PRV_M ||
         (env->priv == PRV_S && !env->virt_enabled)) {
+        riscv_cpu_pwc_flush(env);
         tlb_flush(cs);
         return;
     }
@@ -717,42 +759,232 @@ target_ulong helper_hyp_hlvx_wu(CPURISCVState *env, target_ulong addr)
     return cpu_ldl_code_mmu(env, addr, oi, ra);
 }
 
+/*
+ * Resolve the guest range [addr, addr + len) to one host pointer for the
+ * G233 custom instructions.  Every page touched is probed without
+ * faulting; NULL is returned unless all of them are plain RAM (no MMIO,
+ * no watchpoint, no pending fault) and contiguous on the host.  Callers
+ * then fall back to the per-element path, which raises the fault with
+ * exactly the same ordering as before.
+ */
+static void *g233_probe_host(CPURISCVState *env, target_ulong addr,
+                             target_ulong len, MMUAccessType access_type,
+                             uintptr_t ra)
+{
+    int mmu_idx = riscv_env_mmu_index(env, false);
+    uint8_t *base = NULL;
+    target_ulong done = 0;
+
+    if (len == 0 || addr + len - 1 < addr) {
+        return NULL;
+    }
+
+    while (done < len) {
+        target_ulong pagelen = -((addr + done) | TARGET_PAGE_MASK);
+        target_ulong curlen = MIN(pagelen, len - done);
+        void *host;
+        int flags;
+
+        flags = probe_access_flags(env, addr + done, curlen, access_type,
+                                   mmu_idx, true, &host, ra);
+        if (flags || host == NULL) {
+            return NULL;
+        }
+        if (done == 0) {
+            base = host;
+        } else if (host != base + done) {
+            return NULL;
+        }
+        done += curlen;
+    }
+
+    return base;
+}
+
+static bool g233_host_overlap(const void *a, size_t alen,
+                              const void *b, size_t blen)
+{
+    uintptr_t pa = (uintptr_t)a, pb = (uintptr_t)b;
+
+    return pa < pb + blen && pb < pa + alen;
+}
+
+#define G233_DMA_TILE 8
+
+/*
+ * Transpose an n x n matrix of 32-bit words, dst[i][j] = src[j][i],
+ * in G233_DMA_TILE square tiles so that both sides stay cache resident.
+ * The inner loop has no dependencies and is left for the compiler to
+ * vectorize.
+ */
+static void g233_dma_transpose_host(uint8_t *dst, const uint8_t *src, int n)
+{
+    for (int ib = 0; ib < n; ib += G233_DMA_TILE) {
+        for (int jb = 0; jb < n; jb += G233_DMA_TILE) {
+            for (int i = ib; i < ib + G233_DMA_TILE; i++) {
+                uint8_t *d = dst + (i * n + jb) * sizeof(uint32_t);
+                const uint8_t *s = src + (jb * n + i) * sizeof(uint32_t);
+
+                for (int j = 0; j < G233_DMA_TILE; j++) {
+                    stl_he_p(d + j * sizeof(uint32_t),
+                             ldl_he_p(s + j * n * sizeof(uint32_t)));
+                }
+            }
+        }
+    }
+}
+
 void helper_custom_dma(CPURISCVState *env, target_ulong dst,
                       target_ulong src, target_ulong grain_size)
 {
-    /*
-    qemu_log("DMA: ENTER - dst=0x%lx, src=0x%lx, grain=%lu\n", 
-             dst, src, grain_size);
-    */
-    
+    uintptr_t ra = GETPC();
     int grain = grain_size & 0x3;
     int block_size;
-    
+    target_ulong len;
+    void *src_host, *dst_host;
+
     switch (grain) {
         case 0: block_size = 8; break;
-        case 1: block_size = 16; break;  
+        case 1: block_size = 16; break;
         case 2: block_size = 32; break;
         default: block_size = 8; break;
     }
+
     /*
-    qemu_log("DMA: Processing %dx%d matrix transpose\n",
-             block_size, block_size);
-    */
-    
+     * Fast path: both matrices live in RAM, so transpose directly on
+     * the host.  The source is probed first, as the element loop below
+     * would fault on a source load before touching the destination.
+     */
+    len = block_size * block_size * sizeof(uint32_t);
+    src_host = g233_probe_host(env, src, len, MMU_DATA_LOAD, ra);
+    if (src_host) {
+        dst_host = g233_probe_host(env, dst, len, MMU_DATA_STORE, ra);
+        if (dst_host && !g233_host_overlap(src_host, len, dst_host, len)) {
+            g233_dma_transpose_host(dst_host, src_host, block_size);
+            return;
+        }
+    }
+
     for (int i = 0; i < block_size; i++) {
         for (int j = 0; j < block_size; j++) {
             target_ulong src_offset = (j * block_size + i) * sizeof(uint32_t);
             target_ulong dst_offset = (i * block_size + j) * sizeof(uint32_t);
-            
+
             uint32_t value = cpu_ldl_data(env, src + src_offset);
             cpu_stl_data(env, dst + dst_offset, value);
         }
     }
 }
 
+#define G233_SORT_SMALL     64
+#define G233_SORT_LINE      64
+#define G233_SORT_MAX_ELEMS (1 << 26)
+#define G233_SORT_BIAS      0x80000000u
+
+/*
+ * Sort keys biased by G233_SORT_BIAS, so that unsigned order matches the
+ * signed order used by the guest-visible bubble sort.  Short arrays use
+ * insertion sort, longer ones an LSD radix sort that skips the passes
+ * on which every key shares the same digit.
+ */
+static void g233_sort_keys(uint32_t *keys, uint32_t *tmp, size_t n)
+{
+    if (n < G233_SORT_SMALL) {
+        for (size_t i = 1; i < n; i++) {
+            uint32_t key = keys[i];
+            size_t j = i;
+
+            while (j > 0 && keys[j - 1] > key) {
+                keys[j] = keys[j - 1];
+                j--;
+            }
+            keys[j] = key;
+        }
+        return;
+    }
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        size_t count[256] = { 0 };
+        size_t pos = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            count[(keys[i] >> shift) & 0xff]++;
+        }
+        if (count[(keys[0] >> shift) & 0xff] == n) {
+            continue;
+        }
+        for (int d = 0; d < 256; d++) {
+            size_t c = count[d];
+
+            count[d] = pos;
+            pos += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            tmp[count[(keys[i] >> shift) & 0xff]++] = keys[i];
+        }
+        memcpy(keys, tmp, n * sizeof(uint32_t));
+    }
+}
+
+/*
+ * Sort @n words read from @host, the RAM backing guest @addr.  The bubble
+ * sort stores nothing into an already sorted array, otherwise the whole
+ * range must be writable: return false, with guest memory untouched, if
+ * it is not so that the caller can raise the fault from the element loop.
+ * Only the cache lines whose contents changed are written back.
+ */
+static bool g233_sort_host(CPURISCVState *env, target_ulong addr,
+                           const uint8_t *host, size_t n, uintptr_t ra)
+{
+    size_t len = n * sizeof(uint32_t);
+    g_autofree uint32_t *keys = g_new(uint32_t, n);
+    g_autofree uint32_t *tmp = NULL;
+    uint8_t *out = (uint8_t *)keys;
+    uint8_t *dst;
+
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = ldl_le_p(host + i * sizeof(uint32_t)) ^ G233_SORT_BIAS;
+    }
+    if (n >= G233_SORT_SMALL) {
+        tmp = g_new(uint32_t, n);
+    }
+    g233_sort_keys(keys, tmp, n);
+    for (size_t i = 0; i < n; i++) {
+        stl_le_p(out + i * sizeof(uint32_t), keys[i] ^ G233_SORT_BIAS);
+    }
+
+    if (memcmp(out, host, len) == 0) {
+        return true;
+    }
+
+    dst = g233_probe_host(env, addr, len, MMU_DATA_STORE, ra);
+    if (dst == NULL) {
+        return false;
+    }
+    for (size_t off = 0; off < len; off += G233_SORT_LINE) {
+        size_t linelen = MIN(G233_SORT_LINE, len - off);
+
+        if (memcmp(dst + off, out + off, linelen)) {
+            memcpy(dst + off, out + off, linelen);
+        }
+    }
+    return true;
+}
+
 void helper_custom_sort(CPURISCVState *env, target_ulong sort_num,
                         target_ulong addr, target_ulong array_num)
 {
+    uintptr_t ra = GETPC();
+
+    if (sort_num > 1 && sort_num <= G233_SORT_MAX_ELEMS) {
+        void *host = g233_probe_host(env, addr, sort_num * sizeof(uint32_t),
+                                     MMU_DATA_LOAD, ra);
+
+        if (host && g233_sort_host(env, addr, host, sort_num, ra)) {
+            return;
+        }
+    }
+
     for (target_ulong i = 0; i < sort_num - 1; i++) {
         int swapped = 0;
         for (target_ulong j = 0; j < sort_num - i - 1; j++) {
@@ -775,11 +1007,72 @@ void helper_custom_sort(CPURISCVState *env, target_ulong sort_num,
     }
 }
 
+/*
+ * Nibble pack/unpack kernels for custom_crush and custom_expand, working
+ * on host RAM 64 bits at a time (SWAR).  g233_crush8 packs the low
+ * nibbles of 8 bytes into 4, g233_expand8 splits 4 bytes into 8.
+ */
+static inline uint32_t g233_crush8(uint64_t x)
+{
+    x &= 0x0f0f0f0f0f0f0f0full;
+    x = (x | (x >> 4)) & 0x00ff00ff00ff00ffull;
+    x = (x | (x >> 8)) & 0x0000ffff0000ffffull;
+    return x | (x >> 16);
+}
+
+static inline uint64_t g233_expand8(uint32_t v)
+{
+    uint64_t x = v;
+
+    x = (x | (x << 16)) & 0x0000ffff0000ffffull;
+    x = (x | (x << 8)) & 0x00ff00ff00ff00ffull;
+    return (x & 0x000f000f000f000full) | ((x & 0x00f000f000f000f0ull) << 4);
+}
+
+/* Safe for d <= s: each block is loaded before its result is stored. */
+static void g233_crush_host(uint8_t *d, const uint8_t *s, size_t pairs)
+{
+    size_t k = 0;
+
+    for (; k + 8 <= pairs; k += 8) {
+        uint64_t lo = ldq_le_p(s + 2 * k);
+        uint64_t hi = ldq_le_p(s + 2 * k + 8);
+
+        stq_le_p(d + k, g233_crush8(lo) | (uint64_t)g233_crush8(hi) << 32);
+    }
+    for (; k < pairs; k++) {
+        d[k] = (s[2 * k] & 0x0F) | ((s[2 * k + 1] & 0x0F) << 4);
+    }
+}
+
+static void g233_expand_host(uint8_t *d, const uint8_t *s, size_t n)
+{
+    size_t k = 0;
+
+    for (; k + 8 <= n; k += 8) {
+        stq_le_p(d + 2 * k, g233_expand8(ldl_le_p(s + k)));
+        stq_le_p(d + 2 * k + 8, g233_expand8(ldl_le_p(s + k + 4)));
+    }
+    for (; k < n; k++) {
+        d[2 * k] = s[k] & 0x0F;
+        d[2 * k + 1] = (s[k] >> 4) & 0x0F;
+    }
+}
+
+/*
+ * custom_crush and custom_expand stream through memory in order, so they
+ * are split into chunks that stay inside one source and one destination
+ * page.  A chunk whose pages are both plain RAM runs through the host
+ * kernel; any other chunk runs through the byte loop, which raises faults
+ * at exactly the same element as before.
+ */
 void helper_custom_crush(CPURISCVState *env, target_ulong dst,
                          target_ulong src, target_ulong num)
 {
-    target_ulong i, j;
+    uintptr_t ra = GETPC();
+    target_ulong i, j, steps;
     uint8_t val1, val2, packed;
+    uint8_t *s, *d;
 
     if (num == 0) {
         return;
@@ -789,15 +1082,32 @@ void helper_custom_crush(CPURISCVState *env, target_ulong dst,
     i = 0;
 
     while (i + 1 < num) {
-        val1 = cpu_ldub_data(env, src + i * sizeof(uint8_t));
-        val2 = cpu_ldub_data(env, src + (i + 1) * sizeof(uint8_t));
+        steps = MIN(-((src + i) | TARGET_PAGE_MASK) / 2,
+                    -((dst + j) | TARGET_PAGE_MASK));
+        steps = MIN(steps, (num - i) / 2);
+
+        s = steps ? g233_probe_host(env, src + i, steps * 2,
+                                    MMU_DATA_LOAD, ra) : NULL;
+        d = s ? g233_probe_host(env, dst + j, steps,
+                                MMU_DATA_STORE, ra) : NULL;
+        if (d && (d <= s || !g233_host_overlap(s, steps * 2, d, steps))) {
+            g233_crush_host(d, s, steps);
+            i += steps * 2;
+            j += steps;
+            continue;
+        }
 
-        packed = (val1 & 0x0F) | ((val2 & 0x0F) << 4);
+        for (steps = MAX(steps, 1); steps; steps--) {
+            val1 = cpu_ldub_data(env, src + i * sizeof(uint8_t));
+            val2 = cpu_ldub_data(env, src + (i + 1) * sizeof(uint8_t));
 
-        cpu_stb_data(env, dst + j * sizeof(uint8_t), packed);
+            packed = (val1 & 0x0F) | ((val2 & 0x0F) << 4);
 
-        i += 2;
-        j++;
+            cpu_stb_data(env, dst + j * sizeof(uint8_t), packed);
+
+            i += 2;
+            j++;
+        }
     }
 
     if (i < num) {
@@ -811,19 +1121,38 @@ void helper_custom_crush(CPURISCVState *env, target_ulong dst,
 void helper_custom_expand(CPURISCVState *env, target_ulong dst,
                           target_ulong src, target_ulong num)
 {
-    target_ulong i, j;
+    uintptr_t ra = GETPC();
+    target_ulong i, j, steps;
     uint8_t val_src, val1, val2;
+    uint8_t *s, *d;
+
+    for (i = 0, j = 0; i < num; ) {
+        steps = MIN(-((src + i) | TARGET_PAGE_MASK),
+                    -((dst + j) | TARGET_PAGE_MASK) / 2);
+        steps = MIN(steps, num - i);
+
+        s = steps ? g233_probe_host(env, src + i, steps,
+                                    MMU_DATA_LOAD, ra) : NULL;
+        d = s ? g233_probe_host(env, dst + j, steps * 2,
+                                MMU_DATA_STORE, ra) : NULL;
+        if (d && !g233_host_overlap(s, steps, d, steps * 2)) {
+            g233_expand_host(d, s, steps);
+            i += steps;
+            j += steps * 2;
+            continue;
+        }
 
-    for (i = 0, j = 0; i < num; i++) {
-        val_src = cpu_ldub_data(env, src + i * sizeof(uint8_t));
+        for (steps = MAX(steps, 1); steps; steps--, i++) {
+            val_src = cpu_ldub_data(env, src + i * sizeof(uint8_t));
 
-        val1 = val_src & 0x0F;
-        cpu_stb_data(env, dst + j * sizeof(uint8_t), val1);
-        j++;
+            val1 = val_src & 0x0F;
+            cpu_stb_data(env, dst + j * sizeof(uint8_t), val1);
+            j++;
 
-        val2 = (val_src >> 4) & 0x0F;
-        cpu_stb_data(env, dst + j * sizeof(uint8_t), val2);
-        j++;
+            val2 = (val_src >> 4) & 0x0F;
+            cpu_stb_data(env, dst + j * sizeof(uint8_t), val2);
+            j++;
+        }
     }
 }
 
@@ -172,7 +172,9 @@ void pmp_unlock_entries(CPURISCVState *env)
 
     for (i = 0; i < pmp_num; i++) {
         env->pmp_state.pmp[i].cfg_reg &= ~(PMP_LOCK | PMP_AMATCH);
+        pmp_update_rule_addr(env, i);
     }
+    pmp_update_rule_nums(env);
 }
 
 static void pmp_decode_napot(hwaddr a, hwaddr *sa, hwaddr *ea)
@@ -238,6 +240,86 @@ void pmp_update_rule_addr(CPURISCVState *env, uint32_t pmp_index)
     env->pmp_state.addr[pmp_index].ea = ea;
 }
 
+static int pmp_cmp_hwaddr(const void *a, const void *b)
+{
+    hwaddr x = *(const hwaddr *)a;
+    hwaddr y = *(const hwaddr *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Flatten the active rules into a sorted list of non-overlapping segments,
+ * each tagged with the lowest numbered (highest priority) rule covering it,
+ * so that a lookup is a binary search instead of a scan of every entry.
+ */
+static void pmp_update_decision_table(CPURISCVState *env)
+{
+    pmp_table_t *t = &env->pmp_state;
+    uint8_t pmp_regions = riscv_cpu_cfg(env)->pmp_regions;
+    hwaddr bound[PMP_MAX_SEGS];
+    uint32_t nb = 0;
+    uint32_t i, j;
+
+    bound[nb++] = 0;
+    for (i = 0; i < pmp_regions; i++) {
+        if (pmp_get_a_field(t->pmp[i].cfg_reg) == PMP_AMATCH_OFF) {
+            continue;
+        }
+        bound[nb++] = t->addr[i].sa;
+        if (t->addr[i].ea != (hwaddr)-1) {
+            bound[nb++] = t->addr[i].ea + 1;
+        }
+    }
+    qsort(bound, nb, sizeof(bound[0]), pmp_cmp_hwaddr);
+
+    t->num_segs = 0;
+    for (j = 0; j < nb; j++) {
+        pmp_seg_t *seg;
+
+        if (j > 0 && bound[j] == bound[j - 1]) {
+            continue;
+        }
+        seg = &t->seg[t->num_segs++];
+        seg->sa = bound[j];
+        seg->rule = -1;
+        for (i = 0; i < pmp_regions; i++) {
+            if (pmp_get_a_field(t->pmp[i].cfg_reg) != PMP_AMATCH_OFF &&
+                t->addr[i].sa <= bound[j] && bound[j] <= t->addr[i].ea) {
+                seg->rule = i;
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Index of the decision table segment containing addr.
+ */
+static uint32_t pmp_find_seg(CPURISCVState *env, hwaddr addr)
+{
+    const pmp_table_t *t = &env->pmp_state;
+    uint32_t lo = 0;
+    uint32_t hi = t->num_segs;
+
+    /* seg[0].sa is always 0, so the answer lies in [lo, hi) */
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if (t->seg[mid].sa <= addr) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/*
+ * Update the active rule count and the decision table. Must be called
+ * whenever a cfg or addr register changes.
+ */
 void pmp_update_rule_nums(CPURISCVState *env)
 {
     int i;
@@ -251,20 +333,8 @@ void pmp_update_rule_nums(CPURISCVState *env)
             env->pmp_state.num_rules++;
         }
     }
-}
-
-static int pmp_is_in_range(CPURISCVState *env, int pmp_index, hwaddr addr)
-{
-    int result = 0;
-
-    if ((addr >= env->pmp_state.addr[pmp_index].sa) &&
-        (addr <= env->pmp_state.addr[pmp_index].ea)) {
-        result = 1;
-    } else {
-        result = 0;
-    }
 
-    return result;
+    pmp_update_decision_table(env);
 }
 
 /*
@@ -320,6 +390,100 @@ static bool pmp_hart_has_privs_default(CPURISCVState *env, pmp_priv_t privs,
     return ret;
 }
 
+/*
+ * Privileges granted by matching rule pmp_index to an access from mode.
+ */
+static pmp_priv_t pmp_rule_privs(CPURISCVState *env, int pmp_index,
+                                 target_ulong mode)
+{
+    pmp_priv_t allowed_privs = 0;
+
+    if (!MSECCFG_MML_ISSET(env)) {
+        /*
+         * If mseccfg.MML Bit is not set, do pmp priv check
+         * This will always apply to regular PMP.
+         */
+        allowed_privs = PMP_READ | PMP_WRITE | PMP_EXEC;
+        if ((mode != PRV_M) || pmp_is_locked(env, pmp_index)) {
+            allowed_privs &= env->pmp_state.pmp[pmp_index].cfg_reg;
+        }
+    } else {
+        /*
+         * If mseccfg.MML Bit set, do the enhanced pmp priv check
+         */
+        const uint8_t smepmp_operation =
+            pmp_get_smepmp_operation(env->pmp_state.pmp[pmp_index].cfg_reg);
+
+        if (mode == PRV_M) {
+            switch (smepmp_operation) {
+            case 0:
+            case 1:
+            case 4:
+            case 5:
+            case 6:
+            case 7:
+            case 8:
+                allowed_privs = 0;
+                break;
+            case 2:
+            case 3:
+            case 14:
+                allowed_privs = PMP_READ | PMP_WRITE;
+                break;
+            case 9:
+            case 10:
+                allowed_privs = PMP_EXEC;
+                break;
+            case 11:
+            case 13:
+                allowed_privs = PMP_READ | PMP_EXEC;
+                break;
+            case 12:
+            case 15:
+                allowed_privs = PMP_READ;
+                break;
+            default:
+                g_assert_not_reached();
+            }
+        } else {
+            switch (smepmp_operation) {
+            case 0:
+            case 8:
+            case 9:
+            case 12:
+            case 13:
+            case 14:
+                allowed_privs = 0;
+                break;
+            case 1:
+            case 10:
+            case 11:
+                allowed_privs = PMP_EXEC;
+                break;
+            case 2:
+            case 4:
+            case 15:
+                allowed_privs = PMP_READ;
+                break;
+            case 3:
+            case 6:
+                allowed_privs = PMP_READ | PMP_WRITE;
+                break;
+            case 5:
+                allowed_privs = PMP_READ | PMP_EXEC;
+                break;
+            case 7:
+                allowed_privs = PMP_READ | PMP_WRITE | PMP_EXEC;
+                break;
+            default:
+                g_assert_not_reached();
+            }
+        }
+    }
+
+    return allowed_privs;
+}
+
 
 /*
  * Public Interface
@@ -334,11 +498,9 @@ bool pmp_hart_has_privs(CPURISCVState *env, hwaddr addr,
                         target_ulong size, pmp_priv_t privs,
                         pmp_priv_t *allowed_privs, target_ulong mode)
 {
-    int i = 0;
     int pmp_size = 0;
-    hwaddr s = 0;
-    hwaddr e = 0;
-    uint8_t pmp_regions = riscv_cpu_cfg(env)->pmp_regions;
+    int s_rule;
+    int e_rule;
 
     /* Short cut if no rules */
     if (0 == pmp_get_num_rules(env)) {
@@ -361,123 +523,35 @@ bool pmp_hart_has_privs(CPURISCVState *env, hwaddr addr,
 
     /*
      * 1.10 draft priv spec states there is an implicit order
-     * from low to high
+     * from low to high. The decision table already resolved it, so the
+     * first and last byte each map to their highest priority rule.
      */
-    for (i = 0; i < pmp_regions; i++) {
-        s = pmp_is_in_range(env, i, addr);
-        e = pmp_is_in_range(env, i, addr + pmp_size - 1);
-
-        /* partially inside */
-        if ((s + e) == 1) {
-            qemu_log_mask(LOG_GUEST_ERROR,
-                          "pmp violation - access is partially inside\n");
-            *allowed_privs = 0;
-            return false;
-        }
-
-        /* fully inside */
-        const uint8_t a_field =
-            pmp_get_a_field(env->pmp_state.pmp[i].cfg_reg);
+    s_rule = env->pmp_state.seg[pmp_find_seg(env, addr)].rule;
+    e_rule = env->pmp_state.seg[pmp_find_seg(env, addr + pmp_size - 1)].rule;
 
-        if (((s + e) == 2) && (PMP_AMATCH_OFF != a_field)) {
-            /*
-             * If the PMP entry is not off and the address is in range,
-             * do the priv check
-             */
-            if (!MSECCFG_MML_ISSET(env)) {
-                /*
-                 * If mseccfg.MML Bit is not set, do pmp priv check
-                 * This will always apply to regular PMP.
-                 */
-                *allowed_privs = PMP_READ | PMP_WRITE | PMP_EXEC;
-                if ((mode != PRV_M) || pmp_is_locked(env, i)) {
-                    *allowed_privs &= env->pmp_state.pmp[i].cfg_reg;
-                }
-            } else {
-                /*
-                 * If mseccfg.MML Bit set, do the enhanced pmp priv check
-                 */
-                const uint8_t smepmp_operation =
-                    pmp_get_smepmp_operation(env->pmp_state.pmp[i].cfg_reg);
-
-                if (mode == PRV_M) {
-                    switch (smepmp_operation) {
-                    case 0:
-                    case 1:
-                    case 4:
-                    case 5:
-                    case 6:
-                    case 7:
-                    case 8:
-                        *allowed_privs = 0;
-                        break;
-                    case 2:
-                    case 3:
-                    case 14:
-                        *allowed_privs = PMP_READ | PMP_WRITE;
-                        break;
-                    case 9:
-                    case 10:
-                        *allowed_privs = PMP_EXEC;
-                        break;
-                    case 11:
-                    case 13:
-                        *allowed_privs = PMP_READ | PMP_EXEC;
-                        break;
-                    case 12:
-                    case 15:
-                        *allowed_privs = PMP_READ;
-                        break;
-                    default:
-                        g_assert_not_reached();
-                    }
-                } else {
-                    switch (smepmp_operation) {
-                    case 0:
-                    case 8:
-                    case 9:
-                    case 12:
-                    case 13:
-                    case 14:
-                        *allowed_privs = 0;
-                        break;
-                    case 1:
-                    case 10:
-                    case 11:
-                        *allowed_privs = PMP_EXEC;
-                        break;
-                    case 2:
-                    case 4:
-                    case 15:
-                        *allowed_privs = PMP_READ;
-                        break;
-                    case 3:
-                    case 6:
-                        *allowed_privs = PMP_READ | PMP_WRITE;
-                        break;
-                    case 5:
-                        *allowed_privs = PMP_READ | PMP_EXEC;
-                        break;
-                    case 7:
-                        *allowed_privs = PMP_READ | PMP_WRITE | PMP_EXEC;
-                        break;
-                    default:
-                        g_assert_not_reached();
-                    }
-                }
-            }
+    /* No rule matched */
+    if (s_rule < 0 && e_rule < 0) {
+        return pmp_hart_has_privs_default(env, privs, allowed_privs, mode);
+    }
 
-            /*
-             * If matching address range was found, the protection bits
-             * defined with PMP must be used. We shouldn't fallback on
-             * finding default privileges.
-             */
-            return (privs & *allowed_privs) == privs;
-        }
+    /*
+     * The highest priority rule touching the access covers only one end
+     * of it: partially inside
+     */
+    if (s_rule != e_rule) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "pmp violation - access is partially inside\n");
+        *allowed_privs = 0;
+        return false;
     }
 
-    /* No rule matched */
-    return pmp_hart_has_privs_default(env, privs, allowed_privs, mode);
+    /*
+     * If matching address range was found, the protection bits
+     * defined with PMP must be used. We shouldn't fallback on
+     * finding default privileges.
+     */
+    *allowed_privs = pmp_rule_privs(env, s_rule, mode);
+    return (privs & *allowed_privs) == privs;
 }
 
 /*
@@ -501,6 +575,7 @@ void pmpcfg_csr_write(CPURISCVState *env, uint32_t reg_index,
     /* If PMP permission of any addr has been changed, flush TLB pages. */
     if (modified) {
         pmp_update_rule_nums(env);
+        riscv_cpu_pwc_flush(env);
         tlb_flush(env_cpu(env));
     }
 }
@@ -563,6 +638,8 @@ void pmpaddr_csr_write(CPURISCVState *env, uint32_t addr_index,
             if (is_next_cfg_tor) {
                 pmp_update_rule_addr(env, addr_index + 1);
             }
+            pmp_update_rule_nums(env);
+            riscv_cpu_pwc_flush(env);
             tlb_flush(env_cpu(env));
         } else {
             qemu_log_mask(LOG_GUEST_ERROR,
@@ -625,6 +702,7 @@ void mseccfg_csr_write(CPURISCVState *env, target_ulong val)
         /* Sticky bits */
         val |= (env->mseccfg & mask);
         if ((val ^ env->mseccfg) & mask) {
+            riscv_cpu_pwc_flush(env);
             tlb_flush(env_cpu(env));
         }
     } else {
@@ -649,6 +727,29 @@ target_ulong mseccfg_csr_read(CPURISCVState *env)
     return env->mseccfg;
 }
 
+/*
+ * Segment boundaries inside a page must be aligned to this for the page to
+ * be mapped as a whole: no naturally aligned access can straddle them, and
+ * misaligned ones may be split by the spec.
+ */
+#define PMP_TLB_MERGE_ALIGN 16
+
+/*
+ * Outcome of an access with privs from mode to decision table segment idx.
+ */
+static bool pmp_seg_privs(CPURISCVState *env, uint32_t idx, pmp_priv_t privs,
+                          pmp_priv_t *allowed_privs, target_ulong mode)
+{
+    int rule = env->pmp_state.seg[idx].rule;
+
+    if (rule < 0) {
+        return pmp_hart_has_privs_default(env, privs, allowed_privs, mode);
+    }
+
+    *allowed_privs = pmp_rule_privs(env, rule, mode);
+    return (privs & *allowed_privs) == privs;
+}
+
 /*
  * Calculate the TLB size.
  * It's possible that PMP regions only cover partial of the TLB page, and
@@ -659,17 +760,21 @@ target_ulong mseccfg_csr_read(CPURISCVState *env)
  * A write access to 0x80000000 will match PMP1. However we cannot cache the
  * translation result in the TLB since this will make the write access to
  * 0x80000008 bypass the check of PMP0.
- * To avoid this we return a size of 1 (which means no caching) if the PMP
- * region only covers partial of the TLB page.
+ * To avoid this we return a size of 1 (which means no caching) if the
+ * decision table splits the page into segments that grant different
+ * privileges to this access. Segments that all agree, such as an unlocked
+ * rule next to unmatched memory seen from M-mode, still get a whole page.
  */
-target_ulong pmp_get_tlb_size(CPURISCVState *env, hwaddr addr)
+target_ulong pmp_get_tlb_size(CPURISCVState *env, hwaddr addr,
+                              pmp_priv_t privs, target_ulong mode)
 {
-    hwaddr pmp_sa;
-    hwaddr pmp_ea;
+    const pmp_table_t *t = &env->pmp_state;
     hwaddr tlb_sa = addr & ~(TARGET_PAGE_SIZE - 1);
     hwaddr tlb_ea = tlb_sa + TARGET_PAGE_SIZE - 1;
-    int i;
-    uint8_t pmp_regions = riscv_cpu_cfg(env)->pmp_regions;
+    pmp_priv_t page_privs;
+    pmp_priv_t seg_privs;
+    bool page_ok;
+    uint32_t i;
 
     /*
      * If PMP is not supported or there are no PMP rules, the TLB page will not
@@ -680,37 +785,23 @@ target_ulong pmp_get_tlb_size(CPURISCVState *env, hwaddr addr)
         return TARGET_PAGE_SIZE;
     }
 
-    for (i = 0; i < pmp_regions; i++) {
-        if (pmp_get_a_field(env->pmp_state.pmp[i].cfg_reg) == PMP_AMATCH_OFF) {
-            continue;
-        }
-
-        pmp_sa = env->pmp_state.addr[i].sa;
-        pmp_ea = env->pmp_state.addr[i].ea;
+    i = pmp_find_seg(env, tlb_sa);
+    if (i + 1 == t->num_segs || t->seg[i + 1].sa > tlb_ea) {
+        /* A single segment, i.e. a single rule or none, covers the page */
+        return TARGET_PAGE_SIZE;
+    }
 
-        /*
-         * Only the first PMP entry that covers (whole or partial of) the TLB
-         * page really matters:
-         * If it covers the whole TLB page, set the size to TARGET_PAGE_SIZE,
-         * since the following PMP entries have lower priority and will not
-         * affect the permissions of the page.
-         * If it only covers partial of the TLB page, set the size to 1 since
-         * the allowed permissions of the region may be different from other
-         * region of the page.
-         */
-        if (pmp_sa <= tlb_sa && pmp_ea >= tlb_ea) {
-            return TARGET_PAGE_SIZE;
-        } else if ((pmp_sa >= tlb_sa && pmp_sa <= tlb_ea) ||
-                   (pmp_ea >= tlb_sa && pmp_ea <= tlb_ea)) {
+    page_ok = pmp_seg_privs(env, i, privs, &page_privs, mode);
+    for (i++; i < t->num_segs && t->seg[i].sa <= tlb_ea; i++) {
+        if (t->seg[i].sa & (PMP_TLB_MERGE_ALIGN - 1)) {
+            return 1;
+        }
+        if (pmp_seg_privs(env, i, privs, &seg_privs, mode) != page_ok ||
+            seg_privs != page_privs) {
             return 1;
         }
     }
 
-    /*
-     * If no PMP entry matches the TLB page, the TLB page will also not be
-     * split into regions with different permissions by PMP so we set the size
-     * to TARGET_PAGE_SIZE.
-     */
     return TARGET_PAGE_SIZE;
 }
 
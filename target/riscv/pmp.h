@@ -59,10 +59,25 @@ typedef struct {
     hwaddr ea;
 } pmp_addr_t;
 
+/*
+ * One slice of the physical address space, from sa up to the sa of the
+ * next segment, and the highest priority active rule covering it (-1 if
+ * none).
+ */
+typedef struct {
+    hwaddr sa;
+    int8_t rule;
+} pmp_seg_t;
+
+#define PMP_MAX_SEGS (2 * MAX_RISCV_PMPS + 1)
+
 typedef struct {
     pmp_entry_t pmp[MAX_RISCV_PMPS];
     pmp_addr_t  addr[MAX_RISCV_PMPS];
     uint32_t num_rules;
+    /* Decision table, rebuilt by pmp_update_rule_nums() */
+    pmp_seg_t seg[PMP_MAX_SEGS];
+    uint32_t num_segs;
 } pmp_table_t;
 
 void pmpcfg_csr_write(CPURISCVState *env, uint32_t reg_index,
@@ -79,7 +94,8 @@ bool pmp_hart_has_privs(CPURISCVState *env, hwaddr addr,
                         target_ulong size, pmp_priv_t privs,
                         pmp_priv_t *allowed_privs,
                         target_ulong mode);
-target_ulong pmp_get_tlb_size(CPURISCVState *env, hwaddr addr);
+target_ulong pmp_get_tlb_size(CPURISCVState *env, hwaddr addr,
+                              pmp_priv_t privs, target_ulong mode);
 void pmp_update_rule_addr(CPURISCVState *env, uint32_t pmp_index);
 void pmp_update_rule_nums(CPURISCVState *env);
 uint32_t pmp_get_num_rules(CPURISCVState *env);
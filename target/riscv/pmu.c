@@ -36,7 +36,8 @@
  */
 void riscv_pmu_generate_fdt_node(void *fdt, uint32_t cmask, char *pmu_name)
 {
-    uint32_t fdt_event_ctr_map[15] = {};
+    uint32_t fdt_event_ctr_map[24] = {};
+    uint32_t fdt_raw_event_ctr_map[10] = {};
 
    /*
     * The event encoding is specified in the SBI specification
@@ -74,9 +75,45 @@ void riscv_pmu_generate_fdt_node(void *fdt, uint32_t cmask, char *pmu_name)
    fdt_event_ctr_map[13] = cpu_to_be32(0x00010021);
    fdt_event_ctr_map[14] = cpu_to_be32(cmask);
 
+   /* SBI_PMU_HW_BRANCH_INSTRUCTIONS: 0x05 : type(0x00) */
+   fdt_event_ctr_map[15] = cpu_to_be32(0x00000005);
+   fdt_event_ctr_map[16] = cpu_to_be32(0x00000005);
+   fdt_event_ctr_map[17] = cpu_to_be32(cmask);
+
+   /* SBI_PMU_HW_CACHE_L1D : 0x00 READ : 0x00 ACCESS : 0x00 type(0x01) */
+   fdt_event_ctr_map[18] = cpu_to_be32(0x00010000);
+   fdt_event_ctr_map[19] = cpu_to_be32(0x00010000);
+   fdt_event_ctr_map[20] = cpu_to_be32(cmask);
+
+   /* SBI_PMU_HW_CACHE_L1D : 0x00 WRITE : 0x01 ACCESS : 0x00 type(0x01) */
+   fdt_event_ctr_map[21] = cpu_to_be32(0x00010002);
+   fdt_event_ctr_map[22] = cpu_to_be32(0x00010002);
+   fdt_event_ctr_map[23] = cpu_to_be32(cmask);
+
    /* This a OpenSBI specific DT property documented in OpenSBI docs */
    qemu_fdt_setprop(fdt, pmu_name, "riscv,event-to-mhpmcounters",
                     fdt_event_ctr_map, sizeof(fdt_event_ctr_map));
+
+   /*
+    * Raw events: <select_hi select_lo mask_hi mask_lo counters>, the
+    * selector is written to mhpmevent as is.
+    */
+   /* Taken branches */
+   fdt_raw_event_ctr_map[0] = cpu_to_be32(0x00000000);
+   fdt_raw_event_ctr_map[1] = cpu_to_be32(0x00020001);
+   fdt_raw_event_ctr_map[2] = cpu_to_be32(0x00ffffff);
+   fdt_raw_event_ctr_map[3] = cpu_to_be32(0xffffffff);
+   fdt_raw_event_ctr_map[4] = cpu_to_be32(cmask);
+
+   /* Exceptions */
+   fdt_raw_event_ctr_map[5] = cpu_to_be32(0x00000000);
+   fdt_raw_event_ctr_map[6] = cpu_to_be32(0x00020002);
+   fdt_raw_event_ctr_map[7] = cpu_to_be32(0x00ffffff);
+   fdt_raw_event_ctr_map[8] = cpu_to_be32(0xffffffff);
+   fdt_raw_event_ctr_map[9] = cpu_to_be32(cmask);
+
+   qemu_fdt_setprop(fdt, pmu_name, "riscv,raw-event-to-mhpmcounters",
+                    fdt_raw_event_ctr_map, sizeof(fdt_raw_event_ctr_map));
 }
 
 static bool riscv_pmu_counter_valid(RISCVCPU *cpu, uint32_t ctr_idx)
@@ -101,24 +138,38 @@ static bool riscv_pmu_counter_enabled(RISCVCPU *cpu, uint32_t ctr_idx)
     }
 }
 
+/* Is counting inhibited for ctr_idx in the given mode by mhpmevent? */
+static bool riscv_pmu_ctr_filtered(CPURISCVState *env, uint32_t ctr_idx,
+                                   target_ulong priv, bool virt)
+{
+    uint64_t inh;
+
+    if (riscv_cpu_mxl(env) == MXL_RV32) {
+        inh = (uint64_t)env->mhpmeventh_val[ctr_idx] << 32;
+    } else {
+        inh = env->mhpmevent_val[ctr_idx];
+    }
+
+    switch (priv) {
+    case PRV_M:
+        return inh & MHPMEVENT_BIT_MINH;
+    case PRV_S:
+        return inh & (virt ? MHPMEVENT_BIT_VSINH : MHPMEVENT_BIT_SINH);
+    case PRV_U:
+        return inh & (virt ? MHPMEVENT_BIT_VUINH : MHPMEVENT_BIT_UINH);
+    default:
+        return false;
+    }
+}
+
 static int riscv_pmu_incr_ctr_rv32(RISCVCPU *cpu, uint32_t ctr_idx)
 {
     CPURISCVState *env = &cpu->env;
     target_ulong max_val = UINT32_MAX;
     PMUCTRState *counter = &env->pmu_ctrs[ctr_idx];
-    bool virt_on = env->virt_enabled;
 
     /* Privilege mode filtering */
-    if ((env->priv == PRV_M &&
-        (env->mhpmeventh_val[ctr_idx] & MHPMEVENTH_BIT_MINH)) ||
-        (env->priv == PRV_S && virt_on &&
-        (env->mhpmeventh_val[ctr_idx] & MHPMEVENTH_BIT_VSINH)) ||
-        (env->priv == PRV_U && virt_on &&
-        (env->mhpmeventh_val[ctr_idx] & MHPMEVENTH_BIT_VUINH)) ||
-        (env->priv == PRV_S && !virt_on &&
-        (env->mhpmeventh_val[ctr_idx] & MHPMEVENTH_BIT_SINH)) ||
-        (env->priv == PRV_U && !virt_on &&
-        (env->mhpmeventh_val[ctr_idx] & MHPMEVENTH_BIT_UINH))) {
+    if (riscv_pmu_ctr_filtered(env, ctr_idx, env->priv, env->virt_enabled)) {
         return 0;
     }
 
@@ -147,19 +198,9 @@ static int riscv_pmu_incr_ctr_rv64(RISCVCPU *cpu, uint32_t ctr_idx)
     CPURISCVState *env = &cpu->env;
     PMUCTRState *counter = &env->pmu_ctrs[ctr_idx];
     uint64_t max_val = UINT64_MAX;
-    bool virt_on = env->virt_enabled;
 
     /* Privilege mode filtering */
-    if ((env->priv == PRV_M &&
-        (env->mhpmevent_val[ctr_idx] & MHPMEVENT_BIT_MINH)) ||
-        (env->priv == PRV_S && virt_on &&
-        (env->mhpmevent_val[ctr_idx] & MHPMEVENT_BIT_VSINH)) ||
-        (env->priv == PRV_U && virt_on &&
-        (env->mhpmevent_val[ctr_idx] & MHPMEVENT_BIT_VUINH)) ||
-        (env->priv == PRV_S && !virt_on &&
-        (env->mhpmevent_val[ctr_idx] & MHPMEVENT_BIT_SINH)) ||
-        (env->priv == PRV_U && !virt_on &&
-        (env->mhpmevent_val[ctr_idx] & MHPMEVENT_BIT_UINH))) {
+    if (riscv_pmu_ctr_filtered(env, ctr_idx, env->priv, env->virt_enabled)) {
         return 0;
     }
 
@@ -394,28 +435,36 @@ int riscv_pmu_update_event_map(CPURISCVState *env, uint64_t value,
         g_hash_table_foreach_remove(cpu->pmu_event_ctr_map,
                                     pmu_remove_event_map,
                                     GUINT_TO_POINTER(ctr_idx));
+        riscv_pmu_refresh_insn_events(env);
         return 0;
     }
 
     event_idx = value & MHPMEVENT_IDX_MASK;
     if (g_hash_table_lookup(cpu->pmu_event_ctr_map,
                             GUINT_TO_POINTER(event_idx))) {
+        /* The mode filter bits may still have changed */
+        riscv_pmu_refresh_insn_events(env);
         return 0;
     }
 
     switch (event_idx) {
     case RISCV_PMU_EVENT_HW_CPU_CYCLES:
     case RISCV_PMU_EVENT_HW_INSTRUCTIONS:
+    case RISCV_PMU_EVENT_HW_BRANCH_INSTRUCTIONS:
+    case RISCV_PMU_EVENT_CACHE_L1D_READ_ACCESS:
+    case RISCV_PMU_EVENT_CACHE_L1D_WRITE_ACCESS:
     case RISCV_PMU_EVENT_CACHE_DTLB_READ_MISS:
     case RISCV_PMU_EVENT_CACHE_DTLB_WRITE_MISS:
     case RISCV_PMU_EVENT_CACHE_ITLB_PREFETCH_MISS:
+    case RISCV_PMU_EVENT_RAW_BRANCH_TAKEN:
+    case RISCV_PMU_EVENT_RAW_EXCEPTION:
         break;
     default:
-        /* We don't support any raw events right now */
         return -1;
     }
     g_hash_table_insert(cpu->pmu_event_ctr_map, GUINT_TO_POINTER(event_idx),
                         GUINT_TO_POINTER(ctr_idx));
+    riscv_pmu_refresh_insn_events(env);
 
     return 0;
 }
@@ -457,6 +506,123 @@ static bool pmu_hpmevent_set_of_if_clear(CPURISCVState *env, uint32_t ctr_idx)
     return false;
 }
 
+/*
+ * Loads, stores and branches are counted by code that the translator
+ * emits only while an enabled counter is mapped to the event and not
+ * inhibited in the current mode; see TB_FLAGS2.PMU_EVENTS.  That code
+ * increments env->pmu_insn_count[] and calls helper_pmu_insn_sync() once
+ * the count reaches env->pmu_insn_limit[], i.e. when the counter wraps,
+ * so LCOFI is raised at the overflowing instruction.  Otherwise counts
+ * are folded into the counters lazily, whenever they are read, written
+ * or remapped.
+ */
+static const uint32_t pmu_insn_event_idx[RISCV_PMU_INSN_EVENTS] = {
+    [RISCV_PMU_INSN_LOAD] = RISCV_PMU_EVENT_CACHE_L1D_READ_ACCESS,
+    [RISCV_PMU_INSN_STORE] = RISCV_PMU_EVENT_CACHE_L1D_WRITE_ACCESS,
+    [RISCV_PMU_INSN_BRANCH] = RISCV_PMU_EVENT_HW_BRANCH_INSTRUCTIONS,
+    [RISCV_PMU_INSN_BRANCH_TAKEN] = RISCV_PMU_EVENT_RAW_BRANCH_TAKEN,
+};
+
+static uint64_t pmu_ctr_get(CPURISCVState *env, uint32_t ctr_idx)
+{
+    PMUCTRState *counter = &env->pmu_ctrs[ctr_idx];
+
+    if (riscv_cpu_mxl(env) == MXL_RV32) {
+        return (uint64_t)counter->mhpmcounterh_val << 32 |
+               (uint32_t)counter->mhpmcounter_val;
+    }
+    return counter->mhpmcounter_val;
+}
+
+static void pmu_ctr_add(CPURISCVState *env, uint32_t ctr_idx, uint64_t n)
+{
+    PMUCTRState *counter = &env->pmu_ctrs[ctr_idx];
+    uint64_t old_val = pmu_ctr_get(env, ctr_idx);
+    uint64_t new_val = old_val + n;
+
+    counter->mhpmcounter_val = new_val;
+    if (riscv_cpu_mxl(env) == MXL_RV32) {
+        counter->mhpmcounter_val = (uint32_t)new_val;
+        counter->mhpmcounterh_val = new_val >> 32;
+    }
+
+    /* Generate interrupt only if OF bit is clear */
+    if (new_val < old_val && pmu_hpmevent_set_of_if_clear(env, ctr_idx)) {
+        riscv_cpu_update_mip(env, MIP_LCOFIP, BOOL_TO_MASK(1));
+    }
+}
+
+void riscv_pmu_sync_insn_events(CPURISCVState *env)
+{
+    int ev;
+
+    for (ev = 0; ev < RISCV_PMU_INSN_EVENTS; ev++) {
+        uint64_t n = env->pmu_insn_count[ev];
+
+        env->pmu_insn_count[ev] = 0;
+        if (n && env->pmu_insn_ctr[ev]) {
+            pmu_ctr_add(env, env->pmu_insn_ctr[ev], n);
+        }
+    }
+
+    /* A count of 0 never matches, so an unmapped event never syncs. */
+    for (ev = 0; ev < RISCV_PMU_INSN_EVENTS; ev++) {
+        uint32_t ctr_idx = env->pmu_insn_ctr[ev];
+
+        env->pmu_insn_limit[ev] = ctr_idx ? -pmu_ctr_get(env, ctr_idx) : 0;
+    }
+}
+
+/*
+ * Recompute which counter each inline event feeds and in which modes it
+ * is counted.  Must be called after any change to the event map,
+ * mhpmevent filter bits, mcountinhibit or the counter values.  Callers
+ * return to the main loop afterwards, so the new TB_FLAGS2 take effect.
+ */
+void riscv_pmu_refresh_insn_events(CPURISCVState *env)
+{
+    RISCVCPU *cpu = env_archcpu(env);
+    static const target_ulong privs[] = { PRV_U, PRV_S, PRV_M };
+    int ev, virt, i;
+
+    /* Pending counts belong to the old mapping. */
+    riscv_pmu_sync_insn_events(env);
+
+    for (ev = 0; ev < RISCV_PMU_INSN_EVENTS; ev++) {
+        uint32_t ctr_idx = 0;
+
+        if (cpu->pmu_event_ctr_map) {
+            ctr_idx = GPOINTER_TO_UINT(
+                g_hash_table_lookup(cpu->pmu_event_ctr_map,
+                                    GUINT_TO_POINTER(pmu_insn_event_idx[ev])));
+        }
+        if (!riscv_pmu_counter_enabled(cpu, ctr_idx)) {
+            ctr_idx = 0;
+        }
+        env->pmu_insn_ctr[ev] = ctr_idx;
+    }
+
+    memset(env->pmu_insn_mask, 0, sizeof(env->pmu_insn_mask));
+    for (virt = 0; virt < 2; virt++) {
+        for (i = 0; i < ARRAY_SIZE(privs); i++) {
+            if (virt && privs[i] == PRV_M) {
+                continue;
+            }
+            for (ev = 0; ev < RISCV_PMU_INSN_EVENTS; ev++) {
+                uint32_t ctr_idx = env->pmu_insn_ctr[ev];
+
+                if (ctr_idx &&
+                    !riscv_pmu_ctr_filtered(env, ctr_idx, privs[i], virt)) {
+                    env->pmu_insn_mask[virt][privs[i]] |= BIT(ev);
+                }
+            }
+        }
+    }
+
+    /* Recompute the limits for the new mapping. */
+    riscv_pmu_sync_insn_events(env);
+}
+
 static void pmu_timer_trigger_irq(RISCVCPU *cpu,
                                   enum riscv_pmu_event_idx evt_idx)
 {
@@ -38,5 +38,7 @@ void riscv_pmu_update_fixed_ctrs(CPURISCVState *env, target_ulong newpriv,
                                  bool new_virt);
 RISCVException riscv_pmu_read_ctr(CPURISCVState *env, target_ulong *val,
                                   bool upper_half, uint32_t ctr_idx);
+void riscv_pmu_sync_insn_events(CPURISCVState *env);
+void riscv_pmu_refresh_insn_events(CPURISCVState *env);
 
 #endif /* RISCV_PMU_H */
@@ -30,6 +30,7 @@
 #include "qemu/accel.h"
 #include "qemu/error-report.h"
 #include "qemu/log.h"
+#include "qemu/host-utils.h"
 #include "accel/accel-cpu-target.h"
 #include "accel/tcg/cpu-ops.h"
 #include "tcg/tcg.h"
@@ -104,6 +105,7 @@ static TCGTBCPUState riscv_get_tb_cpu_state(CPUState *cs)
     RISCVCPU *cpu = env_archcpu(env);
     RISCVExtStatus fs, vs;
     uint32_t flags = 0;
+    uint64_t flags2 = 0;
     bool pm_signext = riscv_cpu_virt_mem_enabled(env);
 
     if (cpu->cfg.ext_zve32x) {
@@ -180,6 +182,9 @@ static TCGTBCPUState riscv_get_tb_cpu_state(CPUState *cs)
     if (cpu->cfg.debug && !icount_enabled()) {
         flags = FIELD_DP32(flags, TB_FLAGS, ITRIGGER, env->itrigger_enabled);
     }
+
+    flags2 = FIELD_DP64(flags2, TB_FLAGS2, PMU_EVENTS,
+                        env->pmu_insn_mask[env->virt_enabled][env->priv]);
 #endif
 
     flags = FIELD_DP32(flags, TB_FLAGS, FS, fs);
@@ -191,7 +196,8 @@ static TCGTBCPUState riscv_get_tb_cpu_state(CPUState *cs)
 
     return (TCGTBCPUState){
         .pc = env->xl == MXL_RV32 ? env->pc & UINT32_MAX : env->pc,
-        .flags = flags
+        .flags = flags,
+        .cs_base = flags2,
     };
 }
 
@@ -1151,19 +1157,56 @@ void riscv_tcg_cpu_finalize_features(RISCVCPU *cpu, Error **errp)
 #endif
 }
 
+/*
+ * Build one decoder list per major opcode, keeping decoder_table order
+ * and dropping decoders that are disabled or cannot match that opcode,
+ * so decode_opc() only runs decoders that may claim the instruction.
+ * Majors that end up with the same set of decoders share one list.
+ */
 void riscv_tcg_cpu_finalize_dynamic_decoder(RISCVCPU *cpu)
 {
-    GPtrArray *dynamic_decoders;
-    dynamic_decoders = g_ptr_array_sized_new(decoder_table_size);
+    GPtrArray *lists[RISCV_MAJOR_OPCODES] = { };
+    uint64_t sets[RISCV_MAJOR_OPCODES];
+    uint64_t enabled = 0;
+
+    g_assert(decoder_table_size <= 64);
     for (size_t i = 0; i < decoder_table_size; ++i) {
         if (decoder_table[i].guard_func &&
             decoder_table[i].guard_func(&cpu->cfg)) {
-            g_ptr_array_add(dynamic_decoders,
-                            (gpointer)decoder_table[i].riscv_cpu_decode_fn);
+            enabled |= BIT_ULL(i);
         }
     }
 
-    cpu->decoders = dynamic_decoders;
+    for (int opc = 0; opc < RISCV_MAJOR_OPCODES; ++opc) {
+        uint64_t set = 0;
+
+        for (size_t i = 0; i < decoder_table_size; ++i) {
+            if ((enabled & BIT_ULL(i)) &&
+                (decoder_table[i].opcodes & RISCV_DECODER_OPC(opc))) {
+                set |= BIT_ULL(i);
+            }
+        }
+        sets[opc] = set;
+
+        for (int prev = 0; prev < opc; ++prev) {
+            if (sets[prev] == set) {
+                lists[opc] = lists[prev];
+                break;
+            }
+        }
+        if (!lists[opc]) {
+            lists[opc] = g_ptr_array_sized_new(ctpop64(set));
+            for (size_t i = 0; i < decoder_table_size; ++i) {
+                const RISCVDecoder *d = &decoder_table[i];
+
+                if (set & BIT_ULL(i)) {
+                    g_ptr_array_add(lists[opc],
+                                    (gpointer)d->riscv_cpu_decode_fn);
+                }
+            }
+        }
+        cpu->decoders[opc] = lists[opc];
+    }
 }
 
 bool riscv_cpu_tcg_compatible(RISCVCPU *cpu)
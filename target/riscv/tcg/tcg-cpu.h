@@ -33,8 +33,13 @@ struct RISCVCPUConfig;
 typedef struct RISCVDecoder {
     bool (*guard_func)(const struct RISCVCPUConfig *);
     bool (*riscv_cpu_decode_fn)(struct DisasContext *, uint32_t);
+    /* Major opcodes (insn[6:2]) the decoder can match, as a bitmap */
+    uint32_t opcodes;
 } RISCVDecoder;
 
+#define RISCV_DECODER_OPC_ALL       UINT32_MAX
+#define RISCV_DECODER_OPC(major)    (1u << (major))
+
 typedef bool (*riscv_cpu_decode_fn)(struct DisasContext *, uint32_t);
 
 extern const size_t decoder_table_size;
@@ -70,9 +70,8 @@ typedef struct DisasContext {
     /*
      * Remember the rounding mode encoded in the previous fp instruction,
      * which we have already installed into env->fp_status.  Or -1 for
-     * no previous fp instruction.  Note that we exit the TB when writing
-     * to any system register, which includes CSR_FRM, so we do not have
-     * to reset this known value.
+     * no previous fp instruction.  Writes to CSR_FRM either exit the TB
+     * or, when expanded inline by do_csr_fast(), reset this to -1.
      */
     int frm;
     RISCVMXL ol;
@@ -112,12 +111,24 @@ typedef struct DisasContext {
     /* FRM is known to contain a valid value. */
     bool frm_valid;
     bool insn_start_updated;
-    const GPtrArray *decoders;
+    const GPtrArray *const *decoders;
     /* zicfilp extension. fcfi_enabled, lp expected or not */
     bool fcfi_enabled;
     bool fcfi_lp_expected;
     /* zicfiss extension, if shadow stack was enabled during TB gen */
     bool bcfi_enabled;
+    /* Bitmap of RISCVPMUInsnEvent to count, from TB_FLAGS2 */
+    uint8_t pmu_events;
+    /*
+     * Destination and value of a "li rd, imm" (addi rd, x0, imm) emitted
+     * by the current insn, and by the insn immediately before it in this
+     * TB.  Used to specialize the G233 custom insns for small, constant
+     * sizes.  A register number of 0 means no such insn.
+     */
+    int li_rd;
+    target_long li_imm;
+    int prev_li_rd;
+    target_long prev_li_imm;
 } DisasContext;
 
 static inline bool has_ext(DisasContext *ctx, uint32_t ext)
@@ -600,6 +611,37 @@ static void gen_ctr_jal(DisasContext *ctx, int rd, target_ulong imm)
 }
 #endif
 
+/*
+ * Count one PMU event for the current insn, if a counter is programmed
+ * for it in this mode.  Called once the insn can no longer fault.
+ */
+static void gen_pmu_event(DisasContext *ctx, RISCVPMUInsnEvent ev)
+{
+#ifndef CONFIG_USER_ONLY
+    TCGv_i64 count, limit;
+    TCGLabel *done;
+
+    if (!(ctx->pmu_events & BIT(ev))) {
+        return;
+    }
+
+    count = tcg_temp_new_i64();
+    limit = tcg_temp_new_i64();
+    done = gen_new_label();
+
+    tcg_gen_ld_i64(count, tcg_env,
+                   offsetof(CPURISCVState, pmu_insn_count[ev]));
+    tcg_gen_addi_i64(count, count, 1);
+    tcg_gen_st_i64(count, tcg_env,
+                   offsetof(CPURISCVState, pmu_insn_count[ev]));
+    tcg_gen_ld_i64(limit, tcg_env,
+                   offsetof(CPURISCVState, pmu_insn_limit[ev]));
+    tcg_gen_brcond_i64(TCG_COND_NE, count, limit, done);
+    gen_helper_pmu_insn_sync(tcg_env);
+    gen_set_label(done);
+#endif
+}
+
 static void gen_jal(DisasContext *ctx, int rd, target_ulong imm)
 {
     TCGv succ_pc = dest_gpr(ctx, rd);
@@ -625,6 +667,8 @@ static void gen_jal(DisasContext *ctx, int rd, target_ulong imm)
     gen_pc_plus_diff(succ_pc, ctx, ctx->cur_insn_len);
     gen_set_gpr(ctx, rd, succ_pc);
 
+    gen_pmu_event(ctx, RISCV_PMU_INSN_BRANCH);
+    gen_pmu_event(ctx, RISCV_PMU_INSN_BRANCH_TAKEN);
     gen_goto_tb(ctx, 0, imm); /* must use this for safety */
     ctx->base.is_jmp = DISAS_NORETURN;
 }
@@ -1209,16 +1253,30 @@ static uint32_t opcode_at(DisasContextBase *dcbase, target_ulong pc)
 /* The specification allows for longer insns, but not supported by qemu. */
 #define MAX_INSN_LEN  4
 
+/* Major opcodes, insn[6:2] */
+#define OPC_CUSTOM_0    0x02
+#define OPC_CUSTOM_3    0x1e
+
+/*
+ * Vendor decoders only claim custom opcode space, so list that here and
+ * let riscv_tcg_cpu_finalize_dynamic_decoder() skip them for every other
+ * major opcode.  This only saves work on CPUs with vendor extensions:
+ * without them every major opcode maps to decode_insn32 alone, and
+ * decode_insn32 and decode_insn16 are decodetree switches on opcode bits
+ * already.
+ */
 const RISCVDecoder decoder_table[] = {
-    { always_true_p, decode_insn32 },
-    { has_xthead_p, decode_xthead},
-    { has_XVentanaCondOps_p, decode_XVentanaCodeOps},
+    { always_true_p, decode_insn32, RISCV_DECODER_OPC_ALL },
+    { has_xthead_p, decode_xthead, RISCV_DECODER_OPC(OPC_CUSTOM_0) },
+    { has_XVentanaCondOps_p, decode_XVentanaCodeOps,
+      RISCV_DECODER_OPC(OPC_CUSTOM_3) },
 };
 
 const size_t decoder_table_size = ARRAY_SIZE(decoder_table);
 
 static void decode_opc(CPURISCVState *env, DisasContext *ctx)
 {
+    const GPtrArray *decoders;
     uint32_t opcode;
     bool pc_is_4byte_align = ((ctx->base.pc_next % 4) == 0);
 
@@ -1263,8 +1321,9 @@ static void decode_opc(CPURISCVState *env, DisasContext *ctx)
         }
         ctx->opcode = opcode;
 
-        for (guint i = 0; i < ctx->decoders->len; ++i) {
-            riscv_cpu_decode_fn func = g_ptr_array_index(ctx->decoders, i);
+        decoders = ctx->decoders[extract32(opcode, 2, 5)];
+        for (guint i = 0; i < decoders->len; ++i) {
+            riscv_cpu_decode_fn func = g_ptr_array_index(decoders, i);
             if (func(ctx, opcode)) {
                 return;
             }
@@ -1317,9 +1376,12 @@ static void riscv_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cs)
     ctx->bcfi_enabled = FIELD_EX32(tb_flags, TB_FLAGS, BCFI_ENABLED);
     ctx->fcfi_lp_expected = FIELD_EX32(tb_flags, TB_FLAGS, FCFI_LP_EXPECTED);
     ctx->fcfi_enabled = FIELD_EX32(tb_flags, TB_FLAGS, FCFI_ENABLED);
+    ctx->pmu_events = FIELD_EX64(ctx->base.tb->cs_base,
+                                 TB_FLAGS2, PMU_EVENTS);
     ctx->zero = tcg_constant_tl(0);
     ctx->virt_inst_excp = false;
     ctx->decoders = cpu->decoders;
+    ctx->li_rd = 0;
 }
 
 static void riscv_tr_tb_start(DisasContextBase *db, CPUState *cpu)
@@ -1344,6 +1406,10 @@ static void riscv_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
     DisasContext *ctx = container_of(dcbase, DisasContext, base);
     CPURISCVState *env = cpu_env(cpu);
 
+    ctx->prev_li_rd = ctx->li_rd;
+    ctx->prev_li_imm = ctx->li_imm;
+    ctx->li_rd = 0;
+
     decode_opc(env, ctx);
     ctx->base.pc_next += ctx->cur_insn_len;
 
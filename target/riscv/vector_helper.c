@@ -274,23 +274,91 @@ static void vext_set_tail_elems_1s(target_ulong vl, void *vd,
     }
 }
 
+/*
+ * Host page cache for strided and indexed accesses.
+ *
+ * Elements are resolved a page at a time: the first element that lands
+ * in a page probes the whole page without faulting, and if it is plain
+ * RAM accessible in its entirety (no MMIO, watchpoint, dirty tracking or
+ * sub-page PMP) later elements in that page are accessed through the
+ * host pointer.  Anything else goes through the TLB one element at a
+ * time, so faults are still raised on the right element with vstart
+ * pointing at it.
+ */
+#define VEXT_PAGE_CACHE_SIZE 4
+
+typedef struct {
+    target_ulong page;
+    void *host;             /* NULL: page must use the TLB path */
+} VextPageCache;
+
+static inline void vext_page_cache_init(VextPageCache *cache)
+{
+    for (int i = 0; i < VEXT_PAGE_CACHE_SIZE; i++) {
+        cache[i].page = -1;  /* never page aligned, so never matches */
+    }
+}
+
+static inline QEMU_ALWAYS_INLINE void
+vext_ldst_elem_cached(CPURISCVState *env, VextPageCache *cache,
+                      target_ulong addr, uint32_t idx, void *vd,
+                      uint32_t esz, MMUAccessType access_type, int mmu_index,
+                      vext_ldst_elem_fn_tlb *ldst_tlb,
+                      vext_ldst_elem_fn_host *ldst_host, uintptr_t ra)
+{
+    target_ulong page, off;
+    VextPageCache *c;
+
+    addr = adjust_addr(env, addr);
+    page = addr & TARGET_PAGE_MASK;
+    off = addr - page;
+
+    if (unlikely(off + esz > TARGET_PAGE_SIZE)) {
+        ldst_tlb(env, addr, idx, vd, ra);
+        return;
+    }
+
+    c = &cache[(page >> TARGET_PAGE_BITS) % VEXT_PAGE_CACHE_SIZE];
+    if (c->page != page) {
+        void *host;
+        int flags = probe_access_flags(env, page, TARGET_PAGE_SIZE,
+                                       access_type, mmu_index, true,
+                                       &host, ra);
+
+        c->page = page;
+        c->host = flags == 0 ? host : NULL;
+    }
+
+    if (likely(c->host)) {
+        ldst_host(vd, idx, c->host + off);
+    } else {
+        ldst_tlb(env, addr, idx, vd, ra);
+    }
+}
+
 /*
  * stride: access vector element from strided memory
  */
 static void
 vext_ldst_stride(void *vd, void *v0, target_ulong base, target_ulong stride,
                  CPURISCVState *env, uint32_t desc, uint32_t vm,
-                 vext_ldst_elem_fn_tlb *ldst_elem, uint32_t log2_esz,
-                 uintptr_t ra)
+                 vext_ldst_elem_fn_tlb *ldst_elem,
+                 vext_ldst_elem_fn_host *ldst_host, uint32_t log2_esz,
+                 uintptr_t ra, bool is_load)
 {
     uint32_t i, k;
     uint32_t nf = vext_nf(desc);
     uint32_t max_elems = vext_max_elems(desc, log2_esz);
     uint32_t esz = 1 << log2_esz;
     uint32_t vma = vext_vma(desc);
+    MMUAccessType access_type = is_load ? MMU_DATA_LOAD : MMU_DATA_STORE;
+    int mmu_index = riscv_env_mmu_index(env, false);
+    VextPageCache cache[VEXT_PAGE_CACHE_SIZE];
 
     VSTART_CHECK_EARLY_EXIT(env, env->vl);
 
+    vext_page_cache_init(cache);
+
     for (i = env->vstart; i < env->vl; env->vstart = ++i) {
         k = 0;
         while (k < nf) {
@@ -302,7 +370,9 @@ vext_ldst_stride(void *vd, void *v0, target_ulong base, target_ulong stride,
                 continue;
             }
             target_ulong addr = base + stride * i + (k << log2_esz);
-            ldst_elem(env, adjust_addr(env, addr), i + k * max_elems, vd, ra);
+            vext_ldst_elem_cached(env, cache, addr, i + k * max_elems, vd,
+                                  esz, access_type, mmu_index, ldst_elem,
+                                  ldst_host, ra);
             k++;
         }
     }
@@ -317,14 +387,15 @@ void HELPER(NAME)(void *vd, void * v0, target_ulong base,               \
                   uint32_t desc)                                        \
 {                                                                       \
     uint32_t vm = vext_vm(desc);                                        \
-    vext_ldst_stride(vd, v0, base, stride, env, desc, vm, LOAD_FN,      \
-                     ctzl(sizeof(ETYPE)), GETPC());                     \
+    vext_ldst_stride(vd, v0, base, stride, env, desc, vm,               \
+                     LOAD_FN##_tlb, LOAD_FN##_host,                     \
+                     ctzl(sizeof(ETYPE)), GETPC(), true);               \
 }
 
-GEN_VEXT_LD_STRIDE(vlse8_v,  int8_t,  lde_b_tlb)
-GEN_VEXT_LD_STRIDE(vlse16_v, int16_t, lde_h_tlb)
-GEN_VEXT_LD_STRIDE(vlse32_v, int32_t, lde_w_tlb)
-GEN_VEXT_LD_STRIDE(vlse64_v, int64_t, lde_d_tlb)
+GEN_VEXT_LD_STRIDE(vlse8_v,  int8_t,  lde_b)
+GEN_VEXT_LD_STRIDE(vlse16_v, int16_t, lde_h)
+GEN_VEXT_LD_STRIDE(vlse32_v, int32_t, lde_w)
+GEN_VEXT_LD_STRIDE(vlse64_v, int64_t, lde_d)
 
 #define GEN_VEXT_ST_STRIDE(NAME, ETYPE, STORE_FN)                       \
 void HELPER(NAME)(void *vd, void *v0, target_ulong base,                \
@@ -332,14 +403,15 @@ void HELPER(NAME)(void *vd, void *v0, target_ulong base,                \
                   uint32_t desc)                                        \
 {                                                                       \
     uint32_t vm = vext_vm(desc);                                        \
-    vext_ldst_stride(vd, v0, base, stride, env, desc, vm, STORE_FN,     \
-                     ctzl(sizeof(ETYPE)), GETPC());                     \
+    vext_ldst_stride(vd, v0, base, stride, env, desc, vm,               \
+                     STORE_FN##_tlb, STORE_FN##_host,                   \
+                     ctzl(sizeof(ETYPE)), GETPC(), false);              \
 }
 
-GEN_VEXT_ST_STRIDE(vsse8_v,  int8_t,  ste_b_tlb)
-GEN_VEXT_ST_STRIDE(vsse16_v, int16_t, ste_h_tlb)
-GEN_VEXT_ST_STRIDE(vsse32_v, int32_t, ste_w_tlb)
-GEN_VEXT_ST_STRIDE(vsse64_v, int64_t, ste_d_tlb)
+GEN_VEXT_ST_STRIDE(vsse8_v,  int8_t,  ste_b)
+GEN_VEXT_ST_STRIDE(vsse16_v, int16_t, ste_h)
+GEN_VEXT_ST_STRIDE(vsse32_v, int32_t, ste_w)
+GEN_VEXT_ST_STRIDE(vsse64_v, int64_t, ste_d)
 
 /*
  * unit-stride: access elements stored contiguously in memory
@@ -481,7 +553,8 @@ void HELPER(NAME##_mask)(void *vd, void *v0, target_ulong base,     \
 {                                                                   \
     uint32_t stride = vext_nf(desc) << ctzl(sizeof(ETYPE));         \
     vext_ldst_stride(vd, v0, base, stride, env, desc, false,        \
-                     LOAD_FN_TLB, ctzl(sizeof(ETYPE)), GETPC());    \
+                     LOAD_FN_TLB, LOAD_FN_HOST, ctzl(sizeof(ETYPE)),\
+                     GETPC(), true);                                \
 }                                                                   \
                                                                     \
 void HELPER(NAME)(void *vd, void *v0, target_ulong base,            \
@@ -502,7 +575,8 @@ void HELPER(NAME##_mask)(void *vd, void *v0, target_ulong base,          \
 {                                                                        \
     uint32_t stride = vext_nf(desc) << ctzl(sizeof(ETYPE));              \
     vext_ldst_stride(vd, v0, base, stride, env, desc, false,             \
-                     STORE_FN_TLB, ctzl(sizeof(ETYPE)), GETPC());        \
+                     STORE_FN_TLB, STORE_FN_HOST, ctzl(sizeof(ETYPE)),   \
+                     GETPC(), false);                                    \
 }                                                                        \
                                                                          \
 void HELPER(NAME)(void *vd, void *v0, target_ulong base,                 \
@@ -561,7 +635,8 @@ vext_ldst_index(void *vd, void *v0, target_ulong base,
                 void *vs2, CPURISCVState *env, uint32_t desc,
                 vext_get_index_addr get_index_addr,
                 vext_ldst_elem_fn_tlb *ldst_elem,
-                uint32_t log2_esz, uintptr_t ra)
+                vext_ldst_elem_fn_host *ldst_host,
+                uint32_t log2_esz, uintptr_t ra, bool is_load)
 {
     uint32_t i, k;
     uint32_t nf = vext_nf(desc);
@@ -569,9 +644,14 @@ vext_ldst_index(void *vd, void *v0, target_ulong base,
     uint32_t max_elems = vext_max_elems(desc, log2_esz);
     uint32_t esz = 1 << log2_esz;
     uint32_t vma = vext_vma(desc);
+    MMUAccessType access_type = is_load ? MMU_DATA_LOAD : MMU_DATA_STORE;
+    int mmu_index = riscv_env_mmu_index(env, false);
+    VextPageCache cache[VEXT_PAGE_CACHE_SIZE];
 
     VSTART_CHECK_EARLY_EXIT(env, env->vl);
 
+    vext_page_cache_init(cache);
+
     /* load bytes from guest memory */
     for (i = env->vstart; i < env->vl; env->vstart = ++i) {
         k = 0;
@@ -584,7 +664,9 @@ vext_ldst_index(void *vd, void *v0, target_ulong base,
                 continue;
             }
             abi_ptr addr = get_index_addr(base, i, vs2) + (k << log2_esz);
-            ldst_elem(env, adjust_addr(env, addr), i + k * max_elems, vd, ra);
+            vext_ldst_elem_cached(env, cache, addr, i + k * max_elems, vd,
+                                  esz, access_type, mmu_index, ldst_elem,
+                                  ldst_host, ra);
             k++;
         }
     }
@@ -598,51 +680,52 @@ void HELPER(NAME)(void *vd, void *v0, target_ulong base,                   \
                   void *vs2, CPURISCVState *env, uint32_t desc)            \
 {                                                                          \
     vext_ldst_index(vd, v0, base, vs2, env, desc, INDEX_FN,                \
-                    LOAD_FN, ctzl(sizeof(ETYPE)), GETPC());                \
-}
-
-GEN_VEXT_LD_INDEX(vlxei8_8_v,   int8_t,  idx_b, lde_b_tlb)
-GEN_VEXT_LD_INDEX(vlxei8_16_v,  int16_t, idx_b, lde_h_tlb)
-GEN_VEXT_LD_INDEX(vlxei8_32_v,  int32_t, idx_b, lde_w_tlb)
-GEN_VEXT_LD_INDEX(vlxei8_64_v,  int64_t, idx_b, lde_d_tlb)
-GEN_VEXT_LD_INDEX(vlxei16_8_v,  int8_t,  idx_h, lde_b_tlb)
-GEN_VEXT_LD_INDEX(vlxei16_16_v, int16_t, idx_h, lde_h_tlb)
-GEN_VEXT_LD_INDEX(vlxei16_32_v, int32_t, idx_h, lde_w_tlb)
-GEN_VEXT_LD_INDEX(vlxei16_64_v, int64_t, idx_h, lde_d_tlb)
-GEN_VEXT_LD_INDEX(vlxei32_8_v,  int8_t,  idx_w, lde_b_tlb)
-GEN_VEXT_LD_INDEX(vlxei32_16_v, int16_t, idx_w, lde_h_tlb)
-GEN_VEXT_LD_INDEX(vlxei32_32_v, int32_t, idx_w, lde_w_tlb)
-GEN_VEXT_LD_INDEX(vlxei32_64_v, int64_t, idx_w, lde_d_tlb)
-GEN_VEXT_LD_INDEX(vlxei64_8_v,  int8_t,  idx_d, lde_b_tlb)
-GEN_VEXT_LD_INDEX(vlxei64_16_v, int16_t, idx_d, lde_h_tlb)
-GEN_VEXT_LD_INDEX(vlxei64_32_v, int32_t, idx_d, lde_w_tlb)
-GEN_VEXT_LD_INDEX(vlxei64_64_v, int64_t, idx_d, lde_d_tlb)
+                    LOAD_FN##_tlb, LOAD_FN##_host, ctzl(sizeof(ETYPE)),    \
+                    GETPC(), true);                                        \
+}
+
+GEN_VEXT_LD_INDEX(vlxei8_8_v,   int8_t,  idx_b, lde_b)
+GEN_VEXT_LD_INDEX(vlxei8_16_v,  int16_t, idx_b, lde_h)
+GEN_VEXT_LD_INDEX(vlxei8_32_v,  int32_t, idx_b, lde_w)
+GEN_VEXT_LD_INDEX(vlxei8_64_v,  int64_t, idx_b, lde_d)
+GEN_VEXT_LD_INDEX(vlxei16_8_v,  int8_t,  idx_h, lde_b)
+GEN_VEXT_LD_INDEX(vlxei16_16_v, int16_t, idx_h, lde_h)
+GEN_VEXT_LD_INDEX(vlxei16_32_v, int32_t, idx_h, lde_w)
+GEN_VEXT_LD_INDEX(vlxei16_64_v, int64_t, idx_h, lde_d)
+GEN_VEXT_LD_INDEX(vlxei32_8_v,  int8_t,  idx_w, lde_b)
+GEN_VEXT_LD_INDEX(vlxei32_16_v, int16_t, idx_w, lde_h)
+GEN_VEXT_LD_INDEX(vlxei32_32_v, int32_t, idx_w, lde_w)
+GEN_VEXT_LD_INDEX(vlxei32_64_v, int64_t, idx_w, lde_d)
+GEN_VEXT_LD_INDEX(vlxei64_8_v,  int8_t,  idx_d, lde_b)
+GEN_VEXT_LD_INDEX(vlxei64_16_v, int16_t, idx_d, lde_h)
+GEN_VEXT_LD_INDEX(vlxei64_32_v, int32_t, idx_d, lde_w)
+GEN_VEXT_LD_INDEX(vlxei64_64_v, int64_t, idx_d, lde_d)
 
 #define GEN_VEXT_ST_INDEX(NAME, ETYPE, INDEX_FN, STORE_FN)       \
 void HELPER(NAME)(void *vd, void *v0, target_ulong base,         \
                   void *vs2, CPURISCVState *env, uint32_t desc)  \
 {                                                                \
     vext_ldst_index(vd, v0, base, vs2, env, desc, INDEX_FN,      \
-                    STORE_FN, ctzl(sizeof(ETYPE)),               \
-                    GETPC());                                    \
-}
-
-GEN_VEXT_ST_INDEX(vsxei8_8_v,   int8_t,  idx_b, ste_b_tlb)
-GEN_VEXT_ST_INDEX(vsxei8_16_v,  int16_t, idx_b, ste_h_tlb)
-GEN_VEXT_ST_INDEX(vsxei8_32_v,  int32_t, idx_b, ste_w_tlb)
-GEN_VEXT_ST_INDEX(vsxei8_64_v,  int64_t, idx_b, ste_d_tlb)
-GEN_VEXT_ST_INDEX(vsxei16_8_v,  int8_t,  idx_h, ste_b_tlb)
-GEN_VEXT_ST_INDEX(vsxei16_16_v, int16_t, idx_h, ste_h_tlb)
-GEN_VEXT_ST_INDEX(vsxei16_32_v, int32_t, idx_h, ste_w_tlb)
-GEN_VEXT_ST_INDEX(vsxei16_64_v, int64_t, idx_h, ste_d_tlb)
-GEN_VEXT_ST_INDEX(vsxei32_8_v,  int8_t,  idx_w, ste_b_tlb)
-GEN_VEXT_ST_INDEX(vsxei32_16_v, int16_t, idx_w, ste_h_tlb)
-GEN_VEXT_ST_INDEX(vsxei32_32_v, int32_t, idx_w, ste_w_tlb)
-GEN_VEXT_ST_INDEX(vsxei32_64_v, int64_t, idx_w, ste_d_tlb)
-GEN_VEXT_ST_INDEX(vsxei64_8_v,  int8_t,  idx_d, ste_b_tlb)
-GEN_VEXT_ST_INDEX(vsxei64_16_v, int16_t, idx_d, ste_h_tlb)
-GEN_VEXT_ST_INDEX(vsxei64_32_v, int32_t, idx_d, ste_w_tlb)
-GEN_VEXT_ST_INDEX(vsxei64_64_v, int64_t, idx_d, ste_d_tlb)
+                    STORE_FN##_tlb, STORE_FN##_host,             \
+                    ctzl(sizeof(ETYPE)), GETPC(), false);        \
+}
+
+GEN_VEXT_ST_INDEX(vsxei8_8_v,   int8_t,  idx_b, ste_b)
+GEN_VEXT_ST_INDEX(vsxei8_16_v,  int16_t, idx_b, ste_h)
+GEN_VEXT_ST_INDEX(vsxei8_32_v,  int32_t, idx_b, ste_w)
+GEN_VEXT_ST_INDEX(vsxei8_64_v,  int64_t, idx_b, ste_d)
+GEN_VEXT_ST_INDEX(vsxei16_8_v,  int8_t,  idx_h, ste_b)
+GEN_VEXT_ST_INDEX(vsxei16_16_v, int16_t, idx_h, ste_h)
+GEN_VEXT_ST_INDEX(vsxei16_32_v, int32_t, idx_h, ste_w)
+GEN_VEXT_ST_INDEX(vsxei16_64_v, int64_t, idx_h, ste_d)
+GEN_VEXT_ST_INDEX(vsxei32_8_v,  int8_t,  idx_w, ste_b)
+GEN_VEXT_ST_INDEX(vsxei32_16_v, int16_t, idx_w, ste_h)
+GEN_VEXT_ST_INDEX(vsxei32_32_v, int32_t, idx_w, ste_w)
+GEN_VEXT_ST_INDEX(vsxei32_64_v, int64_t, idx_w, ste_d)
+GEN_VEXT_ST_INDEX(vsxei64_8_v,  int8_t,  idx_d, ste_b)
+GEN_VEXT_ST_INDEX(vsxei64_16_v, int16_t, idx_d, ste_h)
+GEN_VEXT_ST_INDEX(vsxei64_32_v, int32_t, idx_d, ste_w)
+GEN_VEXT_ST_INDEX(vsxei64_64_v, int64_t, idx_d, ste_d)
 
 /*
  * unit-stride fault-only-fisrt load instructions
@@ -52,6 +52,17 @@ struct tcg_region_tree {
     /* padding to avoid false sharing is computed at run-time */
 };
 
+/*
+ * Per-region state for reclaiming.  A region is handed to one context at
+ * a time; once that context moves on, it is full and may be reclaimed.
+ */
+struct tcg_region_info {
+    uint64_t gen;       /* when last handed to a context, 0 if never */
+    bool in_use;        /* a context is still allocating from it */
+    bool free;          /* reclaimed and not handed out again */
+    bool referenced;    /* a TB in it was reached since the last reclaim */
+};
+
 /*
  * We divide code_gen_buffer into equally-sized "regions" that TCG threads
  * dynamically allocate from as demand dictates. Given appropriate region
@@ -72,6 +83,8 @@ struct tcg_region_state {
     /* fields protected by the lock */
     size_t current; /* current region index */
     size_t agg_size_full; /* aggregate size of full regions */
+    uint64_t gen; /* regions handed out so far */
+    struct tcg_region_info *info;
 };
 
 static struct tcg_region_state region;
@@ -191,9 +204,10 @@ static void tcg_region_trees_init(void)
     }
 }
 
-static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+/* Return the index of the region holding @p, or -1 if there is none */
+static ssize_t tc_ptr_to_region_idx(const void *p)
 {
-    size_t region_idx;
+    ptrdiff_t offset;
 
     /*
      * Like tcg_splitwx_to_rw, with no assert.  The pc may come from
@@ -202,20 +216,26 @@ static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
     if (!in_code_gen_buffer(p)) {
         p -= tcg_splitwx_diff;
         if (!in_code_gen_buffer(p)) {
-            return NULL;
+            return -1;
         }
     }
 
     if (p < region.start_aligned) {
-        region_idx = 0;
-    } else {
-        ptrdiff_t offset = p - region.start_aligned;
+        return 0;
+    }
+    offset = p - region.start_aligned;
+    if (offset > region.stride * (region.n - 1)) {
+        return region.n - 1;
+    }
+    return offset / region.stride;
+}
 
-        if (offset > region.stride * (region.n - 1)) {
-            region_idx = region.n - 1;
-        } else {
-            region_idx = offset / region.stride;
-        }
+static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+{
+    ssize_t region_idx = tc_ptr_to_region_idx(p);
+
+    if (region_idx < 0) {
+        return NULL;
     }
     return region_trees + region_idx * tree_size;
 }
@@ -347,8 +367,14 @@ static void tcg_region_bounds(size_t curr_region, void **pstart, void **pend)
 
 static void tcg_region_assign(TCGContext *s, size_t curr_region)
 {
+    struct tcg_region_info *ri = &region.info[curr_region];
     void *start, *end;
 
+    ri->gen = ++region.gen;
+    ri->in_use = true;
+    ri->free = false;
+    qatomic_set(&ri->referenced, false);
+
     tcg_region_bounds(curr_region, &start, &end);
 
     s->code_gen_buffer = start;
@@ -359,12 +385,19 @@ static void tcg_region_assign(TCGContext *s, size_t curr_region)
 
 static bool tcg_region_alloc__locked(TCGContext *s)
 {
-    if (region.current == region.n) {
-        return true;
+    if (region.current < region.n) {
+        tcg_region_assign(s, region.current);
+        region.current++;
+        return false;
     }
-    tcg_region_assign(s, region.current);
-    region.current++;
-    return false;
+    /* All regions have been handed out once: take a reclaimed one */
+    for (size_t i = 0; i < region.n; i++) {
+        if (region.info[i].free) {
+            tcg_region_assign(s, i);
+            return false;
+        }
+    }
+    return true;
 }
 
 /*
@@ -374,13 +407,15 @@ static bool tcg_region_alloc__locked(TCGContext *s)
 bool tcg_region_alloc(TCGContext *s)
 {
     bool err;
-    /* read the region size now; alloc__locked will overwrite it on success */
+    /* read the region now; alloc__locked will overwrite it on success */
     size_t size_full = s->code_gen_buffer_size;
+    ssize_t prev = tc_ptr_to_region_idx(s->code_gen_buffer);
 
     qemu_mutex_lock(&region.lock);
     err = tcg_region_alloc__locked(s);
     if (!err) {
         region.agg_size_full += size_full - TCG_HIGHWATER;
+        region.info[prev].in_use = false;
     }
     qemu_mutex_unlock(&region.lock);
     return err;
@@ -412,6 +447,8 @@ void tcg_region_reset_all(void)
     qemu_mutex_lock(&region.lock);
     region.current = 0;
     region.agg_size_full = 0;
+    region.gen = 0;
+    memset(region.info, 0, region.n * sizeof(*region.info));
 
     for (i = 0; i < n_ctxs; i++) {
         TCGContext *s = qatomic_read(&tcg_ctxs[i]);
@@ -422,6 +459,95 @@ void tcg_region_reset_all(void)
     tcg_region_tree_reset_all();
 }
 
+/*
+ * Note that a TB in the region holding @tc_ptr is in use, so that
+ * tcg_region_reclaim passes the region over.
+ */
+void tcg_region_mark_used(const void *tc_ptr)
+{
+    ssize_t i = tc_ptr_to_region_idx(tc_ptr);
+
+    if (i >= 0 && !qatomic_read(&region.info[i].referenced)) {
+        qatomic_set(&region.info[i].referenced, true);
+    }
+}
+
+static gboolean tcg_region_collect_tb(gpointer key, gpointer value,
+                                      gpointer data)
+{
+    g_ptr_array_add(data, value);
+    return false;
+}
+
+/*
+ * Reclaim one full region for reuse, instead of flushing the whole
+ * buffer.  The victim is the region handed out longest ago among those
+ * in which no TB has been reached since the last reclaim, or else the
+ * oldest one.  @invalidate is called on each of its TBs first, and must
+ * leave nothing pointing to them.
+ *
+ * Call from a safe-work context.  Returns false if every region is
+ * still being filled by some context.
+ */
+bool tcg_region_reclaim(void (*invalidate)(TranslationBlock *tb))
+{
+    struct tcg_region_tree *rt;
+    ssize_t victim = -1, oldest = -1;
+    GPtrArray *tbs;
+    void *start, *end;
+
+    qemu_mutex_lock(&region.lock);
+    for (size_t i = 0; i < region.n; i++) {
+        struct tcg_region_info *ri = &region.info[i];
+
+        if (!ri->gen || ri->in_use || ri->free) {
+            continue;
+        }
+        if (oldest < 0 || ri->gen < region.info[oldest].gen) {
+            oldest = i;
+        }
+        if (!qatomic_read(&ri->referenced) &&
+            (victim < 0 || ri->gen < region.info[victim].gen)) {
+            victim = i;
+        }
+    }
+    qemu_mutex_unlock(&region.lock);
+
+    if (victim < 0) {
+        victim = oldest;
+        if (victim < 0) {
+            return false;
+        }
+    }
+
+    /* The region tree lock nests inside page locks: don't hold it here */
+    rt = region_trees + victim * tree_size;
+    tbs = g_ptr_array_new();
+    qemu_mutex_lock(&rt->lock);
+    q_tree_foreach(rt->tree, tcg_region_collect_tb, tbs);
+    qemu_mutex_unlock(&rt->lock);
+    for (guint i = 0; i < tbs->len; i++) {
+        invalidate(g_ptr_array_index(tbs, i));
+    }
+    g_ptr_array_free(tbs, true);
+
+    qemu_mutex_lock(&rt->lock);
+    q_tree_ref(rt->tree);
+    q_tree_destroy(rt->tree);
+    qemu_mutex_unlock(&rt->lock);
+
+    qemu_mutex_lock(&region.lock);
+    tcg_region_bounds(victim, &start, &end);
+    region.agg_size_full -= end - start - TCG_HIGHWATER;
+    region.info[victim].free = true;
+    /* Start a new observation period for the regions that remain */
+    for (size_t i = 0; i < region.n; i++) {
+        qatomic_set(&region.info[i].referenced, false);
+    }
+    qemu_mutex_unlock(&region.lock);
+    return true;
+}
+
 static size_t tcg_n_regions(size_t tb_size, unsigned max_threads)
 {
 #ifdef CONFIG_USER_ONLY
@@ -435,10 +561,11 @@ static size_t tcg_n_regions(size_t tb_size, unsigned max_threads)
      * being of reasonable size. If that's not possible we make do by evenly
      * dividing the code_gen_buffer among the vCPUs.
      *
-     * Use a single region if all we have is one vCPU thread.
+     * A single vCPU thread still gets a few regions, so that running
+     * out of space reclaims the oldest of them rather than everything.
      */
     if (max_threads == 1) {
-        return 1;
+        return MAX(MIN(tb_size / (2 * MiB), 8), 1);
     }
 
     /*
@@ -785,6 +912,7 @@ void tcg_region_init(size_t tb_size, int splitwx, unsigned max_threads)
      * the buffer; we will assign those to the last region.
      */
     region.n = tcg_n_regions(tb_size, max_threads);
+    region.info = g_new0(struct tcg_region_info, region.n);
     region_size = tb_size / region.n;
     region_size = QEMU_ALIGN_DOWN(region_size, page_size);
 
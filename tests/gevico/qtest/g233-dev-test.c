@@ -17,6 +17,30 @@
 #include "qemu/osdep.h"
 #include "libqtest.h"
 
+#define G233_DMA_BASE       0x10019000
+#define G233_DMA_CTRL       0x00
+#define G233_DMA_STATUS     0x04
+#define G233_DMA_DESC_LO    0x08
+#define G233_DMA_DESC_HI    0x0C
+#define G233_DMA_DOORBELL   0x10
+#define G233_DMA_COMPLETED  0x14
+
+#define G233_PLIC_PENDING   0x0c001000
+#define G233_DMA_IRQ        4
+
+/* Per-socket apertures: CLINT 64 KiB, PLIC sized for 8 contexts */
+#define G233_CLINT_BASE     0x02000000
+#define G233_CLINT_SIZE     0x10000
+#define G233_MTIMECMP       0x4000
+#define G233_PLIC_BASE      0x0c000000
+#define G233_PLIC_SIZE      0x208000
+
+#define DESC_ADDR   0x80000000ULL
+#define MAT_SRC     0x80100000ULL
+#define MAT_DST     0x80200000ULL
+#define NIB_SRC     0x80300000ULL
+#define NIB_DST     0x80300100ULL
+
 static void run_test_csr(void)
 {
     QTestState *qts = qtest_init("-machine g233");
@@ -24,11 +48,101 @@ static void run_test_csr(void)
     qtest_quit(qts);
 }
 
+static void dma_write_desc(QTestState *qts, uint64_t addr, uint32_t ctrl,
+                           uint32_t len, uint64_t src, uint64_t dst,
+                           uint64_t next)
+{
+    qtest_writel(qts, addr + 0x00, ctrl);
+    qtest_writel(qts, addr + 0x04, len);
+    qtest_writeq(qts, addr + 0x08, src);
+    qtest_writeq(qts, addr + 0x10, dst);
+    qtest_writeq(qts, addr + 0x18, next);
+}
+
+static void run_test_dma_chain(void)
+{
+    QTestState *qts = qtest_init("-machine g233");
+    uint8_t nib_src[9] = { 0x1a, 0x2b, 0x3c, 0x4d, 0x5e, 0x6f, 0x70, 0x81, 0x92 };
+    uint8_t nib_dst[5];
+    uint32_t status;
+    int i, j;
+
+    for (i = 0; i < 64; i++) {
+        qtest_writel(qts, MAT_SRC + i * 4, i);
+    }
+    qtest_memwrite(qts, NIB_SRC, nib_src, sizeof(nib_src));
+
+    /* 8x8 transpose, then a 9-byte nibble pack */
+    dma_write_desc(qts, DESC_ADDR, 1, 0, MAT_SRC, MAT_DST, DESC_ADDR + 32);
+    dma_write_desc(qts, DESC_ADDR + 32, 2, sizeof(nib_src), NIB_SRC, NIB_DST, 0);
+
+    qtest_writel(qts, G233_DMA_BASE + G233_DMA_CTRL, 0x3);
+    qtest_writel(qts, G233_DMA_BASE + G233_DMA_DESC_LO, (uint32_t)DESC_ADDR);
+    qtest_writel(qts, G233_DMA_BASE + G233_DMA_DESC_HI, DESC_ADDR >> 32);
+    qtest_writel(qts, G233_DMA_BASE + G233_DMA_DOORBELL, 1);
+
+    for (i = 0; i < 1000; i++) {
+        status = qtest_readl(qts, G233_DMA_BASE + G233_DMA_STATUS);
+        if (!(status & 1)) {
+            break;
+        }
+        qtest_clock_step(qts, 1000);
+    }
+    g_assert_cmphex(status, ==, 0x2);
+    g_assert_cmpuint(qtest_readl(qts, G233_DMA_BASE + G233_DMA_COMPLETED),
+                     ==, 2);
+    g_assert_true(qtest_readl(qts, G233_PLIC_PENDING) & (1 << G233_DMA_IRQ));
+
+    for (i = 0; i < 8; i++) {
+        for (j = 0; j < 8; j++) {
+            g_assert_cmpuint(qtest_readl(qts, MAT_DST + (i * 8 + j) * 4),
+                             ==, j * 8 + i);
+        }
+    }
+
+    qtest_memread(qts, NIB_DST, nib_dst, sizeof(nib_dst));
+    for (i = 0; i < 4; i++) {
+        g_assert_cmphex(nib_dst[i], ==,
+                        (nib_src[2 * i] & 0xf) | (nib_src[2 * i + 1] & 0xf) << 4);
+    }
+    g_assert_cmphex(nib_dst[4], ==, nib_src[8] & 0xf);
+
+    /* DONE is write-1-to-clear */
+    qtest_writel(qts, G233_DMA_BASE + G233_DMA_STATUS, 0x2);
+    g_assert_cmphex(qtest_readl(qts, G233_DMA_BASE + G233_DMA_STATUS), ==, 0);
+
+    qtest_quit(qts);
+}
+
+static void run_test_numa(void)
+{
+    QTestState *qts = qtest_init("-machine g233 -m 2G -smp 4 "
+                                 "-numa node,mem=1G,cpus=0-1 "
+                                 "-numa node,mem=1G,cpus=2-3");
+    uint64_t plic1 = G233_PLIC_BASE + G233_PLIC_SIZE;
+    uint64_t clint1 = G233_CLINT_BASE + G233_CLINT_SIZE;
+
+    /* Socket 1 has its own PLIC: source priorities are independent */
+    qtest_writel(qts, G233_PLIC_BASE + 4, 1);
+    qtest_writel(qts, plic1 + 4, 5);
+    g_assert_cmpuint(qtest_readl(qts, G233_PLIC_BASE + 4), ==, 1);
+    g_assert_cmpuint(qtest_readl(qts, plic1 + 4), ==, 5);
+
+    /* ... and its own MTIMER, whose first comparator belongs to hart 2 */
+    qtest_writeq(qts, clint1 + G233_MTIMECMP, 0x123456789ULL);
+    g_assert_cmphex(qtest_readq(qts, clint1 + G233_MTIMECMP), ==,
+                    0x123456789ULL);
+
+    qtest_quit(qts);
+}
+
 int main(int argc, char **argv)
 {
     g_test_init(&argc, &argv, NULL);
 
     qtest_add_func("g233/dev/csr", run_test_csr);
+    qtest_add_func("g233/dev/dma-chain", run_test_dma_chain);
+    qtest_add_func("g233/dev/numa", run_test_numa);
 
     return g_test_run();
 }
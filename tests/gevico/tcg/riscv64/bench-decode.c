@@ -0,0 +1,107 @@
+/*
+ * Translation throughput benchmark
+ *
+ * Runs a large block of mixed RV64GCV code, once from cached TBs and once
+ * after rewriting every word of it in place, which makes QEMU invalidate
+ * and retranslate all of its TBs.  The difference between the two is the
+ * cost of translation.
+ *
+ * The board's CPU has no vendor extensions, so the per-major-opcode
+ * decoder dispatch leaves this number unchanged; it is a baseline for
+ * translation throughput, not a measure of that change.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "bench.h"
+
+#define BENCH_REPS      1024    /* copies of the code pattern, see .rept */
+#define BENCH_PATTERN   24      /* instructions per copy */
+#define BENCH_ITERS     64
+
+static uint64_t scratch[4];
+
+void decode_block(uint64_t *buf);
+extern uint32_t decode_block_end[];
+
+/*
+ * Integer, compressed, M, F/D, V and one branch per copy, so TBs stay
+ * short the way compiled code tends to.  All results go to temporaries.
+ */
+asm(".balign 4\n"
+    "decode_block:\n"
+    "    vsetivli zero, 4, e32, m1, ta, ma\n"
+    "    .rept 1024\n"
+    "    add t0, t1, t2\n"
+    "    c.addi t3, 1\n"
+    "    c.slli t1, 3\n"
+    "    c.mv t2, t0\n"
+    "    ld t4, 0(a0)\n"
+    "    c.ld a2, 8(a0)\n"
+    "    sd t4, 16(a0)\n"
+    "    slli t5, t0, 2\n"
+    "    and t6, t5, t2\n"
+    "    mulw t5, t0, t1\n"
+    "    xori t6, t6, 0x55\n"
+    "    c.add t0, t1\n"
+    "    fadd.d ft0, ft1, ft2\n"
+    "    fmul.s ft3, ft0, ft1\n"
+    "    fld ft1, 24(a0)\n"
+    "    fcvt.d.l ft2, t0\n"
+    "    vadd.vv v1, v2, v3\n"
+    "    vle32.v v4, (a0)\n"
+    "    vmul.vx v5, v4, t0\n"
+    "    vredsum.vs v6, v5, v1\n"
+    "    sltu a3, t0, t1\n"
+    "    srai a4, t5, 7\n"
+    "    c.srli a3, 2\n"
+    "    bne zero, zero, 1f\n"
+    "1:\n"
+    "    .endr\n"
+    "    ret\n"
+    ".balign 4\n"
+    "decode_block_end:\n");
+
+/* Store every word back unchanged, which drops the TBs covering it */
+static void invalidate_block(void)
+{
+    for (volatile uint32_t *p = (uint32_t *)decode_block;
+         p < decode_block_end; p++) {
+        *p = *p;
+    }
+    asm volatile("fence.i" ::: "memory");
+}
+
+static void run(bool retranslate, bench_sample *s)
+{
+    bench_start(s);
+    for (long i = 0; i < BENCH_ITERS; i++) {
+        if (retranslate) {
+            invalidate_block();
+        }
+        decode_block(scratch);
+    }
+    bench_stop(s);
+}
+
+int main(void)
+{
+    long insns = (long)BENCH_REPS * BENCH_PATTERN;
+    bench_sample cached, cold, xlate;
+
+    /* Translate once so the cached run does not pay for it */
+    decode_block(scratch);
+
+    run(false, &cached);
+    run(true, &cold);
+    bench_report("decode", "cached", insns, BENCH_ITERS, &cached);
+    bench_report("decode", "retranslate", insns, BENCH_ITERS, &cold);
+
+    /* Instructions translated per second, net of executing them */
+    xlate.cycles = cold.cycles - cached.cycles;
+    xlate.instret = insns * BENCH_ITERS;
+    xlate.host_ns = cold.host_ns > cached.host_ns ?
+                    cold.host_ns - cached.host_ns : 0;
+    bench_report("decode", "translate", insns, BENCH_ITERS, &xlate);
+    return 0;
+}
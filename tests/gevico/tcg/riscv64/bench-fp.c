@@ -0,0 +1,106 @@
+/*
+ * Scalar floating-point benchmark
+ *
+ * A particle-update style kernel mixing fmadd, fsqrt, fmin/fmax and
+ * integer/float conversions.  It runs once with frm = RNE, where QEMU
+ * can use the host FPU, and once with frm = RDN, which keeps the
+ * rounding ops on softfloat.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "bench.h"
+
+#define BENCH_ELEMS     1024
+#define BENCH_OPS       (1 << 20)   /* element updates per run */
+
+#define FRM_RNE         0
+#define FRM_RDN         2
+
+static double px[BENCH_ELEMS], vx[BENCH_ELEMS];
+static int32_t cell[BENCH_ELEMS];
+
+static inline double fp_sqrt(double x)
+{
+    double r;
+
+    asm volatile("fsqrt.d %0, %1" : "=f"(r) : "f"(x));
+    return r;
+}
+
+static inline double fp_clamp(double x, double lo, double hi)
+{
+    asm volatile("fmax.d %0, %0, %1\n\t"
+                 "fmin.d %0, %0, %2" : "+f"(x) : "f"(lo), "f"(hi));
+    return x;
+}
+
+static inline double fp_fma(double a, double b, double c)
+{
+    double r;
+
+    asm volatile("fmadd.d %0, %1, %2, %3" : "=f"(r) : "f"(a), "f"(b), "f"(c));
+    return r;
+}
+
+static inline int32_t fp_to_cell(double x)
+{
+    long r;
+
+    asm volatile("fcvt.w.d %0, %1, rtz" : "=r"(r) : "f"(x));
+    return r;
+}
+
+static inline double fp_from_cell(int32_t c)
+{
+    double r;
+
+    asm volatile("fcvt.d.w %0, %1" : "=f"(r) : "r"((long)c));
+    return r;
+}
+
+static void kernel(long iters)
+{
+    const double dt = 0.001, drag = 0.999;
+
+    for (long it = 0; it < iters; it++) {
+        for (int i = 0; i < BENCH_ELEMS; i++) {
+            double v = fp_fma(vx[i], drag, -dt * fp_sqrt(px[i] + 1.0));
+            double p = fp_clamp(fp_fma(v, dt, px[i]), 0.0, 1000.0);
+
+            cell[i] = fp_to_cell(p * 0.125);
+            vx[i] = v + fp_from_cell(cell[i]) * 1e-6;
+            px[i] = p;
+        }
+    }
+}
+
+static void bench_fp(const char *variant, unsigned long frm)
+{
+    long iters = BENCH_OPS / BENCH_ELEMS;
+    bench_sample s;
+
+    for (int i = 0; i < BENCH_ELEMS; i++) {
+        px[i] = i * 0.75;
+        vx[i] = (i & 7) - 3.5;
+    }
+
+    asm volatile("csrw frm, %0" : : "r"(frm));
+    bench_start(&s);
+    kernel(iters);
+    bench_stop(&s);
+    asm volatile("csrw frm, %0" : : "r"(FRM_RNE));
+
+    for (int i = 0; i < BENCH_ELEMS; i++) {
+        crt_assert(px[i] >= 0.0 && px[i] <= 1000.0);
+    }
+
+    bench_report("fp", variant, BENCH_ELEMS, iters, &s);
+}
+
+int main(void)
+{
+    bench_fp("rne", FRM_RNE);
+    bench_fp("rdn", FRM_RDN);
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include "bench.h"
+
+#define BENCH_MAX_BYTES (1 << 16)
+#define BENCH_BYTES     (1 << 22)   /* source bytes processed per size */
+
+static uint8_t src[BENCH_MAX_BYTES];
+static uint8_t dst[BENCH_MAX_BYTES / 2];
+
+static void custom_crush(uintptr_t src, uintptr_t dst, int num)
+{
+    asm volatile (
+       ".insn r 0x7b, 6, 38, %0, %1, %2"
+        : :"r"(dst), "r"(src), "r"(num) : "memory");
+}
+
+static void bench_crush(int n)
+{
+    long iters = BENCH_BYTES / n;
+    bench_sample s;
+
+    for (int i = 0; i < n; i++) {
+        src[i] = i * 7;
+    }
+
+    bench_start(&s);
+    for (long i = 0; i < iters; i++) {
+        custom_crush((uintptr_t)src, (uintptr_t)dst, n);
+    }
+    bench_stop(&s);
+
+    for (int i = 0; i < n / 2; i++) {
+        crt_assert(dst[i] == ((src[2 * i] & 0xf) | (src[2 * i + 1] & 0xf) << 4));
+    }
+
+    bench_report("insn-crush", "pack", n, iters, &s);
+}
+
+int main(void)
+{
+    for (int n = 16; n <= BENCH_MAX_BYTES; n <<= 2) {
+        bench_crush(n);
+    }
+    return 0;
+}
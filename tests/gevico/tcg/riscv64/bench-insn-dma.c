@@ -0,0 +1,44 @@
+#include "bench.h"
+
+#define BENCH_ITERS 1000
+
+static uint32_t src[32 * 32];
+static uint32_t dst[32 * 32];
+
+static void custom_dma(uintptr_t src, uintptr_t dst, int grain_size)
+{
+    asm volatile (
+       ".insn r 0x7b, 6, 6, %0, %1, %2"
+        : :"r"(dst), "r"(src), "r"(grain_size) : "memory");
+}
+
+static void bench_dma(int grain, int n)
+{
+    bench_sample s;
+
+    for (int i = 0; i < n * n; i++) {
+        src[i] = i;
+    }
+
+    bench_start(&s);
+    for (int i = 0; i < BENCH_ITERS; i++) {
+        custom_dma((uintptr_t)src, (uintptr_t)dst, grain);
+    }
+    bench_stop(&s);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            crt_assert(dst[i * n + j] == src[j * n + i]);
+        }
+    }
+
+    bench_report("insn-dma", "transpose", n, BENCH_ITERS, &s);
+}
+
+int main(void)
+{
+    bench_dma(0, 8);
+    bench_dma(1, 16);
+    bench_dma(2, 32);
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include "bench.h"
+
+#define BENCH_MAX_BYTES (1 << 16)
+#define BENCH_BYTES     (1 << 22)   /* source bytes processed per size */
+
+static uint8_t src[BENCH_MAX_BYTES];
+static uint8_t dst[BENCH_MAX_BYTES * 2];
+
+static void custom_expand(uintptr_t src, uintptr_t dst, int num)
+{
+    asm volatile (
+       ".insn r 0x7b, 6, 54, %0, %1, %2"
+        : :"r"(dst), "r"(src), "r"(num) : "memory");
+}
+
+static void bench_expand(int n)
+{
+    long iters = BENCH_BYTES / n;
+    bench_sample s;
+
+    for (int i = 0; i < n; i++) {
+        src[i] = i * 7;
+    }
+
+    bench_start(&s);
+    for (long i = 0; i < iters; i++) {
+        custom_expand((uintptr_t)src, (uintptr_t)dst, n);
+    }
+    bench_stop(&s);
+
+    for (int i = 0; i < n; i++) {
+        crt_assert(dst[2 * i] == (src[i] & 0xf));
+        crt_assert(dst[2 * i + 1] == (src[i] >> 4));
+    }
+
+    bench_report("insn-expand", "split", n, iters, &s);
+}
+
+int main(void)
+{
+    for (int n = 16; n <= BENCH_MAX_BYTES; n <<= 2) {
+        bench_expand(n);
+    }
+    return 0;
+}
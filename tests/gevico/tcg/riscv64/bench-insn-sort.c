@@ -0,0 +1,55 @@
+#include "bench.h"
+
+#define BENCH_MAX_ELEMS (1 << 20)
+
+static int32_t bench_buf[BENCH_MAX_ELEMS];
+
+static void custom_sort(uintptr_t addr, int array_num, int sort_num)
+{
+    asm volatile (
+       ".insn r 0x7b, 6, 22, %0, %1, %2"
+        : :"r"(sort_num), "r"(addr), "r"(array_num) : "memory");
+}
+
+static void fill_random(int32_t *arr, int n, uint32_t seed)
+{
+    for (int i = 0; i < n; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        arr[i] = (int32_t)seed;
+    }
+}
+
+static void check_sorted(int32_t *arr, int n)
+{
+    for (int i = 1; i < n; i++) {
+        crt_assert(arr[i - 1] <= arr[i]);
+    }
+}
+
+static void bench_sort(int n)
+{
+    bench_sample s;
+
+    fill_random(bench_buf, n, n);
+    bench_start(&s);
+    custom_sort((uintptr_t)bench_buf, n, n);
+    bench_stop(&s);
+    check_sorted(bench_buf, n);
+
+    bench_report("insn-sort", "random", n, 1, &s);
+
+    /* Already sorted input: the helper should not touch memory */
+    bench_start(&s);
+    custom_sort((uintptr_t)bench_buf, n, n);
+    bench_stop(&s);
+
+    bench_report("insn-sort", "sorted", n, 1, &s);
+}
+
+int main(void)
+{
+    for (int n = 16; n <= BENCH_MAX_ELEMS; n <<= 2) {
+        bench_sort(n);
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include "bench.h"
+
+#define BENCH_MAX_ELEMS (1 << 18)
+
+static uint8_t bench_src[BENCH_MAX_ELEMS * 4];
+static uint8_t bench_dst[BENCH_MAX_ELEMS * 4];
+static float bench_fx[BENCH_MAX_ELEMS];
+static float bench_fy[BENCH_MAX_ELEMS];
+
+static void rvv_memcpy(uint8_t *dst, const uint8_t *src, long n)
+{
+    long vl;
+
+    while (n > 0) {
+        asm volatile("vsetvli %0, %1, e8, m8, ta, ma\n\t"
+                     "vle8.v v0, (%2)\n\t"
+                     "vse8.v v0, (%3)"
+                     : "=&r"(vl) : "r"(n), "r"(src), "r"(dst) : "memory");
+        src += vl;
+        dst += vl;
+        n -= vl;
+    }
+}
+
+/* y = a * x + y on 32-bit integers, vmacc.vx */
+static void rvv_isaxpy(int32_t a, const int32_t *x, int32_t *y, long n)
+{
+    long vl;
+
+    while (n > 0) {
+        asm volatile("vsetvli %0, %1, e32, m8, ta, ma\n\t"
+                     "vle32.v v0, (%2)\n\t"
+                     "vle32.v v8, (%3)\n\t"
+                     "vmacc.vx v8, %4, v0\n\t"
+                     "vse32.v v8, (%3)"
+                     : "=&r"(vl) : "r"(n), "r"(x), "r"(y), "r"(a) : "memory");
+        x += vl;
+        y += vl;
+        n -= vl;
+    }
+}
+
+/* y = a * x + y on floats, vfmacc.vf */
+static void rvv_fsaxpy(float a, const float *x, float *y, long n)
+{
+    long vl;
+
+    while (n > 0) {
+        asm volatile("vsetvli %0, %1, e32, m8, ta, ma\n\t"
+                     "vle32.v v0, (%2)\n\t"
+                     "vle32.v v8, (%3)\n\t"
+                     "vfmacc.vf v8, %4, v0\n\t"
+                     "vse32.v v8, (%3)"
+                     : "=&r"(vl) : "r"(n), "r"(x), "r"(y), "f"(a) : "memory");
+        x += vl;
+        y += vl;
+        n -= vl;
+    }
+}
+
+/* 16-bit + 16-bit -> 32-bit, vwadd.vv */
+static void rvv_widen_add(const int16_t *a, const int16_t *b, int32_t *d,
+                          long n)
+{
+    long vl;
+
+    while (n > 0) {
+        asm volatile("vsetvli %0, %1, e16, m4, ta, ma\n\t"
+                     "vle16.v v0, (%2)\n\t"
+                     "vle16.v v4, (%3)\n\t"
+                     "vwadd.vv v8, v0, v4\n\t"
+                     "vse32.v v8, (%4)"
+                     : "=&r"(vl) : "r"(n), "r"(a), "r"(b), "r"(d)
+                     : "memory");
+        a += vl;
+        b += vl;
+        d += vl;
+        n -= vl;
+    }
+}
+
+static void fill(int n)
+{
+    for (int i = 0; i < n * 4; i++) {
+        bench_src[i] = i * 31;
+    }
+    for (int i = 0; i < n; i++) {
+        bench_fx[i] = i;
+        bench_fy[i] = 1.0f;
+    }
+}
+
+static void bench_rvv(int n)
+{
+    bench_sample s;
+    int32_t *x = (int32_t *)bench_src;
+    int32_t *y = (int32_t *)bench_dst;
+    int16_t *h = (int16_t *)bench_src;
+
+    fill(n);
+
+    bench_start(&s);
+    rvv_memcpy(bench_dst, bench_src, n * 4);
+    bench_stop(&s);
+    for (int i = 0; i < n * 4; i++) {
+        crt_assert(bench_dst[i] == bench_src[i]);
+    }
+    bench_report("rvv", "memcpy", n * 4, 1, &s);
+
+    bench_start(&s);
+    rvv_isaxpy(3, x, y, n);
+    bench_stop(&s);
+    for (int i = 0; i < n; i++) {
+        crt_assert((uint32_t)y[i] == (uint32_t)x[i] * 4);
+    }
+    bench_report("rvv", "saxpy-int", n, 1, &s);
+
+    bench_start(&s);
+    rvv_fsaxpy(2.0f, bench_fx, bench_fy, n);
+    bench_stop(&s);
+    for (int i = 0; i < n; i++) {
+        crt_assert(bench_fy[i] == 2.0f * i + 1.0f);
+    }
+    bench_report("rvv", "saxpy-fp", n, 1, &s);
+
+    bench_start(&s);
+    rvv_widen_add(h, h + n, y, n);
+    bench_stop(&s);
+    for (int i = 0; i < n; i++) {
+        crt_assert(y[i] == (int32_t)h[i] + h[n + i]);
+    }
+    bench_report("rvv", "widen-add", n, 1, &s);
+}
+
+int main(void)
+{
+    for (int n = 64; n <= BENCH_MAX_ELEMS; n <<= 2) {
+        bench_rvv(n);
+    }
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include "bench.h"
+
+#define G233_SPI0_BASE  0x10018000
+#define G233_XIP0_BASE  0x20000000
+
+#define REG32(addr) (*(volatile uint32_t *)((uintptr_t)(G233_SPI0_BASE + (addr))))
+
+#define SPI_CR1     0x00
+#define SPI_SR      0x08
+#define SPI_DR      0x0C
+#define SPI_CSCTRL  0x10
+#define SPI_FCR     0x14
+
+#define SPI_CR1_SPE     (1 << 6)
+#define SPI_CR1_MSTR    (1 << 2)
+#define SPI_SR_RXNE     (1 << 0)
+#define SPI_FCR_FIFOEN  (1 << 0)
+#define SPI_FCR_BURST4  (3 << 16)
+
+#define SPI_CS_ENABLE   (1 << 0)
+#define SPI_CS_ACTIVE   (1 << 4)
+
+#define W25X16_WRITE_ENABLE 0x06
+#define W25X16_PAGE_PROGRAM 0x02
+#define W25X16_SECTOR_ERASE 0x20
+#define W25X16_READ_DATA    0x03
+#define W25X16_FAST_READ    0x0B
+
+#define FLASH_PAGE_SIZE     256
+#define FLASH_SECTOR_SIZE   4096
+
+#define BENCH_MAX_BYTES (1 << 20)
+
+static uint8_t buf[BENCH_MAX_BYTES];
+
+static uint32_t spi_xfer(uint32_t word)
+{
+    REG32(SPI_DR) = word;
+    while (!(REG32(SPI_SR) & SPI_SR_RXNE)) {
+    }
+    return REG32(SPI_DR);
+}
+
+/* What the flash holds at @addr once programmed */
+static uint8_t pattern(uint32_t addr)
+{
+    return addr * 7 + (addr >> 8);
+}
+
+/* Command byte plus 24-bit address, packed for a four-byte burst */
+static uint32_t cmd_addr(uint8_t cmd, uint32_t addr)
+{
+    return cmd | (addr >> 16 & 0xff) << 8 | (addr >> 8 & 0xff) << 16 |
+           (addr & 0xff) << 24;
+}
+
+static void write_enable(void)
+{
+    REG32(SPI_FCR) = 0;
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE | SPI_CS_ACTIVE;
+    spi_xfer(W25X16_WRITE_ENABLE);
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE;
+}
+
+/*
+ * Erase and program the first @n bytes with pattern(), so that every
+ * read variant has something to get wrong.  Not timed.
+ */
+static void program_flash(int n)
+{
+    for (uint32_t addr = 0; addr < n; addr += FLASH_SECTOR_SIZE) {
+        write_enable();
+        REG32(SPI_FCR) = SPI_FCR_FIFOEN | SPI_FCR_BURST4;
+        REG32(SPI_CSCTRL) = SPI_CS_ENABLE | SPI_CS_ACTIVE;
+        spi_xfer(cmd_addr(W25X16_SECTOR_ERASE, addr));
+        REG32(SPI_CSCTRL) = SPI_CS_ENABLE;
+    }
+    for (uint32_t addr = 0; addr < n; addr += FLASH_PAGE_SIZE) {
+        write_enable();
+        REG32(SPI_FCR) = SPI_FCR_FIFOEN | SPI_FCR_BURST4;
+        REG32(SPI_CSCTRL) = SPI_CS_ENABLE | SPI_CS_ACTIVE;
+        spi_xfer(cmd_addr(W25X16_PAGE_PROGRAM, addr));
+        for (uint32_t i = 0; i < FLASH_PAGE_SIZE; i += 4) {
+            uint32_t w = 0;
+
+            for (int j = 0; j < 4; j++) {
+                w |= (uint32_t)pattern(addr + i + j) << (8 * j);
+            }
+            spi_xfer(w);
+        }
+        REG32(SPI_CSCTRL) = SPI_CS_ENABLE;
+    }
+    REG32(SPI_FCR) = 0;
+}
+
+static void check_buf(int n)
+{
+    for (int i = 0; i < n; i++) {
+        crt_assert(buf[i] == pattern(i));
+    }
+}
+
+/* READ (0x03), one byte per DR access */
+static void read_bytes(int n)
+{
+    REG32(SPI_FCR) = 0;
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE | SPI_CS_ACTIVE;
+    spi_xfer(W25X16_READ_DATA);
+    spi_xfer(0);
+    spi_xfer(0);
+    spi_xfer(0);
+    for (int i = 0; i < n; i++) {
+        buf[i] = spi_xfer(0);
+    }
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE;
+}
+
+/* FAST_READ (0x0B) through the FIFO, four bytes per DR access */
+static void read_burst(int n)
+{
+    uint32_t w;
+
+    REG32(SPI_FCR) = SPI_FCR_FIFOEN | SPI_FCR_BURST4;
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE | SPI_CS_ACTIVE;
+    spi_xfer(W25X16_FAST_READ);     /* command + address 0 */
+    w = spi_xfer(0);                /* dummy + data 0..2 */
+    buf[0] = w >> 8;
+    buf[1] = w >> 16;
+    buf[2] = w >> 24;
+    for (int i = 3; i < n; i += 4) {
+        w = spi_xfer(0);
+        for (int j = 0; j < 4 && i + j < n; j++) {
+            buf[i + j] = w >> (8 * j);
+        }
+    }
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE;
+    REG32(SPI_FCR) = 0;
+}
+
+static void read_xip(int n)
+{
+    memcpy(buf, (const void *)(uintptr_t)G233_XIP0_BASE, n);
+}
+
+static void bench_flash(int n)
+{
+    static const struct {
+        const char *name;
+        void (*fn)(int n);
+    } variants[] = {
+        { "read", read_bytes },
+        { "fast-read-burst4", read_burst },
+        { "xip", read_xip },
+    };
+    for (int v = 0; v < 3; v++) {
+        bench_sample s;
+
+        memset(buf, 0, n);
+        bench_start(&s);
+        variants[v].fn(n);
+        bench_stop(&s);
+
+        check_buf(n);
+        bench_report("spi-flash", variants[v].name, n, 1, &s);
+    }
+}
+
+int main(void)
+{
+    REG32(SPI_CR1) = SPI_CR1_MSTR | SPI_CR1_SPE;
+    program_flash(BENCH_MAX_BYTES);
+
+    for (int n = 4096; n <= BENCH_MAX_BYTES; n <<= 4) {
+        bench_flash(n);
+    }
+    return 0;
+}
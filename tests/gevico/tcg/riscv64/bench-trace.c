@@ -0,0 +1,70 @@
+/*
+ * Hot trace benchmark
+ *
+ * A tight integer loop whose body is split over several TBs by forward
+ * branches to rarely taken paths and a forward jump, the way compiled
+ * code with unlikely() error handling looks.  This is the baseline any
+ * cross-TB optimization of hot loops has to beat.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "bench.h"
+
+#define BENCH_ELEMS     4096
+#define BENCH_OPS       (1 << 22)   /* element updates per run */
+
+uint64_t trace_kernel(const uint64_t *p, const uint64_t *end);
+
+asm(".balign 4\n"
+    "trace_kernel:\n"
+    "    mv t0, zero\n"
+    "1:  ld t2, 0(a0)\n"
+    "    andi t3, t2, 63\n"
+    "    beqz t3, 5f\n"
+    "2:  add t0, t0, t2\n"
+    "    slli t4, t2, 1\n"
+    "    xor t0, t0, t4\n"
+    "    andi t3, t2, 0x7c0\n"
+    "    beqz t3, 6f\n"
+    "3:  srli t4, t2, 7\n"
+    "    add t0, t0, t4\n"
+    "    j 4f\n"
+    "    mul t0, t0, t2\n"
+    "4:  addi a0, a0, 8\n"
+    "    bltu a0, a1, 1b\n"
+    "    mv a0, t0\n"
+    "    ret\n"
+    "5:  sub t0, t0, t2\n"
+    "    j 2b\n"
+    "6:  not t0, t0\n"
+    "    j 3b\n");
+
+static uint64_t data[BENCH_ELEMS];
+
+int main(void)
+{
+    long iters = BENCH_OPS / BENCH_ELEMS;
+    uint64_t x = 0x9e3779b97f4a7c15ull, first = 0;
+    bench_sample s;
+
+    /* A few percent of the elements take a rare path */
+    for (int i = 0; i < BENCH_ELEMS; i++) {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+        data[i] = x >> 7;
+    }
+
+    bench_start(&s);
+    for (long i = 0; i < iters; i++) {
+        uint64_t sum = trace_kernel(data, data + BENCH_ELEMS);
+
+        if (i == 0) {
+            first = sum;
+        }
+        crt_assert(sum == first);
+    }
+    bench_stop(&s);
+
+    bench_report("trace", "loop", BENCH_ELEMS, iters, &s);
+    return 0;
+}
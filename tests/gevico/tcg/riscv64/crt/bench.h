@@ -0,0 +1,85 @@
+/*
+ * Gevico TCG system benchmark helpers
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef GEVICO_BENCH_H
+#define GEVICO_BENCH_H
+
+#include "crt.h"
+
+/*
+ * Each measurement is printed as one JSON object on its own line,
+ * starting with {"bench": so the host side can pick results out of
+ * the console log.
+ */
+
+#define SEMIHOST_SYS_ELAPSED    0x30
+
+typedef struct {
+    uint64_t cycles;
+    uint64_t instret;
+    uint64_t host_ns;
+} bench_sample;
+
+static inline uint64_t bench_rdcycle(void)
+{
+    uint64_t v;
+    asm volatile("rdcycle %0" : "=r"(v));
+    return v;
+}
+
+static inline uint64_t bench_rdinstret(void)
+{
+    uint64_t v;
+    asm volatile("rdinstret %0" : "=r"(v));
+    return v;
+}
+
+/* Host wall-clock nanoseconds since QEMU started (semihosting) */
+static inline uint64_t bench_host_ns(void)
+{
+    static uint64_t block[2];
+    register uintptr_t a0 asm("a0") = SEMIHOST_SYS_ELAPSED;
+    register uintptr_t a1 asm("a1") = (uintptr_t)block;
+
+    asm volatile(".option push\n"
+                 ".option norvc\n"
+                 ".balign 16\n"
+                 "slli zero, zero, 0x1f\n"
+                 "ebreak\n"
+                 "srai zero, zero, 0x7\n"
+                 ".option pop\n"
+                 : "+r"(a0) : "r"(a1) : "memory");
+    return block[0];
+}
+
+static inline void bench_start(bench_sample *s)
+{
+    s->host_ns = bench_host_ns();
+    s->instret = bench_rdinstret();
+    s->cycles = bench_rdcycle();
+}
+
+static inline void bench_stop(bench_sample *s)
+{
+    s->cycles = bench_rdcycle() - s->cycles;
+    s->instret = bench_rdinstret() - s->instret;
+    s->host_ns = bench_host_ns() - s->host_ns;
+}
+
+static inline void bench_report(const char *bench, const char *variant,
+                                long size, long iters, const bench_sample *s)
+{
+    uint64_t us = s->host_ns / 1000;
+    uint64_t ips = us ? s->instret * 1000000 / us : 0;
+
+    printf("{\"bench\": \"%s\", \"variant\": \"%s\", \"size\": %ld, "
+           "\"iters\": %ld, \"cycles\": %ld, \"instret\": %ld, "
+           "\"host_ns\": %ld, \"ips\": %ld}\n",
+           bench, variant, size, iters, (long)s->cycles, (long)s->instret,
+           (long)s->host_ns, (long)ips);
+}
+
+#endif /* GEVICO_BENCH_H */
@@ -0,0 +1,123 @@
+/*
+ * Test CSR accesses that the translator expands inline
+ *
+ * Each check keeps the CSR access and the instructions that depend on it
+ * in one asm block, so they land in the same TB.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "crt.h"
+
+#define MSTATUS_FS      (3ul << 13)
+#define MSTATUS_FS_INIT (1ul << 13)
+
+#define FRM_RDN         2
+#define FRM_RUP         3
+
+static void test_frm_dynamic_rounding(void)
+{
+    uint32_t down, up;
+    float one = 1.0f, three = 3.0f;
+
+    printf("Testing frm write followed by dynamic rounding...\n");
+    asm volatile("fsrmi %2\n\t"
+                 "fdiv.s ft0, %4, %5\n\t"
+                 "fmv.x.w %0, ft0\n\t"
+                 "fsrmi %3\n\t"
+                 "fdiv.s ft0, %4, %5\n\t"
+                 "fmv.x.w %1, ft0\n\t"
+                 "fsrmi 0"
+                 : "=&r"(down), "=&r"(up)
+                 : "i"(FRM_RDN), "i"(FRM_RUP), "f"(one), "f"(three)
+                 : "ft0");
+    crt_assert(up == down + 1);
+}
+
+static void test_frm_swap(void)
+{
+    unsigned long old, now;
+
+    printf("Testing frm swap and read-back...\n");
+    asm volatile("fsrmi %2\n\t"
+                 "fsrm %0, %3\n\t"
+                 "frrm %1\n\t"
+                 "fsrmi 0"
+                 : "=&r"(old), "=&r"(now)
+                 : "i"(FRM_RUP), "r"(0xfful));
+    crt_assert(old == FRM_RUP);
+    crt_assert(now == 7);
+}
+
+static void test_frm_dirties_fs(void)
+{
+    unsigned long mstatus;
+
+    printf("Testing frm write marks mstatus.FS dirty...\n");
+    asm volatile("csrc mstatus, %1\n\t"
+                 "csrs mstatus, %2\n\t"
+                 "fsrmi 0\n\t"
+                 "csrr %0, mstatus"
+                 : "=&r"(mstatus)
+                 : "r"(MSTATUS_FS), "r"(MSTATUS_FS_INIT));
+    crt_assert((mstatus & MSTATUS_FS) == MSTATUS_FS);
+}
+
+static void test_scratch(void)
+{
+    unsigned long a = 0x123456789abcdef0ul, b = 0x0f0f00000000fffful;
+    unsigned long r0, r1, r2, r3;
+
+    printf("Testing mscratch/sscratch read-modify-write...\n");
+    /* rd == rs1, so the old value must not clobber the mask early */
+    asm volatile("csrw mscratch, %4\n\t"
+                 "mv %0, %5\n\t"
+                 "csrrs %0, mscratch, %0\n\t"
+                 "csrr %1, mscratch\n\t"
+                 "mv %2, %5\n\t"
+                 "csrrc %2, mscratch, %2\n\t"
+                 "csrrwi zero, mscratch, 0x15\n\t"
+                 "csrrsi zero, mscratch, 0x0a\n\t"
+                 "csrr %3, mscratch"
+                 : "=&r"(r0), "=&r"(r1), "=&r"(r2), "=&r"(r3)
+                 : "r"(a), "r"(b));
+    crt_assert(r0 == a);
+    crt_assert(r1 == (a | b));
+    crt_assert(r2 == (a | b));
+    crt_assert(r3 == 0x1f);
+
+    asm volatile("csrw sscratch, %2\n\t"
+                 "csrrw %0, sscratch, %3\n\t"
+                 "csrr %1, sscratch"
+                 : "=&r"(r0), "=&r"(r1)
+                 : "r"(a), "r"(b));
+    crt_assert(r0 == a);
+    crt_assert(r1 == b);
+}
+
+static void test_vector_csrs(void)
+{
+    unsigned long vlmax, vl, vlenb;
+
+    printf("Testing vl and vlenb reads...\n");
+    asm volatile("vsetvli %0, zero, e8, m1, ta, ma\n\t"
+                 "csrr %1, vlenb\n\t"
+                 "vsetvli zero, %3, e8, m1, ta, ma\n\t"
+                 "csrr %2, vl"
+                 : "=&r"(vlmax), "=&r"(vlenb), "=&r"(vl)
+                 : "r"(3ul));
+    crt_assert(vlenb == vlmax);
+    crt_assert(vl == 3);
+}
+
+int main(void)
+{
+    test_frm_dynamic_rounding();
+    test_frm_swap();
+    test_frm_dirties_fs();
+    test_scratch();
+    test_vector_csrs();
+
+    printf("All tests passed!\n");
+    return 0;
+}
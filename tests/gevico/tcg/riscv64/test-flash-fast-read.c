@@ -0,0 +1,157 @@
+/*
+ * Test G233 flash fast, quad and continuous read modes
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "crt.h"
+
+#define G233_SPI0_BASE 0x10018000
+
+/* Memory-mapped register access */
+#define REG32(addr) (*(volatile uint32_t *)((uintptr_t)(G233_SPI0_BASE + (addr))))
+
+/* G233 SPI register offsets */
+#define SPI_CR1     0x00
+#define SPI_SR      0x08
+#define SPI_DR      0x0C
+#define SPI_CSCTRL  0x10
+#define SPI_FCR     0x14
+
+#define SPI_CR1_SPE     (1 << 6)   /* SPI Enable */
+#define SPI_CR1_MSTR    (1 << 2)   /* Master mode */
+#define SPI_SR_RXNE     (1 << 0)   /* Receive buffer not empty */
+
+#define SPI_FCR_FIFOEN      (1 << 0)
+#define SPI_FCR_BURST(n)    (((n) - 1) << 16)
+
+#define SPI_CS_ENABLE   (1 << 0)   /* Enable CS0 */
+#define SPI_CS_ACTIVE   (1 << 4)   /* Activate CS0 */
+
+#define W25X16_WRITE_ENABLE    0x06
+#define W25X16_PAGE_PROGRAM    0x02
+#define W25X16_SECTOR_ERASE    0x20
+#define W25X16_FAST_READ       0x0B
+#define W25X16_QUAD_IO_READ    0xEB
+#define W25X16_JEDEC_ID        0x9F
+
+#define TEST_ADDR   0x3000
+#define TEST_LEN    16
+
+static void cs_assert(void)
+{
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE | SPI_CS_ACTIVE;
+}
+
+static void cs_deassert(void)
+{
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE;
+}
+
+/* One DR access; moves 1 or 4 bytes depending on FCR burst size. */
+static uint32_t spi_xfer(uint32_t word)
+{
+    REG32(SPI_DR) = word;
+    while (!(REG32(SPI_SR) & SPI_SR_RXNE)) {
+    }
+    return REG32(SPI_DR);
+}
+
+static void flash_cmd_addr(uint8_t cmd, uint32_t addr)
+{
+    spi_xfer(cmd);
+    spi_xfer((addr >> 16) & 0xFF);
+    spi_xfer((addr >> 8) & 0xFF);
+    spi_xfer(addr & 0xFF);
+}
+
+static void flash_prepare(void)
+{
+    REG32(SPI_FCR) = 0;
+
+    cs_assert();
+    spi_xfer(W25X16_WRITE_ENABLE);
+    cs_deassert();
+    cs_assert();
+    flash_cmd_addr(W25X16_SECTOR_ERASE, TEST_ADDR);
+    cs_deassert();
+
+    cs_assert();
+    spi_xfer(W25X16_WRITE_ENABLE);
+    cs_deassert();
+    cs_assert();
+    flash_cmd_addr(W25X16_PAGE_PROGRAM, TEST_ADDR);
+    for (int i = 0; i < TEST_LEN; i++) {
+        spi_xfer(0xA0 + i);
+    }
+    cs_deassert();
+}
+
+/* Command and 3-byte address little-endian packed into one burst. */
+static uint32_t cmd_word(uint8_t cmd, uint32_t addr)
+{
+    return cmd | ((addr >> 16) & 0xFF) << 8 | ((addr >> 8) & 0xFF) << 16 |
+           (addr & 0xFF) << 24;
+}
+
+static void test_fast_read(void)
+{
+    uint32_t w;
+
+    printf("Testing FAST_READ with 4-byte bursts...\n");
+
+    REG32(SPI_FCR) = SPI_FCR_FIFOEN | SPI_FCR_BURST(4);
+    cs_assert();
+    spi_xfer(cmd_word(W25X16_FAST_READ, TEST_ADDR));
+    w = spi_xfer(0);            /* dummy + data 0..2 */
+    crt_assert((w >> 8) == 0xA2A1A0);
+    w = spi_xfer(0);            /* data 3..6 */
+    crt_assert(w == 0xA6A5A4A3);
+    cs_deassert();
+}
+
+static void test_quad_continuous(void)
+{
+    uint32_t w;
+
+    printf("Testing Quad I/O read in continuous mode...\n");
+
+    REG32(SPI_FCR) = SPI_FCR_FIFOEN | SPI_FCR_BURST(4);
+
+    /* Mode byte 0x20 enters continuous read mode */
+    cs_assert();
+    spi_xfer(cmd_word(W25X16_QUAD_IO_READ, TEST_ADDR));
+    w = spi_xfer(0x00000020);   /* mode + 2 dummy + data 0 */
+    crt_assert((w >> 24) == 0xA0);
+    cs_deassert();
+
+    /* No command byte this time; mode 0xFF leaves continuous mode */
+    cs_assert();
+    spi_xfer(0xFF000000 | ((TEST_ADDR + 4) & 0xFF) << 16 |
+             ((TEST_ADDR >> 8) & 0xFF) << 8 | ((TEST_ADDR >> 16) & 0xFF));
+    w = spi_xfer(0);            /* 2 dummy + data 4..5 */
+    crt_assert((w >> 16) == 0xA5A4);
+    cs_deassert();
+
+    /* Back to normal command decoding */
+    cs_assert();
+    w = spi_xfer(W25X16_JEDEC_ID);
+    crt_assert((w >> 8) == 0x1530EF);
+    cs_deassert();
+}
+
+int main(void)
+{
+    printf("G233 Flash Fast Read Test\n");
+    printf("============================\n");
+
+    REG32(SPI_CR1) = SPI_CR1_MSTR | SPI_CR1_SPE;
+
+    flash_prepare();
+    test_fast_read();
+    test_quad_continuous();
+
+    REG32(SPI_FCR) = 0;
+    printf("All tests passed!\n");
+    return 0;
+}
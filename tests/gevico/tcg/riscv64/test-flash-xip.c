@@ -0,0 +1,128 @@
+/*
+ * Test G233 flash execute-in-place window
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "crt.h"
+
+#define G233_SPI0_BASE  0x10018000
+#define G233_XIP0_BASE  0x20000000
+
+/* Memory-mapped register access */
+#define REG32(addr) (*(volatile uint32_t *)((uintptr_t)(G233_SPI0_BASE + (addr))))
+#define XIP8(off)   (*(volatile uint8_t *)((uintptr_t)(G233_XIP0_BASE + (off))))
+
+/* G233 SPI register offsets */
+#define SPI_CR1     0x00
+#define SPI_SR      0x08
+#define SPI_DR      0x0C
+#define SPI_CSCTRL  0x10
+
+#define SPI_CR1_SPE     (1 << 6)   /* SPI Enable */
+#define SPI_CR1_MSTR    (1 << 2)   /* Master mode */
+#define SPI_SR_RXNE     (1 << 0)   /* Receive buffer not empty */
+
+#define SPI_CS_ENABLE   (1 << 0)   /* Enable CS0 */
+#define SPI_CS_ACTIVE   (1 << 4)   /* Activate CS0 */
+
+#define W25X16_WRITE_ENABLE    0x06
+#define W25X16_PAGE_PROGRAM    0x02
+#define W25X16_SECTOR_ERASE    0x20
+
+#define TEST_DATA_ADDR  0x1000
+#define TEST_CODE_ADDR  0x2000
+
+static uint8_t spi_transfer(uint8_t data)
+{
+    REG32(SPI_DR) = data;
+    while (!(REG32(SPI_SR) & SPI_SR_RXNE)) {
+    }
+    return REG32(SPI_DR) & 0xFF;
+}
+
+static void flash_cmd_addr(uint8_t cmd, uint32_t addr)
+{
+    spi_transfer(cmd);
+    spi_transfer((addr >> 16) & 0xFF);
+    spi_transfer((addr >> 8) & 0xFF);
+    spi_transfer(addr & 0xFF);
+}
+
+static void flash_write_enable(void)
+{
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE | SPI_CS_ACTIVE;
+    spi_transfer(W25X16_WRITE_ENABLE);
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE;
+}
+
+static void flash_erase(uint32_t addr)
+{
+    flash_write_enable();
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE | SPI_CS_ACTIVE;
+    flash_cmd_addr(W25X16_SECTOR_ERASE, addr);
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE;
+}
+
+static void flash_program(uint32_t addr, const uint8_t *buf, int len)
+{
+    flash_write_enable();
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE | SPI_CS_ACTIVE;
+    flash_cmd_addr(W25X16_PAGE_PROGRAM, addr);
+    for (int i = 0; i < len; i++) {
+        spi_transfer(buf[i]);
+    }
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE;
+}
+
+/* Data programmed over SPI is visible through the window. */
+static void test_xip_read(void)
+{
+    uint8_t buf[256];
+
+    printf("Testing XIP data read...\n");
+
+    for (int i = 0; i < 256; i++) {
+        buf[i] = i ^ 0x5A;
+    }
+    flash_erase(TEST_DATA_ADDR);
+    crt_assert(XIP8(TEST_DATA_ADDR) == 0xFF);
+
+    flash_program(TEST_DATA_ADDR, buf, sizeof(buf));
+    for (int i = 0; i < 256; i++) {
+        crt_assert(XIP8(TEST_DATA_ADDR + i) == buf[i]);
+    }
+}
+
+/* Code programmed over SPI can be called in place. */
+static void test_xip_exec(void)
+{
+    static const uint32_t code[] = {
+        0x02a00513,     /* li a0, 42 */
+        0x00008067,     /* ret */
+    };
+    int (*fn)(void) = (int (*)(void))(uintptr_t)(G233_XIP0_BASE +
+                                                TEST_CODE_ADDR);
+
+    printf("Testing XIP execution...\n");
+
+    flash_erase(TEST_CODE_ADDR);
+    flash_program(TEST_CODE_ADDR, (const uint8_t *)code, sizeof(code));
+    asm volatile("fence.i" ::: "memory");
+
+    crt_assert(fn() == 42);
+}
+
+int main(void)
+{
+    printf("G233 Flash XIP Test\n");
+    printf("============================\n");
+
+    REG32(SPI_CR1) = SPI_CR1_MSTR | SPI_CR1_SPE;
+
+    test_xip_read();
+    test_xip_exec();
+
+    printf("All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * Test scalar FP conversions and min/max with and without the host FPU
+ * fast path
+ *
+ * The fast path is only taken once fflags.NX is set and the rounding mode
+ * is RNE (or RTZ for float-to-integer), so every case is run twice: once
+ * with fflags clear, once with NX already set.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "crt.h"
+
+#define FFLAGS_NX   0x01
+#define FFLAGS_UF   0x02
+#define FFLAGS_OF   0x04
+#define FFLAGS_NV   0x10
+
+static inline void set_fflags(unsigned long v)
+{
+    asm volatile("csrw fflags, %0" : : "r"(v));
+}
+
+static inline unsigned long get_fflags(void)
+{
+    unsigned long v;
+
+    asm volatile("csrr %0, fflags" : "=r"(v));
+    return v;
+}
+
+static inline uint64_t bits_d(double d)
+{
+    union { double d; uint64_t u; } u = { .d = d };
+    return u.u;
+}
+
+static inline uint32_t bits_s(float f)
+{
+    union { float f; uint32_t u; } u = { .f = f };
+    return u.u;
+}
+
+static void test_to_int(unsigned long nx)
+{
+    long l;
+    unsigned long ul;
+
+    set_fflags(nx);
+    asm volatile("fcvt.l.d %0, %1, rtz" : "=r"(l) : "f"(-2.75));
+    crt_assert(l == -2);
+    asm volatile("fcvt.l.d %0, %1, rne" : "=r"(l) : "f"(2.5));
+    crt_assert(l == 2);
+    asm volatile("fcvt.w.s %0, %1, rne" : "=r"(l) : "f"(-3.5f));
+    crt_assert(l == -4);
+    asm volatile("fcvt.wu.d %0, %1, rtz" : "=r"(ul) : "f"(-0.75));
+    crt_assert(ul == 0);
+    asm volatile("fcvt.wu.d %0, %1, rtz" : "=r"(ul) : "f"(4294967295.0));
+    crt_assert(ul == 0xfffffffffffffffful);
+    crt_assert((get_fflags() & FFLAGS_NV) == 0);
+    crt_assert((get_fflags() & FFLAGS_NX) == FFLAGS_NX);
+
+    /* Out of range saturates and raises NV */
+    set_fflags(nx);
+    asm volatile("fcvt.w.d %0, %1, rtz" : "=r"(l) : "f"(2147483648.0));
+    crt_assert(l == 0x7fffffff);
+    crt_assert(get_fflags() & FFLAGS_NV);
+
+    set_fflags(nx);
+    asm volatile("fcvt.lu.s %0, %1, rtz" : "=r"(ul) : "f"(-1.0f));
+    crt_assert(ul == 0);
+    crt_assert(get_fflags() & FFLAGS_NV);
+}
+
+static void test_from_int(unsigned long nx)
+{
+    float f;
+    double d;
+
+    set_fflags(nx);
+    asm volatile("fcvt.s.l %0, %1" : "=f"(f) : "r"(16777217l));
+    crt_assert(bits_s(f) == bits_s(16777216.0f));
+    asm volatile("fcvt.d.lu %0, %1" : "=f"(d) : "r"(~0ul));
+    crt_assert(bits_d(d) == bits_d(18446744073709551616.0));
+    asm volatile("fcvt.d.w %0, %1" : "=f"(d) : "r"(-7l));
+    crt_assert(d == -7.0);
+}
+
+static void test_narrow_widen(unsigned long nx)
+{
+    float f;
+    double d;
+
+    set_fflags(nx);
+    asm volatile("fcvt.s.d %0, %1" : "=f"(f) : "f"(1.0 / 3.0));
+    crt_assert(bits_s(f) == bits_s(1.0f / 3.0f));
+    asm volatile("fcvt.d.s %0, %1" : "=f"(d) : "f"(-0.0f));
+    crt_assert(bits_d(d) == bits_d(-0.0));
+
+    /* Overflow and tiny results still raise OF and UF */
+    set_fflags(nx);
+    asm volatile("fcvt.s.d %0, %1" : "=f"(f) : "f"(1e300));
+    crt_assert(get_fflags() & FFLAGS_OF);
+
+    set_fflags(nx);
+    asm volatile("fcvt.s.d %0, %1" : "=f"(f) : "f"(1e-40));
+    crt_assert(get_fflags() & FFLAGS_UF);
+}
+
+static void test_minmax(unsigned long nx)
+{
+    double d;
+    float f;
+
+    set_fflags(nx);
+    asm volatile("fmin.d %0, %1, %2" : "=f"(d) : "f"(0.0), "f"(-0.0));
+    crt_assert(bits_d(d) == bits_d(-0.0));
+    asm volatile("fmax.d %0, %1, %2" : "=f"(d) : "f"(-0.0), "f"(0.0));
+    crt_assert(bits_d(d) == bits_d(0.0));
+    asm volatile("fmax.s %0, %1, %2" : "=f"(f) : "f"(-1.0f), "f"(2.0f));
+    crt_assert(f == 2.0f);
+    asm volatile("fmin.s %0, %1, %2" : "=f"(f)
+                 : "f"(__builtin_nanf("")), "f"(2.0f));
+    crt_assert(f == 2.0f);
+    crt_assert(get_fflags() == nx);
+}
+
+int main(void)
+{
+    for (unsigned long nx = 0; nx <= FFLAGS_NX; nx += FFLAGS_NX) {
+        printf("Testing with fflags.NX=%ld...\n", (long)nx);
+        test_to_int(nx);
+        test_from_int(nx);
+        test_narrow_widen(nx);
+        test_minmax(nx);
+    }
+
+    set_fflags(0);
+    printf("All tests passed!\n");
+    return 0;
+}
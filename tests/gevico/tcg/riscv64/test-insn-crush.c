@@ -4,7 +4,7 @@ static void custom_crush(uintptr_t src, uintptr_t dst, int num)
 {
     asm volatile (
        ".insn r 0x7b, 6, 38, %0, %1, %2"
-        : :"r"(dst), "r"(src), "r"(num));
+        : :"r"(dst), "r"(src), "r"(num) : "memory");
 }
 
 void pack_low4bits(const uint8_t *src, size_t src_len, uint8_t *dst, size_t *dst_len)
@@ -40,6 +40,26 @@ void print_array(uint8_t arr[], int n) {
     }
     printf("\n");
 }
+
+/* Odd-length buffer spanning several 4K pages, unaligned on both sides. */
+static uint8_t big_src[3 * 4096 + 2];
+static uint8_t big_dst1[2 * 4096];
+static uint8_t big_dst2[2 * 4096];
+
+static void test_crush_large(void)
+{
+    size_t src_len = sizeof(big_src) - 1;
+    size_t dst_len;
+
+    for (size_t i = 0; i < src_len; i++) {
+        big_src[i + 1] = i * 7 + 3;
+    }
+    pack_low4bits(big_src + 1, src_len, big_dst1, &dst_len);
+    custom_crush((uintptr_t)(big_src + 1), (uintptr_t)(big_dst2 + 3),
+                 src_len);
+    compare(big_dst1, big_dst2 + 3, dst_len);
+}
+
 int main(void)
 {
     printf("Hello, RISC-V G233 Board\n");
@@ -53,5 +73,7 @@ int main(void)
     custom_crush((uintptr_t)src, (uintptr_t)dst2, src_len);
     compare(dst1, dst2, dst_len);
 
+    test_crush_large();
+
     return 0;
 }
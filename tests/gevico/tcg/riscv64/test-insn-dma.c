@@ -59,10 +59,28 @@ GEN_TEST_DMA_GRAIN(8, 8, 0)
 GEN_TEST_DMA_GRAIN(16, 16, 1)
 GEN_TEST_DMA_GRAIN(32, 32, 2)
 
+/* Source and destination both straddle a 4K page boundary. */
+static uint32_t page_buf[3 * 1024] __attribute__((aligned(4096)));
+
+static void test_dma_page_cross(void)
+{
+    uint32_t *A = &page_buf[1024 - 100];
+    uint32_t *D = &page_buf[2048 - 100];
+    uint32_t C[32 * 32];
+
+    for (int i = 0; i < 32 * 32; i++) {
+        A[i] = i * 3 + 1;
+    }
+    transpose(A, C, 32, 32);
+    custom_dma((uintptr_t)A, (uintptr_t)D, 2);
+    compare(C, D, 32, 32);
+}
+
 int main(void)
 {
     test_dma_grain_8x8();
     test_dma_grain_16x16();
     test_dma_grain_32x32();
+    test_dma_page_cross();
     return 0;
 }
@@ -0,0 +1,437 @@
+/*
+ * Test Sv39 page walks, page-walk cache and TLB invalidation
+ *
+ * Loads and stores run from M-mode with mstatus.MPRV set and MPP=S, so
+ * they are translated through satp while instruction fetch is not.
+ * The two-stage tests instead run guest functions in VS-mode (V=1),
+ * translated through the guest's satp and hgatp.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "crt.h"
+
+#define PAGE            4096
+#define NPAGES          8
+#define VA_BASE         0x40000000ul    /* VPN[2] = 1 */
+
+#define PTE_V           (1ul << 0)
+#define PTE_R           (1ul << 1)
+#define PTE_W           (1ul << 2)
+#define PTE_X           (1ul << 3)
+#define PTE_U           (1ul << 4)
+#define PTE_A           (1ul << 6)
+#define PTE_D           (1ul << 7)
+#define PTE_LEAF        (PTE_V | PTE_R | PTE_W | PTE_A | PTE_D)
+#define GPTE_LEAF       (PTE_LEAF | PTE_U)     /* G-stage leaves need U */
+
+#define MSTATUS_MPP     (3ul << 11)
+#define MSTATUS_MPP_S   (1ul << 11)
+#define MSTATUS_MPRV    (1ul << 17)
+#define SATP_SV39       (8ul << 60)
+#define SATP_ASID(n)    ((unsigned long)(n) << 44)
+#define HGATP_SV39X4    (8ul << 60)
+#define HGATP_VMID(n)   ((unsigned long)(n) << 44)
+#define CAUSE_VS_ECALL  10
+
+#define RAM_BASE        0x80000000ul    /* code, data and stack */
+#define GPA_WIN         0x100000000ul   /* guest-physical only */
+
+static uint64_t root[512] __attribute__((aligned(PAGE)));
+static uint64_t l1[512] __attribute__((aligned(PAGE)));
+static uint64_t l0a[512] __attribute__((aligned(PAGE)));
+static uint64_t l0b[512] __attribute__((aligned(PAGE)));
+static uint64_t data[2 * NPAGES][PAGE / 8] __attribute__((aligned(PAGE)));
+
+/*
+ * The guest maps RAM_BASE 1:1 and VA_BASE through a level-1 table at
+ * GPA_WIN (vroot) or GPA_WIN + PAGE (vroot2).  The G-stage maps RAM 1:1
+ * and those two guest-physical pages to vl1 and vl1b, or the other way
+ * round for the second VM (groot2).  Sv39x4 roots are 16 KiB.
+ */
+static uint64_t vroot[512] __attribute__((aligned(PAGE)));
+static uint64_t vroot2[512] __attribute__((aligned(PAGE)));
+static uint64_t vl1[512] __attribute__((aligned(PAGE)));
+static uint64_t vl1b[512] __attribute__((aligned(PAGE)));
+static uint64_t groot[2048] __attribute__((aligned(4 * PAGE)));
+static uint64_t groot2[2048] __attribute__((aligned(4 * PAGE)));
+static uint64_t gl1[512] __attribute__((aligned(PAGE)));
+static uint64_t gl1_2[512] __attribute__((aligned(PAGE)));
+static uint64_t gl0[512] __attribute__((aligned(PAGE)));
+static uint64_t gl0_2[512] __attribute__((aligned(PAGE)));
+
+static uint64_t pte(void *pa, uint64_t flags)
+{
+    return ((uintptr_t)pa >> 12) << 10 | flags;
+}
+
+static uint64_t mprv_ld(uintptr_t va)
+{
+    uint64_t val;
+
+    asm volatile("csrs mstatus, %2\n\t"
+                 "ld %0, 0(%1)\n\t"
+                 "csrc mstatus, %2"
+                 : "=&r"(val) : "r"(va), "r"(MSTATUS_MPRV) : "memory");
+    return val;
+}
+
+static void mprv_sd(uintptr_t va, uint64_t val)
+{
+    asm volatile("csrs mstatus, %2\n\t"
+                 "sd %0, 0(%1)\n\t"
+                 "csrc mstatus, %2"
+                 : : "r"(val), "r"(va), "r"(MSTATUS_MPRV) : "memory");
+}
+
+static void sfence_vma(void)
+{
+    asm volatile("sfence.vma" : : : "memory");
+}
+
+static void setup(void)
+{
+    /* S-mode accesses need a matching PMP entry: all memory, RWX NAPOT */
+    asm volatile("csrw pmpaddr0, %0" : : "r"(-1ul >> 10));
+    asm volatile("csrw pmpcfg0, %0" : : "r"(0x1ful));
+
+    for (int i = 0; i < 2 * NPAGES; i++) {
+        for (int j = 0; j < PAGE / 8; j++) {
+            data[i][j] = (uint64_t)i << 32 | j;
+        }
+    }
+    for (int i = 0; i < NPAGES; i++) {
+        l0a[i] = pte(data[i], PTE_LEAF);
+        l0b[i] = pte(data[NPAGES + i], PTE_LEAF);
+    }
+    l1[0] = pte(l0a, PTE_V);
+    root[VA_BASE >> 30] = pte(l1, PTE_V);
+
+    asm volatile("csrc mstatus, %0" : : "r"(MSTATUS_MPP));
+    asm volatile("csrs mstatus, %0" : : "r"(MSTATUS_MPP_S));
+    asm volatile("csrw satp, %0" : : "r"(SATP_SV39 | (uintptr_t)root >> 12));
+    sfence_vma();
+}
+
+static void check_pages(int first)
+{
+    for (int i = 0; i < NPAGES; i++) {
+        for (int j = 0; j < PAGE / 8; j += 97) {
+            uint64_t v = mprv_ld(VA_BASE + i * PAGE + j * 8);
+            crt_assert(v == ((uint64_t)(first + i) << 32 | j));
+        }
+    }
+}
+
+static void test_walk(void)
+{
+    printf("Testing Sv39 walks...\n");
+    /* Twice, so the second pass resumes walks from the cache */
+    check_pages(0);
+    check_pages(0);
+
+    mprv_sd(VA_BASE + 3 * PAGE + 8, 0x1234);
+    crt_assert(data[3][1] == 0x1234);
+    data[3][1] = (uint64_t)3 << 32 | 1;
+}
+
+static void test_nonleaf_update(void)
+{
+    printf("Testing non-leaf PTE update + sfence.vma...\n");
+    l1[0] = pte(l0b, PTE_V);
+    sfence_vma();
+    check_pages(NPAGES);
+
+    l1[0] = pte(l0a, PTE_V);
+    sfence_vma();
+    check_pages(0);
+}
+
+static void test_satp_switch(void)
+{
+    printf("Testing satp switch...\n");
+    /* Same VA through a second root, reached only via the new satp */
+    static uint64_t root2[512] __attribute__((aligned(PAGE)));
+    static uint64_t l1b[512] __attribute__((aligned(PAGE)));
+
+    l1b[0] = pte(l0b, PTE_V);
+    root2[VA_BASE >> 30] = pte(l1b, PTE_V);
+    asm volatile("csrw satp, %0" : : "r"(SATP_SV39 | (uintptr_t)root2 >> 12));
+    check_pages(NPAGES);
+
+    asm volatile("csrw satp, %0" : : "r"(SATP_SV39 | (uintptr_t)root >> 12));
+    check_pages(0);
+}
+
+static void test_sfence_scoped(void)
+{
+    uintptr_t va = VA_BASE + 2 * PAGE;
+
+    printf("Testing address and ASID scoped sfence.vma...\n");
+    asm volatile("csrw satp, %0"
+                 : : "r"(SATP_SV39 | SATP_ASID(1) | (uintptr_t)root >> 12));
+    check_pages(0);
+
+    /* Only the named page is refetched; its neighbour stays correct */
+    l0a[2] = pte(data[NPAGES + 2], PTE_LEAF);
+    asm volatile("sfence.vma %0" : : "r"(va) : "memory");
+    crt_assert(mprv_ld(va) == (uint64_t)(NPAGES + 2) << 32);
+    crt_assert(mprv_ld(va + PAGE) == (uint64_t)3 << 32);
+
+    /* A fence for another ASID must not hide one for the current one */
+    l0a[2] = pte(data[2], PTE_LEAF);
+    asm volatile("sfence.vma zero, %0" : : "r"(2ul) : "memory");
+    asm volatile("sfence.vma zero, %0" : : "r"(1ul) : "memory");
+    check_pages(0);
+
+    asm volatile("csrw satp, %0" : : "r"(SATP_SV39 | (uintptr_t)root >> 12));
+}
+
+/*
+ * The root table is freed and reused for another address space under a
+ * fresh ASID.  No fence is needed, as nothing was ever cached for that
+ * ASID, so walks must not reuse what was cached under the old one.
+ */
+static void test_root_reuse(void)
+{
+    static uint64_t l1c[512] __attribute__((aligned(PAGE)));
+
+    printf("Testing root table reuse under a new ASID...\n");
+    asm volatile("csrw satp, %0"
+                 : : "r"(SATP_SV39 | SATP_ASID(3) | (uintptr_t)root >> 12));
+    check_pages(0);
+
+    l1c[0] = pte(l0b, PTE_V);
+    root[VA_BASE >> 30] = pte(l1c, PTE_V);
+    asm volatile("csrw satp, %0"
+                 : : "r"(SATP_SV39 | SATP_ASID(4) | (uintptr_t)root >> 12));
+    check_pages(NPAGES);
+
+    root[VA_BASE >> 30] = pte(l1, PTE_V);
+    asm volatile("csrw satp, %0" : : "r"(SATP_SV39 | (uintptr_t)root >> 12));
+    sfence_vma();
+    check_pages(0);
+}
+
+/*
+ * Run fn(arg) in VS-mode and return its result.  vs_entry calls it and
+ * ecalls back to M-mode, landing in vs_exit.  So does any other trap,
+ * which is why vs_run checks mcause.
+ */
+unsigned long vs_call(unsigned long (*fn)(unsigned long), unsigned long arg);
+
+asm(".balign 4\n"
+    "vs_call:\n"
+    "    addi sp, sp, -32\n"
+    "    sd ra, 0(sp)\n"
+    "    csrr t0, mtvec\n"
+    "    sd t0, 8(sp)\n"
+    "    csrrw t0, mie, zero\n"
+    "    sd t0, 16(sp)\n"
+    "    csrw mscratch, sp\n"
+    "    lla t0, vs_exit\n"
+    "    csrw mtvec, t0\n"
+    "    lla t0, vs_entry\n"
+    "    csrw mepc, t0\n"
+    "    li t0, 3 << 11\n"                  /* MPP */
+    "    csrc mstatus, t0\n"
+    "    li t0, (1 << 11) | (1 << 39)\n"    /* MPP=S, MPV */
+    "    csrs mstatus, t0\n"
+    "    mv t0, a0\n"
+    "    mv a0, a1\n"
+    "    mret\n"
+    "vs_entry:\n"
+    "    jalr t0\n"
+    "    ecall\n"
+    ".balign 4\n"
+    "vs_exit:\n"
+    "    csrr sp, mscratch\n"
+    "    li t0, 1 << 39\n"
+    "    csrc mstatus, t0\n"
+    "    ld t0, 16(sp)\n"
+    "    csrw mie, t0\n"
+    "    ld t0, 8(sp)\n"
+    "    csrw mtvec, t0\n"
+    "    ld ra, 0(sp)\n"
+    "    addi sp, sp, 32\n"
+    "    ret\n");
+
+static unsigned long vs_run(unsigned long (*fn)(unsigned long),
+                            unsigned long arg)
+{
+    unsigned long ret = vs_call(fn, arg);
+    unsigned long cause;
+
+    asm volatile("csrr %0, mcause" : "=r"(cause));
+    crt_assert(cause == CAUSE_VS_ECALL);
+    return ret;
+}
+
+/* Guest functions, run through vs_run */
+static unsigned long vs_set_satp(unsigned long satp)
+{
+    asm volatile("csrw satp, %0" : : "r"(satp) : "memory");
+    return 0;
+}
+
+static unsigned long vs_sfence(unsigned long unused)
+{
+    asm volatile("sfence.vma" : : : "memory");
+    return 0;
+}
+
+static unsigned long vs_sfence_asid(unsigned long asid)
+{
+    asm volatile("sfence.vma zero, %0" : : "r"(asid) : "memory");
+    return 0;
+}
+
+static unsigned long vs_ld(unsigned long va)
+{
+    return *(volatile uint64_t *)va;
+}
+
+/* The number of sampled words at VA_BASE not read from data[first...] */
+static unsigned long vs_check_pages(unsigned long first)
+{
+    unsigned long bad = 0;
+
+    for (int i = 0; i < NPAGES; i++) {
+        for (int j = 0; j < PAGE / 8; j += 97) {
+            uint64_t v = vs_ld(VA_BASE + i * PAGE + j * 8);
+            bad += v != ((uint64_t)(first + i) << 32 | j);
+        }
+    }
+    return bad;
+}
+
+static void hfence_gvma(void)
+{
+    asm volatile(".insn r 0x73, 0, 0x31, x0, x0, x0" : : : "memory");
+}
+
+static void set_hgatp(int vmid, uint64_t *g)
+{
+    asm volatile("csrw hgatp, %0"
+                 : : "r"(HGATP_SV39X4 | HGATP_VMID(vmid) | (uintptr_t)g >> 12));
+}
+
+static unsigned long vsatp(int asid, uint64_t *r)
+{
+    return SATP_SV39 | SATP_ASID(asid) | (uintptr_t)r >> 12;
+}
+
+static void setup_guest(void)
+{
+    vl1[0] = pte(l0a, PTE_V);
+    vl1b[0] = pte(l0b, PTE_V);
+    vroot[RAM_BASE >> 30] = pte((void *)RAM_BASE, PTE_LEAF | PTE_X);
+    vroot[VA_BASE >> 30] = pte((void *)GPA_WIN, PTE_V);
+    vroot2[RAM_BASE >> 30] = pte((void *)RAM_BASE, PTE_LEAF | PTE_X);
+    vroot2[VA_BASE >> 30] = pte((void *)(GPA_WIN + PAGE), PTE_V);
+
+    groot[RAM_BASE >> 30] = pte((void *)RAM_BASE, GPTE_LEAF | PTE_X);
+    groot[GPA_WIN >> 30] = pte(gl1, PTE_V);
+    gl1[0] = pte(gl0, PTE_V);
+    gl0[0] = pte(vl1, GPTE_LEAF);
+    gl0[1] = pte(vl1b, GPTE_LEAF);
+    groot2[RAM_BASE >> 30] = pte((void *)RAM_BASE, GPTE_LEAF | PTE_X);
+    groot2[GPA_WIN >> 30] = pte(gl1_2, PTE_V);
+    gl1_2[0] = pte(gl0_2, PTE_V);
+    gl0_2[0] = pte(vl1b, GPTE_LEAF);
+    gl0_2[1] = pte(vl1, GPTE_LEAF);
+
+    /* FS and VS Initial, so guest code may use FP and vector registers */
+    asm volatile("csrs vsstatus, %0" : : "r"(0x2200ul));
+    set_hgatp(1, groot);
+    hfence_gvma();
+}
+
+static void test_vs_walk(void)
+{
+    printf("Testing two-stage walks...\n");
+    setup_guest();
+    vs_run(vs_set_satp, vsatp(1, vroot));
+    crt_assert(vs_run(vs_check_pages, 0) == 0);
+    crt_assert(vs_run(vs_check_pages, 0) == 0);
+}
+
+/* Each guest process must only see its own translations */
+static void test_vs_satp_switch(void)
+{
+    printf("Testing guest satp switch...\n");
+    vs_run(vs_set_satp, vsatp(2, vroot2));
+    crt_assert(vs_run(vs_check_pages, NPAGES) == 0);
+
+    vs_run(vs_set_satp, vsatp(1, vroot));
+    crt_assert(vs_run(vs_check_pages, 0) == 0);
+}
+
+static void test_vs_sfence_asid(void)
+{
+    uintptr_t va = VA_BASE + 2 * PAGE;
+
+    printf("Testing guest ASID scoped sfence.vma...\n");
+    crt_assert(vs_run(vs_check_pages, 0) == 0);
+
+    l0a[2] = pte(data[NPAGES + 2], PTE_LEAF);
+    vs_run(vs_sfence_asid, 1);
+    crt_assert(vs_run(vs_ld, va) == (uint64_t)(NPAGES + 2) << 32);
+
+    l0a[2] = pte(data[2], PTE_LEAF);
+    vs_run(vs_sfence_asid, 1);
+    crt_assert(vs_run(vs_check_pages, 0) == 0);
+}
+
+/* As test_root_reuse, for a guest root table */
+static void test_vs_root_reuse(void)
+{
+    printf("Testing guest root table reuse under a new ASID...\n");
+    vs_run(vs_set_satp, vsatp(3, vroot));
+    crt_assert(vs_run(vs_check_pages, 0) == 0);
+
+    vroot[VA_BASE >> 30] = pte((void *)(GPA_WIN + PAGE), PTE_V);
+    vs_run(vs_set_satp, vsatp(4, vroot));
+    crt_assert(vs_run(vs_check_pages, NPAGES) == 0);
+
+    vroot[VA_BASE >> 30] = pte((void *)GPA_WIN, PTE_V);
+    vs_run(vs_set_satp, vsatp(1, vroot));
+    vs_run(vs_sfence, 0);
+    crt_assert(vs_run(vs_check_pages, 0) == 0);
+}
+
+/* The guest-physical page of a guest table moves under the guest */
+static void test_gstage(void)
+{
+    printf("Testing G-stage update + hfence.gvma and VMID switch...\n");
+    gl0[0] = pte(vl1b, GPTE_LEAF);
+    hfence_gvma();
+    crt_assert(vs_run(vs_check_pages, NPAGES) == 0);
+
+    gl0[0] = pte(vl1, GPTE_LEAF);
+    hfence_gvma();
+    crt_assert(vs_run(vs_check_pages, 0) == 0);
+
+    set_hgatp(2, groot2);
+    crt_assert(vs_run(vs_check_pages, NPAGES) == 0);
+
+    set_hgatp(1, groot);
+    crt_assert(vs_run(vs_check_pages, 0) == 0);
+}
+
+int main(void)
+{
+    setup();
+    test_walk();
+    test_nonleaf_update();
+    test_satp_switch();
+    test_sfence_scoped();
+    test_root_reuse();
+    test_vs_walk();
+    test_vs_satp_switch();
+    test_vs_sfence_asid();
+    test_vs_root_reuse();
+    test_gstage();
+    printf("MMU page-walk cache tests passed\n");
+    return 0;
+}
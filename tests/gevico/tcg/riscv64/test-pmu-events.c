@@ -0,0 +1,173 @@
+/*
+ * Test PMU events counted by translated code
+ *
+ * Each measurement runs in one asm block between a write and a read of
+ * mhpmcounter3, so the expected counts are exact.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "crt.h"
+
+#define EVENT_BRANCHES      0x00005ul
+#define EVENT_LOADS         0x10000ul
+#define EVENT_STORES        0x10002ul
+#define EVENT_TAKEN         0x20001ul
+#define EVENT_EXCEPTIONS    0x20002ul
+
+#define MHPMEVENT_OF        (1ul << 63)
+#define MHPMEVENT_MINH      (1ul << 62)
+#define MIP_LCOFIP          (1ul << 13)
+#define MSTATUS_MIE         (1ul << 3)
+
+static volatile uint32_t buf[8];
+
+/* Trap handler that skips the trapping (4-byte) instruction */
+void skip_trap(void);
+asm(".balign 4\n"
+    "skip_trap:\n"
+    "    csrw mscratch, t0\n"
+    "    csrr t0, mepc\n"
+    "    addi t0, t0, 4\n"
+    "    csrw mepc, t0\n"
+    "    csrr t0, mscratch\n"
+    "    mret\n");
+
+static void pmu_select(unsigned long event)
+{
+    asm volatile("csrw mcountinhibit, %0\n\t"
+                 "csrw mhpmevent3, zero\n\t"
+                 "csrw mhpmevent3, %1\n\t"
+                 "csrw mhpmcounter3, zero\n\t"
+                 "csrw mcountinhibit, zero"
+                 : : "r"(~0ul), "r"(event));
+}
+
+static unsigned long count_loads(void)
+{
+    unsigned long n, t;
+
+    asm volatile("csrw mhpmcounter3, zero\n\t"
+                 "lw %1, 0(%2)\n\t"
+                 "lw %1, 4(%2)\n\t"
+                 "lw %1, 8(%2)\n\t"
+                 "lw %1, 12(%2)\n\t"
+                 "lwu %1, 16(%2)\n\t"
+                 "ld %1, 0(%2)\n\t"
+                 "flw ft0, 0(%2)\n\t"
+                 "fld ft0, 8(%2)\n\t"
+                 "csrr %0, mhpmcounter3"
+                 : "=&r"(n), "=&r"(t) : "r"(buf) : "ft0", "memory");
+    return n;
+}
+
+static void test_loads_stores(void)
+{
+    unsigned long n;
+
+    printf("Testing load and store events...\n");
+    pmu_select(EVENT_LOADS);
+    crt_assert(count_loads() == 8);
+
+    pmu_select(EVENT_STORES);
+    asm volatile("csrw mhpmcounter3, zero\n\t"
+                 "sw zero, 0(%1)\n\t"
+                 "sw zero, 4(%1)\n\t"
+                 "sd zero, 8(%1)\n\t"
+                 "fsw ft0, 16(%1)\n\t"
+                 "fsd ft0, 24(%1)\n\t"
+                 "csrr %0, mhpmcounter3"
+                 : "=&r"(n) : "r"(buf) : "memory");
+    crt_assert(n == 5);
+}
+
+static void test_branches(void)
+{
+    unsigned long n, t;
+
+    printf("Testing branch and taken-branch events...\n");
+    pmu_select(EVENT_BRANCHES);
+    /* 3 bnez, 1 j */
+    asm volatile("li %1, 3\n\t"
+                 "csrw mhpmcounter3, zero\n\t"
+                 "1: addi %1, %1, -1\n\t"
+                 "bnez %1, 1b\n\t"
+                 "j 2f\n\t"
+                 "2: csrr %0, mhpmcounter3"
+                 : "=&r"(n), "=&r"(t));
+    crt_assert(n == 4);
+
+    pmu_select(EVENT_TAKEN);
+    asm volatile("li %1, 3\n\t"
+                 "csrw mhpmcounter3, zero\n\t"
+                 "1: addi %1, %1, -1\n\t"
+                 "bnez %1, 1b\n\t"
+                 "j 2f\n\t"
+                 "2: csrr %0, mhpmcounter3"
+                 : "=&r"(n), "=&r"(t));
+    crt_assert(n == 3);
+}
+
+static void test_exceptions(void)
+{
+    unsigned long n, mtvec;
+
+    printf("Testing exception event...\n");
+    pmu_select(EVENT_EXCEPTIONS);
+    asm volatile("csrc mstatus, %3\n\t"
+                 "csrrw %1, mtvec, %2\n\t"
+                 "csrw mhpmcounter3, zero\n\t"
+                 "ecall\n\t"
+                 "ecall\n\t"
+                 "csrr %0, mhpmcounter3\n\t"
+                 "csrw mtvec, %1\n\t"
+                 "csrs mstatus, %3"
+                 : "=&r"(n), "=&r"(mtvec)
+                 : "r"(skip_trap), "r"(MSTATUS_MIE));
+    crt_assert(n == 2);
+}
+
+static void test_mode_filter(void)
+{
+    printf("Testing M-mode inhibit...\n");
+    pmu_select(EVENT_LOADS | MHPMEVENT_MINH);
+    crt_assert(count_loads() == 0);
+}
+
+static void test_overflow(void)
+{
+    unsigned long n, event, mip;
+
+    printf("Testing counter overflow...\n");
+    pmu_select(EVENT_LOADS);
+    asm volatile("csrw mhpmcounter3, %4\n\t"
+                 "lw %1, 0(%3)\n\t"
+                 "lw %1, 4(%3)\n\t"
+                 "lw %1, 8(%3)\n\t"
+                 "lw %1, 12(%3)\n\t"
+                 "lw %1, 16(%3)\n\t"
+                 "lw %1, 20(%3)\n\t"
+                 "csrr %0, mhpmcounter3\n\t"
+                 "csrr %1, mhpmevent3\n\t"
+                 "csrr %2, mip"
+                 : "=&r"(n), "=&r"(event), "=&r"(mip)
+                 : "r"(buf), "r"(-4ul) : "memory");
+    crt_assert(n == 2);
+    crt_assert(event & MHPMEVENT_OF);
+    crt_assert(mip & MIP_LCOFIP);
+
+    asm volatile("csrc mip, %0" : : "r"(MIP_LCOFIP));
+}
+
+int main(void)
+{
+    test_loads_stores();
+    test_branches();
+    test_exceptions();
+    test_mode_filter();
+    test_overflow();
+
+    pmu_select(0);
+    printf("All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * Test RVV strided and indexed loads/stores across pages
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "crt.h"
+
+#define N       16
+#define PAGE    4096
+
+/* Three pages so accesses can start near the end of the first one */
+static uint32_t mem[3 * PAGE / 4] __attribute__((aligned(PAGE)));
+static uint32_t out[N];
+static uint32_t out2[N];
+static uint32_t idx[N];
+
+static void vsetvl_e32m4(int n)
+{
+    asm volatile("vsetvli zero, %0, e32, m4, ta, mu" : : "r"(n));
+}
+
+static uint32_t *near_page_end(void)
+{
+    return &mem[PAGE / 4 - 5];
+}
+
+static void fill(void)
+{
+    for (int i = 0; i < 3 * PAGE / 4; i++) {
+        mem[i] = i * 2654435761u;
+    }
+}
+
+static void test_strided_load(void)
+{
+    uint32_t *base = near_page_end();
+    long stride = 44;   /* 11 words, straddles a page every few elements */
+
+    printf("Testing vlse32.v...\n");
+    fill();
+    vsetvl_e32m4(N);
+    asm volatile("vlse32.v v8, (%0), %1\n"
+                 "vse32.v v8, (%2)\n"
+                 : : "r"(base), "r"(stride), "r"(out) : "memory");
+    for (int i = 0; i < N; i++) {
+        crt_assert(out[i] == base[i * 11]);
+    }
+}
+
+static void test_strided_load_masked(void)
+{
+    uint32_t *base = near_page_end();
+    long stride = 8;
+    uint8_t mask[2] = { 0xa5, 0x3c };
+
+    printf("Testing masked vlse32.v...\n");
+    fill();
+    vsetvl_e32m4(N);
+    asm volatile("vlm.v v0, (%3)\n"
+                 "vmv.v.i v8, 0\n"
+                 "vlse32.v v8, (%0), %1, v0.t\n"
+                 "vse32.v v8, (%2)\n"
+                 : : "r"(base), "r"(stride), "r"(out), "r"(mask)
+                 : "memory");
+    for (int i = 0; i < N; i++) {
+        bool active = (mask[i / 8] >> (i % 8)) & 1;
+        crt_assert(out[i] == (active ? base[i * 2] : 0));
+    }
+}
+
+static void test_strided_store(void)
+{
+    uint32_t *base = near_page_end();
+    long stride = -12;  /* walk backwards across the page boundary */
+    uint32_t *start = base + 3 * N;
+
+    printf("Testing vsse32.v...\n");
+    fill();
+    for (int i = 0; i < N; i++) {
+        out[i] = 0x1000 + i;
+    }
+    vsetvl_e32m4(N);
+    asm volatile("vle32.v v8, (%0)\n"
+                 "vsse32.v v8, (%1), %2\n"
+                 : : "r"(out), "r"(start), "r"(stride) : "memory");
+    for (int i = 0; i < N; i++) {
+        crt_assert(start[-3 * i] == 0x1000 + i);
+    }
+}
+
+static void test_segment_strided(void)
+{
+    uint32_t *base = near_page_end();
+    long stride = 20;
+
+    printf("Testing vlsseg2e32.v...\n");
+    fill();
+    vsetvl_e32m4(N);
+    asm volatile("vlsseg2e32.v v8, (%0), %1\n"
+                 "vse32.v v8, (%2)\n"
+                 "vse32.v v12, (%3)\n"
+                 : : "r"(base), "r"(stride), "r"(out), "r"(out2)
+                 : "memory");
+    for (int i = 0; i < N; i++) {
+        crt_assert(out[i] == base[i * 5]);
+        crt_assert(out2[i] == base[i * 5 + 1]);
+    }
+}
+
+static void test_indexed(void)
+{
+    uint32_t seed = 12345;
+
+    printf("Testing vluxei32.v / vsuxei32.v...\n");
+    fill();
+    for (int i = 0; i < N; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        /* distinct word offsets spread over all three pages */
+        idx[i] = ((seed >> 8) % (3 * PAGE / 4 / N) * N + i) * 4;
+    }
+    vsetvl_e32m4(N);
+    asm volatile("vle32.v v16, (%2)\n"
+                 "vluxei32.v v8, (%0), v16\n"
+                 "vse32.v v8, (%1)\n"
+                 : : "r"(mem), "r"(out), "r"(idx) : "memory");
+    for (int i = 0; i < N; i++) {
+        crt_assert(out[i] == mem[idx[i] / 4]);
+    }
+
+    for (int i = 0; i < N; i++) {
+        out[i] = ~i;
+    }
+    asm volatile("vle32.v v8, (%0)\n"
+                 "vle32.v v16, (%2)\n"
+                 "vsuxei32.v v8, (%1), v16\n"
+                 : : "r"(out), "r"(mem), "r"(idx) : "memory");
+    for (int i = 0; i < N; i++) {
+        crt_assert(mem[idx[i] / 4] == ~(uint32_t)i);
+    }
+}
+
+int main(void)
+{
+    test_strided_load();
+    test_strided_load_masked();
+    test_strided_store();
+    test_segment_strided();
+    test_indexed();
+
+    printf("All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Test SPI FIFO and burst transfers for G233 platform
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "crt.h"
+
+#define G233_SPI0_BASE 0x10018000
+
+/* Memory-mapped register access */
+#define REG32(addr) (*(volatile uint32_t *)((uintptr_t)(G233_SPI0_BASE + (addr))))
+
+/* G233 SPI register offsets */
+#define SPI_CR1     0x00
+#define SPI_CR2     0x04
+#define SPI_SR      0x08
+#define SPI_DR      0x0C
+#define SPI_CSCTRL  0x10
+#define SPI_FCR     0x14
+#define SPI_FSR     0x18
+
+/* SPI Control Register 1 (CR1) bits */
+#define SPI_CR1_SPE     (1 << 6)   /* SPI Enable */
+#define SPI_CR1_MSTR    (1 << 2)   /* Master mode */
+
+/* SPI Status Register (SR) bits */
+#define SPI_SR_RXNE     (1 << 0)   /* Receive buffer not empty */
+#define SPI_SR_TXE      (1 << 1)   /* Transmit buffer empty */
+#define SPI_SR_OVR      (1 << 3)   /* Overrun flag */
+#define SPI_SR_RXTH     (1 << 4)   /* RX FIFO level reached threshold */
+
+/* FIFO Control Register (FCR) fields */
+#define SPI_FCR_FIFOEN      (1 << 0)
+#define SPI_FCR_RXTH(n)     ((n) << 8)
+#define SPI_FCR_BURST(n)    (((n) - 1) << 16)
+
+/* CS Control Register bits */
+#define SPI_CS_ENABLE   (1 << 0)   /* Enable CS0 */
+#define SPI_CS_ACTIVE   (1 << 4)   /* Activate CS0 */
+
+#define W25Q16_CMD_JEDEC_ID 0x9F
+
+static void spi_cs_assert(void)
+{
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE | SPI_CS_ACTIVE;
+}
+
+static void spi_cs_deassert(void)
+{
+    REG32(SPI_CSCTRL) = SPI_CS_ENABLE;
+}
+
+/* Command plus three dummy bytes go out in one 32-bit DR write. */
+static void test_jedec_burst(void)
+{
+    uint32_t word;
+
+    printf("Testing JEDEC ID with a 4-byte burst...\n");
+
+    REG32(SPI_CR1) = 0;
+    REG32(SPI_FCR) = SPI_FCR_FIFOEN | SPI_FCR_RXTH(4) | SPI_FCR_BURST(4);
+    REG32(SPI_CR1) = SPI_CR1_MSTR | SPI_CR1_SPE;
+
+    spi_cs_assert();
+    REG32(SPI_DR) = W25Q16_CMD_JEDEC_ID;
+
+    crt_assert(REG32(SPI_SR) & SPI_SR_TXE);
+    crt_assert(REG32(SPI_SR) & SPI_SR_RXTH);
+    crt_assert((REG32(SPI_FSR) & 0xff) == 4);
+
+    word = REG32(SPI_DR);
+    spi_cs_deassert();
+
+    printf("RX word: 0x%x\n", word);
+    crt_assert((word >> 8) == 0x1530EF);
+    crt_assert(!(REG32(SPI_SR) & SPI_SR_RXNE));
+    crt_assert(!(REG32(SPI_SR) & SPI_SR_OVR));
+}
+
+/* Bytes queued while disabled are shifted out once SPE is set. */
+static void test_queue_then_enable(void)
+{
+    uint8_t id[4];
+    int i;
+
+    printf("Testing TX queueing while disabled...\n");
+
+    REG32(SPI_CR1) = 0;
+    REG32(SPI_FCR) = SPI_FCR_FIFOEN | SPI_FCR_BURST(1);
+
+    spi_cs_assert();
+    REG32(SPI_DR) = W25Q16_CMD_JEDEC_ID;
+    for (i = 0; i < 3; i++) {
+        REG32(SPI_DR) = 0;
+    }
+    crt_assert(((REG32(SPI_FSR) >> 8) & 0xff) == 4);
+    crt_assert(!(REG32(SPI_SR) & SPI_SR_TXE));
+
+    REG32(SPI_CR1) = SPI_CR1_MSTR | SPI_CR1_SPE;
+    crt_assert(REG32(SPI_SR) & SPI_SR_TXE);
+
+    for (i = 0; i < 4; i++) {
+        crt_assert(REG32(SPI_SR) & SPI_SR_RXNE);
+        id[i] = REG32(SPI_DR) & 0xff;
+    }
+    spi_cs_deassert();
+
+    crt_assert(id[1] == 0xEF && id[2] == 0x30 && id[3] == 0x15);
+    crt_assert(!(REG32(SPI_SR) & SPI_SR_OVR));
+
+    REG32(SPI_FCR) = 0;
+    REG32(SPI_CR1) = 0;
+}
+
+/* Without FIFOEN the burst field is ignored: one byte per DR access. */
+static void test_legacy_ignores_burst(void)
+{
+    uint32_t word;
+
+    printf("Testing burst field in legacy mode...\n");
+
+    REG32(SPI_CR1) = 0;
+    REG32(SPI_FCR) = SPI_FCR_BURST(4);
+    REG32(SPI_CR1) = SPI_CR1_MSTR | SPI_CR1_SPE;
+
+    spi_cs_assert();
+    REG32(SPI_DR) = W25Q16_CMD_JEDEC_ID | 0xaabbcc00;
+    crt_assert(REG32(SPI_SR) & SPI_SR_TXE);
+    crt_assert((REG32(SPI_FSR) & 0xff) == 1);
+    word = REG32(SPI_DR);
+    crt_assert(word <= 0xff);
+
+    REG32(SPI_DR) = 0;
+    word = REG32(SPI_DR);
+    spi_cs_deassert();
+
+    crt_assert(word == 0xEF);
+    crt_assert(!(REG32(SPI_SR) & SPI_SR_OVR));
+
+    REG32(SPI_FCR) = 0;
+    REG32(SPI_CR1) = 0;
+}
+
+int main(void)
+{
+    printf("G233 SPI FIFO Test\n");
+    printf("============================\n");
+
+    test_jedec_burst();
+    test_queue_then_enable();
+    test_legacy_ignores_burst();
+
+    printf("All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * Test code buffer reclamation (run with a small -accel tcg,tb-size)
+ *
+ * Many small functions are generated at run time, more than the code
+ * buffer can hold translated at once, so calling them all in turn fills
+ * it several times over and has its oldest regions reclaimed.  Each
+ * call is checked, including calls to functions whose TBs were
+ * reclaimed, and after every function has been rewritten.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "crt.h"
+
+#define TEST_FUNCS      32768
+#define TEST_BODY       15          /* addi insns per function */
+#define TEST_ROUNDS     3
+
+#define INSN_ADDI_A0(imm)   (((uint32_t)(imm) << 20) | 0x00050513)
+#define INSN_RET            0x00008067
+
+typedef uint64_t test_fn(uint64_t);
+
+static uint32_t code[TEST_FUNCS][TEST_BODY + 1] __attribute__((aligned(4)));
+
+static int64_t imm_of(int fn, int seed)
+{
+    return (fn * 7 + seed) % 2047 - 1023;
+}
+
+static void generate(int seed)
+{
+    for (int i = 0; i < TEST_FUNCS; i++) {
+        for (int j = 0; j < TEST_BODY; j++) {
+            code[i][j] = INSN_ADDI_A0(imm_of(i, seed) & 0xfff);
+        }
+        code[i][TEST_BODY] = INSN_RET;
+    }
+    asm volatile("fence.i" ::: "memory");
+}
+
+static void check(const char *what, int seed)
+{
+    printf("Testing %s...\n", what);
+    for (int r = 0; r < TEST_ROUNDS; r++) {
+        for (int i = 0; i < TEST_FUNCS; i++) {
+            test_fn *fn = (test_fn *)code[i];
+            uint64_t want = i + TEST_BODY * imm_of(i, seed);
+
+            crt_assert(fn(i) == want);
+        }
+    }
+}
+
+int main(void)
+{
+    generate(1);
+    check("reclaimed functions", 1);
+
+    /* Both reclaimed and resident TBs are now stale */
+    generate(2);
+    check("rewritten functions", 2);
+
+    printf("All tests passed!\n");
+    return 0;
+}
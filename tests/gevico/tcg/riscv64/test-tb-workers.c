@@ -0,0 +1,115 @@
+/*
+ * Test background translation (run with -accel tcg,tb-workers=N)
+ *
+ * Every generated function starts with a branch, so translating it
+ * hands both sides of the branch to the worker threads.  The functions
+ * are rewritten while those requests may still be queued or being
+ * translated, and there are more of them than the code buffer holds
+ * (with a small tb-size), so regions are reclaimed while the workers
+ * are busy.  A stale or half-installed TB shows up as a wrong result.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "crt.h"
+
+#define TEST_FUNCS      32768
+#define TEST_WORDS      8           /* insns per function, padded */
+#define TEST_ROUNDS     3
+
+#define INSN_ADDI_A0(imm)   (((uint32_t)(imm) << 20) | 0x00050513)
+#define INSN_BEQZ_A1_12     0x00058663  /* beqz a1, .+12 */
+#define INSN_RET            0x00008067
+#define INSN_NOP            0x00000013
+
+typedef uint64_t test_fn(uint64_t, uint64_t);
+
+static uint32_t code[TEST_FUNCS][TEST_WORDS] __attribute__((aligned(4)));
+
+static int64_t imm_of(int fn, int seed)
+{
+    return (fn * 7 + seed) % 2047 - 1023;
+}
+
+/*
+ *   beqz a1, 1f
+ *   addi a0, a0, imm(seed)
+ *   ret
+ * 1: addi a0, a0, imm(seed + 1)
+ *   ret
+ */
+static void write_fn(int i, int seed)
+{
+    code[i][0] = INSN_BEQZ_A1_12;
+    code[i][1] = INSN_ADDI_A0(imm_of(i, seed) & 0xfff);
+    code[i][2] = INSN_RET;
+    code[i][3] = INSN_ADDI_A0(imm_of(i, seed + 1) & 0xfff);
+    code[i][4] = INSN_RET;
+    for (int j = 5; j < TEST_WORDS; j++) {
+        code[i][j] = INSN_NOP;
+    }
+}
+
+static uint64_t call(int i, uint64_t sel)
+{
+    test_fn *fn = (test_fn *)code[i];
+
+    return fn(i, sel);
+}
+
+static uint64_t want(int i, int seed, uint64_t sel)
+{
+    return i + imm_of(i, sel ? seed : seed + 1);
+}
+
+static void generate(int seed)
+{
+    for (int i = 0; i < TEST_FUNCS; i++) {
+        write_fn(i, seed);
+    }
+    asm volatile("fence.i" ::: "memory");
+}
+
+/* Enough calls to fill the code buffer several times over */
+static void check_all(const char *what, int seed)
+{
+    printf("Testing %s...\n", what);
+    for (int r = 0; r < TEST_ROUNDS; r++) {
+        for (int i = 0; i < TEST_FUNCS; i++) {
+            crt_assert(call(i, r & 1) == want(i, seed, r & 1));
+            crt_assert(call(i, !(r & 1)) == want(i, seed, !(r & 1)));
+        }
+    }
+}
+
+/*
+ * Take the branch, which queues the other side for the workers, then
+ * rewrite that other side straight away and run it.
+ */
+static void check_rewrite_queued(int seed)
+{
+    printf("Testing rewrites racing the workers...\n");
+    for (int i = 0; i < TEST_FUNCS; i += 3) {
+        crt_assert(call(i, 0) == want(i, seed, 0));
+        code[i][1] = INSN_ADDI_A0(imm_of(i, seed + 2) & 0xfff);
+        asm volatile("fence.i" ::: "memory");
+        crt_assert(call(i, 1) == i + imm_of(i, seed + 2));
+        write_fn(i, seed);
+        asm volatile("fence.i" ::: "memory");
+        crt_assert(call(i, 1) == want(i, seed, 1));
+    }
+}
+
+int main(void)
+{
+    generate(1);
+    check_all("functions translated by the workers", 1);
+    check_rewrite_queued(1);
+
+    /* Both reclaimed and resident TBs are now stale */
+    generate(5);
+    check_all("rewritten functions", 5);
+
+    printf("All tests passed!\n");
+    return 0;
+}
@@ -92,6 +92,12 @@
 
 #define RISCV_IOMMU_REG_PQT             0x0044
 
+#define RISCV_IOMMU_REG_IOHPMEVT_BASE   0x0160
+#define RISCV_IOMMU_IOHPMEVT_EVENT_ID   GENMASK_ULL(14, 0)
+#define RISCV_IOMMU_HPMEVENT_TLB_MISS   4
+#define RISCV_IOMMU_HPMEVENT_IOTLB_HIT  16384
+#define RISCV_IOMMU_HPMEVENT_IOTLB_EVICT 16385
+
 typedef struct QRISCVIOMMU {
     QOSGraphObject obj;
     QPCIDevice dev;
@@ -199,12 +199,42 @@ static void test_iommu_init_queues(void *obj, void *data,
     qtest_wait_for_queue_active(r_iommu, RISCV_IOMMU_REG_PQCSR);
 }
 
+static void test_hpm_iotlb_events(void *obj, void *data,
+                                  QGuestAllocator *t_alloc)
+{
+    QRISCVIOMMU *r_iommu = obj;
+    static const uint32_t events[] = {
+        RISCV_IOMMU_HPMEVENT_TLB_MISS,
+        RISCV_IOMMU_HPMEVENT_IOTLB_HIT,
+        RISCV_IOMMU_HPMEVENT_IOTLB_EVICT,
+    };
+    uint64_t reg64;
+    int i;
+
+    /* The IOTLB events are accepted by the EventID WARL field */
+    for (i = 0; i < ARRAY_SIZE(events); i++) {
+        riscv_iommu_write_reg64(r_iommu, RISCV_IOMMU_REG_IOHPMEVT_BASE + i * 8,
+                                events[i]);
+        reg64 = riscv_iommu_read_reg64(r_iommu,
+                                       RISCV_IOMMU_REG_IOHPMEVT_BASE + i * 8);
+        g_assert_cmpuint(reg64 & RISCV_IOMMU_IOHPMEVT_EVENT_ID, ==, events[i]);
+    }
+
+    /* Unimplemented custom events read back as invalid */
+    riscv_iommu_write_reg64(r_iommu, RISCV_IOMMU_REG_IOHPMEVT_BASE,
+                            RISCV_IOMMU_HPMEVENT_IOTLB_EVICT + 1);
+    reg64 = riscv_iommu_read_reg64(r_iommu, RISCV_IOMMU_REG_IOHPMEVT_BASE);
+    g_assert_cmpuint(reg64 & RISCV_IOMMU_IOHPMEVT_EVENT_ID, ==, 0);
+}
+
 static void register_riscv_iommu_test(void)
 {
     qos_add_test("pci_config", "riscv-iommu-pci", test_pci_config, NULL);
     qos_add_test("reg_reset", "riscv-iommu-pci", test_reg_reset, NULL);
     qos_add_test("iommu_init_queues", "riscv-iommu-pci",
                  test_iommu_init_queues, NULL);
+    qos_add_test("hpm_iotlb_events", "riscv-iommu-pci",
+                 test_hpm_iotlb_events, NULL);
 }
 
 libqos_init(register_riscv_iommu_test);